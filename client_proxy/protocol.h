@@ -17,6 +17,7 @@
 #define MAX_CHAT_HISTORY 10
 #define MAX_STROKES 10000
 #define BUFFER_SIZE 4096
+#define UDP_MAX_DATAGRAM 1200  // Same limit as the server's
 
 // Ports
 #define HTTP_PORT 8080
@@ -45,6 +46,7 @@ typedef enum {
     MSG_GUESS_CORRECT,
     MSG_GUESS_WRONG,
     MSG_TIMER_UPDATE,
+    MSG_COUNTDOWN_UPDATE,
     MSG_ROUND_END,
     MSG_GAME_END,
     MSG_PLAYER_JOIN,
@@ -54,14 +56,23 @@ typedef enum {
     MSG_RECONNECT_SUCCESS,
     MSG_RECONNECT_FAIL,
     MSG_ERROR,
-    MSG_DISCONNECT
+    MSG_DISCONNECT,
+    MSG_CANVAS_SNAPSHOT,
+    MSG_ROOM_PATCH,
+    MSG_ROOM_RESYNC,
+    MSG_LEADERBOARD
 } MessageType;
 
 // UDP Message Types
 typedef enum {
     UDP_STROKE = 100,
     UDP_CLEAR_CANVAS,
-    UDP_UNDO
+    UDP_UNDO,
+    UDP_STROKE_PACKED,  // Over TCP/WebSocket: stroke_codec blob, base64 in "strokes"
+    UDP_BIND,           // Proxy -> server: a browser's session token
+    UDP_BIND_ACK,       // Server -> proxy: the player id
+    UDP_ACK,            // Proxy -> server: header only
+    UDP_FEC             // Server -> proxy: parity over a group of UDP_STROKE (see utils/udp_recovery.h)
 } UDPMessageType;
 
 // Player State
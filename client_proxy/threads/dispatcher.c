@@ -60,16 +60,10 @@ void* dispatcher_thread_func(void* arg) {
                 MessageType type;
                 if (json_get_type(msg.data, &type) == 0) {
                     printf("[DISPATCHER] Message type: %d\n", type);
-                    // Check if it's a drawing stroke (UDP) or other message (TCP)
-                    if (type == UDP_STROKE) {
-                        // Route to UDP
-                        printf("[DISPATCHER] Routing to UDP\n");
-                        queue_push(&dispatcher->to_udp_queue, msg.data, msg.len, msg.client_id);
-                    } else {
-                        // Route to TCP
-                        printf("[DISPATCHER] Routing to TCP\n");
-                        queue_push(&dispatcher->to_tcp_queue, msg.data, msg.len, msg.client_id);
-                    }
+                    // Browsers draw over TCP; the UDP thread only speaks the
+                    // server's datagram format
+                    printf("[DISPATCHER] Routing to TCP\n");
+                    queue_push(&dispatcher->to_tcp_queue, msg.data, msg.len, msg.client_id);
                     
                     // Update state cache
                     if (type == MSG_REGISTER_ACK) {
@@ -131,8 +125,8 @@ void* dispatcher_thread_func(void* arg) {
         if (queue_size(&dispatcher->from_udp_queue) > 0) {
             Message msg;
             if (queue_pop(&dispatcher->from_udp_queue, &msg)) {
-                // Forward stroke data to WebSocket
-                queue_push(&dispatcher->to_ws_queue, msg.data, msg.len, -1);  // broadcast
+                // Strokes relayed for one browser go back to that browser
+                queue_push(&dispatcher->to_ws_queue, msg.data, msg.len, msg.client_id);
                 free(msg.data);
             }
         }
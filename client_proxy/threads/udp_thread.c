@@ -1,20 +1,55 @@
 #include "udp_thread.h"
+#include "../utils/base64.h"
+#include "../utils/udp_wire.h"
+#include "../utils/udp_recovery.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <time.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <sys/select.h>
 #include <errno.h>
 
+#define MAX_UDP_SESSIONS 50      // One per browser, like ws_thread's clients
+#define BIND_RETRY_MS 1000
+#define BIND_MAX_ATTEMPTS 5
+
+// The server takes a player's UDP endpoint from the source address of its
+// UDP_BIND, so each browser gets a socket (and port) of its own
+typedef struct {
+    bool active;
+    int client_id;
+    int fd;
+    char session_token[64];
+    bool bound;
+    int bind_attempts;
+    uint64_t bind_sent_at;
+    uint32_t room_id;    // Room whose sequence ack/ack_bits describe
+    uint32_t ack;
+    uint32_t ack_bits;
+    bool ack_due;
+    UdpRecovery recovery;  // Recent payloads, for rebuilding a lost one from parity
+} UdpSession;
+
+static UdpSession sessions[MAX_UDP_SESSIONS];
+
+static uint64_t now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
 int udp_thread_init(UDPThread* udp, Dispatcher* dispatcher, const char* host, int port) {
     udp->dispatcher = dispatcher;
     udp->server_port = port;
     strncpy(udp->server_host, host, sizeof(udp->server_host) - 1);
     udp->running = true;
     
+    memset(sessions, 0, sizeof(sessions));
+    
     if (pthread_create(&udp->thread, NULL, udp_thread_func, udp) != 0) {
         perror("Failed to create UDP thread");
         return -1;
@@ -27,81 +62,229 @@ int udp_thread_init(UDPThread* udp, Dispatcher* dispatcher, const char* host, in
 void udp_thread_destroy(UDPThread* udp) {
     udp->running = false;
     pthread_join(udp->thread, NULL);
+    
+    for (int i = 0; i < MAX_UDP_SESSIONS; i++) {
+        if (sessions[i].active) close(sessions[i].fd);
+        sessions[i].active = false;
+    }
     printf("[UDP] Thread stopped\n");
 }
 
-void* udp_thread_func(void* arg) {
-    UDPThread* udp = (UDPThread*)arg;
+static UdpSession* find_session(int client_id) {
+    for (int i = 0; i < MAX_UDP_SESSIONS; i++) {
+        if (sessions[i].active && sessions[i].client_id == client_id) return &sessions[i];
+    }
+    return NULL;
+}
+
+static void close_session(UdpSession* s) {
+    close(s->fd);
+    printf("[UDP] Closed session for client %d\n", s->client_id);
+    memset(s, 0, sizeof(*s));
+}
+
+static void send_bind(UdpSession* s) {
+    UdpHeader header = { UDP_BIND, 0, 0, 0, 0 };
+    uint8_t datagram[UDP_HEADER_SIZE + sizeof(s->session_token)];
+    int len = udp_wire_encode(&header, s->session_token, strlen(s->session_token),
+                              datagram, sizeof(datagram));
+    if (len > 0) send(s->fd, datagram, len, 0);
+    s->bind_attempts++;
+    s->bind_sent_at = now_ms();
+}
+
+// Bind (or rebind, after a reconnect) client_id's browser to its player
+static void open_session(UDPThread* udp, int client_id, const char* session_token) {
+    UdpSession* s = find_session(client_id);
+    if (!s) {
+        for (int i = 0; i < MAX_UDP_SESSIONS && !s; i++) {
+            if (!sessions[i].active) s = &sessions[i];
+        }
+        if (!s) {
+            printf("[UDP] No free session for client %d\n", client_id);
+            return;
+        }
+        
+        int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (fd < 0) {
+            perror("Failed to create UDP socket");
+            return;
+        }
+        
+        // connect() picks an ephemeral port and filters out anyone but the server
+        struct sockaddr_in server_addr;
+        memset(&server_addr, 0, sizeof(server_addr));
+        server_addr.sin_family = AF_INET;
+        server_addr.sin_port = htons(udp->server_port);
+        inet_pton(AF_INET, udp->server_host, &server_addr.sin_addr);
+        if (connect(fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+            perror("Failed to connect UDP socket");
+            close(fd);
+            return;
+        }
+        
+        memset(s, 0, sizeof(*s));
+        s->active = true;
+        s->client_id = client_id;
+        s->fd = fd;
+    }
     
-    int sock_fd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (sock_fd < 0) {
-        perror("Failed to create UDP socket");
-        return NULL;
+    snprintf(s->session_token, sizeof(s->session_token), "%s", session_token);
+    s->bound = false;
+    s->bind_attempts = 0;
+    send_bind(s);
+}
+
+// Fold seq into the ack state; false for a datagram already seen
+static bool record_seq(UdpSession* s, uint32_t room_id, uint32_t seq) {
+    if (room_id != s->room_id || s->ack == 0) {
+        s->room_id = room_id;
+        s->ack = seq;
+        s->ack_bits = 0;
+        return true;
     }
     
-    struct sockaddr_in server_addr;
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(udp->server_port);
-    inet_pton(AF_INET, udp->server_host, &server_addr.sin_addr);
+    if (seq > s->ack) {
+        uint32_t shift = seq - s->ack;
+        s->ack_bits = shift > 32 ? 0 : ((shift == 32 ? 0 : s->ack_bits << shift) | (1u << (shift - 1)));
+        s->ack = seq;
+        return true;
+    }
+    if (seq == s->ack) return false;
     
-    // Bind to local port for receiving
-    struct sockaddr_in local_addr;
-    memset(&local_addr, 0, sizeof(local_addr));
-    local_addr.sin_family = AF_INET;
-    local_addr.sin_addr.s_addr = INADDR_ANY;
-    local_addr.sin_port = htons(UDP_PORT + 1);  // Client UDP port
+    uint32_t behind = s->ack - 1 - seq;
+    if (behind >= 32) return true;  // Too old to track, but still worth drawing
+    if (s->ack_bits & (1u << behind)) return false;
+    s->ack_bits |= 1u << behind;
+    return true;
+}
+
+// Strokes go to the browser in the UDP_STROKE_PACKED shape the TCP fanout
+// uses, so the web UI draws them the same way
+static void relay_strokes(UDPThread* udp, UdpSession* s, const uint8_t* payload, size_t payload_len) {
+    char message[BUFFER_SIZE];
+    int len = snprintf(message, sizeof(message), "{\"type\":%d,\"data\":{\"strokes\":\"", UDP_STROKE_PACKED);
+    if (len + BASE64_ENCODED_LEN((int)payload_len) + 3 > (int)sizeof(message)) return;
     
-    if (bind(sock_fd, (struct sockaddr*)&local_addr, sizeof(local_addr)) < 0) {
-        perror("Failed to bind UDP socket");
-        close(sock_fd);
-        return NULL;
+    base64_encode(payload, (int)payload_len, message + len);
+    len += strlen(message + len);
+    len += snprintf(message + len, sizeof(message) - len, "\"}}");
+    queue_push(&udp->dispatcher->from_udp_queue, message, len, s->client_id);
+}
+
+static void handle_datagram(UDPThread* udp, UdpSession* s, const uint8_t* buffer, int len) {
+    UdpHeader header;
+    const uint8_t* payload;
+    size_t payload_len;
+    if (udp_wire_decode(buffer, len, &header, &payload, &payload_len) < 0) return;
+    
+    switch ((int)header.type) {
+        case UDP_BIND_ACK:
+            if (!s->bound) {
+                s->bound = true;
+                printf("[UDP] Client %d bound\n", s->client_id);
+            }
+            break;
+        case UDP_STROKE:
+            s->ack_due = true;
+            if (record_seq(s, header.room_id, header.seq)) {
+                udp_recovery_store(&s->recovery, header.room_id, header.seq, payload, payload_len);
+                relay_strokes(udp, s, payload, payload_len);
+            }
+            break;
+        case UDP_FEC: {
+            // A group missing one datagram: rebuild it and take it as if it
+            // had arrived, so the ack stops the server resending it
+            uint8_t rebuilt[UDP_MAX_PAYLOAD];
+            uint32_t seq;
+            int rebuilt_len = udp_recovery_rebuild(&s->recovery, header.room_id, header.seq,
+                                                   payload, payload_len, &seq,
+                                                   rebuilt, sizeof(rebuilt));
+            if (rebuilt_len > 0 && record_seq(s, header.room_id, seq)) {
+                s->ack_due = true;
+                udp_recovery_store(&s->recovery, header.room_id, seq, rebuilt, rebuilt_len);
+                relay_strokes(udp, s, rebuilt, rebuilt_len);
+            }
+            break;
+        }
+        default:
+            break;
     }
+}
+
+void* udp_thread_func(void* arg) {
+    UDPThread* udp = (UDPThread*)arg;
     
-    printf("[UDP] Socket bound and ready\n");
+    printf("[UDP] Ready, one socket per bound browser\n");
     
     while (udp->running) {
+        // Bind and close requests from the WebSocket thread: a session
+        // token, or an empty string once the browser is gone
+        while (queue_size(&udp->dispatcher->to_udp_queue) > 0) {
+            Message msg;
+            if (!queue_pop(&udp->dispatcher->to_udp_queue, &msg)) break;
+            
+            if (msg.len > 1) {
+                open_session(udp, msg.client_id, msg.data);
+            } else {
+                UdpSession* s = find_session(msg.client_id);
+                if (s) close_session(s);
+            }
+            free(msg.data);
+        }
+        
         fd_set read_fds;
         FD_ZERO(&read_fds);
-        FD_SET(sock_fd, &read_fds);
+        int max_fd = -1;
+        for (int i = 0; i < MAX_UDP_SESSIONS; i++) {
+            if (!sessions[i].active) continue;
+            FD_SET(sessions[i].fd, &read_fds);
+            if (sessions[i].fd > max_fd) max_fd = sessions[i].fd;
+        }
         
         struct timeval timeout;
         timeout.tv_sec = 0;
         timeout.tv_usec = 10000;  // 10ms for low latency
         
-        int activity = select(sock_fd + 1, &read_fds, NULL, NULL, &timeout);
+        int activity = select(max_fd + 1, &read_fds, NULL, NULL, &timeout);
         
         if (activity < 0 && errno != EINTR) {
             perror("UDP select error");
             break;
         }
         
-        // Receive from server
-        if (FD_ISSET(sock_fd, &read_fds)) {
-            char buffer[BUFFER_SIZE];
-            struct sockaddr_in from_addr;
-            socklen_t from_len = sizeof(from_addr);
+        uint64_t now = now_ms();
+        for (int i = 0; i < MAX_UDP_SESSIONS; i++) {
+            UdpSession* s = &sessions[i];
+            if (!s->active) continue;
             
-            int bytes = recvfrom(sock_fd, buffer, sizeof(buffer), 0,
-                               (struct sockaddr*)&from_addr, &from_len);
+            if (activity > 0 && FD_ISSET(s->fd, &read_fds)) {
+                uint8_t buffer[UDP_MAX_DATAGRAM];
+                int bytes;
+                while ((bytes = recv(s->fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+                    handle_datagram(udp, s, buffer, bytes);
+                }
+            }
             
-            if (bytes > 0) {
-                // Push to dispatcher
-                queue_push(&udp->dispatcher->from_udp_queue, buffer, bytes, -1);
+            if (!s->bound && now - s->bind_sent_at >= BIND_RETRY_MS) {
+                if (s->bind_attempts < BIND_MAX_ATTEMPTS) {
+                    send_bind(s);
+                } else if (s->bind_attempts == BIND_MAX_ATTEMPTS) {
+                    printf("[UDP] Client %d could not bind, strokes reach it over TCP only\n", s->client_id);
+                    s->bind_attempts++;
+                }
             }
-        }
-        
-        // Send to server (from dispatcher)
-        if (queue_size(&udp->dispatcher->to_udp_queue) > 0) {
-            Message msg;
-            if (queue_pop(&udp->dispatcher->to_udp_queue, &msg)) {
-                sendto(sock_fd, msg.data, msg.len, 0,
-                      (struct sockaddr*)&server_addr, sizeof(server_addr));
-                free(msg.data);
+            
+            // One ack per pass covers everything received in it
+            if (s->ack_due) {
+                UdpHeader header = { UDP_ACK, s->room_id, 0, s->ack, s->ack_bits };
+                uint8_t datagram[UDP_HEADER_SIZE];
+                int len = udp_wire_encode(&header, NULL, 0, datagram, sizeof(datagram));
+                if (len > 0) send(s->fd, datagram, len, 0);
+                s->ack_due = false;
             }
         }
     }
     
-    close(sock_fd);
     return NULL;
 }
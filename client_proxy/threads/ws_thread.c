@@ -1,4 +1,6 @@
 #include "ws_thread.h"
+#include "../utils/base64.h"
+#include "../utils/json.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -27,6 +29,7 @@ typedef struct {
     int tcp_fd;          // TCP connection to game server
     bool active;
     int client_id;
+    char session_token[64];  // From REGISTER_ACK or RECONNECT_REQUEST, for the UDP bind
 } WSClient;
 
 static WSClient ws_clients[MAX_WS_CLIENTS];
@@ -72,47 +75,6 @@ int ws_serialize_tcp_message(const char* json, char* buffer, int buffer_size) {
     return 4 + json_len;
 }
 
-// Base64 encoding table
-static const char base64_table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-
-// Base64 encode
-void base64_encode(const unsigned char* input, int length, char* output) {
-    int i = 0, j = 0;
-    unsigned char char_array_3[3];
-    unsigned char char_array_4[4];
-    
-    while (length--) {
-        char_array_3[i++] = *(input++);
-        if (i == 3) {
-            char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-            char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-            char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-            char_array_4[3] = char_array_3[2] & 0x3f;
-            
-            for (i = 0; i < 4; i++)
-                output[j++] = base64_table[char_array_4[i]];
-            i = 0;
-        }
-    }
-    
-    if (i) {
-        int k;
-        for (k = i; k < 3; k++)
-            char_array_3[k] = '\0';
-        
-        char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-        char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-        char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-        
-        for (k = 0; k < i + 1; k++)
-            output[j++] = base64_table[char_array_4[k]];
-        
-        while (i++ < 3)
-            output[j++] = '=';
-    }
-    output[j] = '\0';
-}
-
 // WebSocket handshake with proper Sec-WebSocket-Accept calculation
 int ws_handshake(int client_fd) {
     char buffer[2048];
@@ -236,6 +198,31 @@ int ws_encode_frame(const char* payload, int payload_len, char* frame, int frame
     return offset + payload_len;
 }
 
+// Have the UDP thread bind a socket for this browser's player; an empty
+// token closes it again
+static void request_udp_session(WSThread* ws, WSClient* client, const char* session_token) {
+    queue_push(&ws->dispatcher->to_udp_queue, session_token, strlen(session_token) + 1,
+               client->client_id);
+}
+
+// Strokes the UDP thread relayed for one browser (client_id -1: all of them)
+static void send_queued_to_browsers(WSThread* ws) {
+    while (queue_size(&ws->dispatcher->to_ws_queue) > 0) {
+        Message msg;
+        if (!queue_pop(&ws->dispatcher->to_ws_queue, &msg)) break;
+        
+        char ws_frame[BUFFER_SIZE];
+        int frame_len = ws_encode_frame(msg.data, msg.len, ws_frame, sizeof(ws_frame));
+        for (int i = 0; frame_len > 0 && i < MAX_WS_CLIENTS; i++) {
+            if (ws_clients[i].active && ws_clients[i].ws_fd > 0 &&
+                (msg.client_id == -1 || msg.client_id == ws_clients[i].client_id)) {
+                send(ws_clients[i].ws_fd, ws_frame, frame_len, 0);
+            }
+        }
+        free(msg.data);
+    }
+}
+
 int ws_thread_init(WSThread* ws, Dispatcher* dispatcher, int port) {
     ws->dispatcher = dispatcher;
     ws->port = port;
@@ -324,8 +311,8 @@ void* ws_thread_func(void* arg) {
         }
         
         struct timeval timeout;
-        timeout.tv_sec = 1;
-        timeout.tv_usec = 0;
+        timeout.tv_sec = 0;
+        timeout.tv_usec = 10000;  // 10ms, so relayed UDP strokes aren't held back
         
         int activity = select(max_fd + 1, &read_fds, NULL, NULL, &timeout);
         
@@ -352,6 +339,7 @@ void* ws_thread_func(void* arg) {
                                 ws_clients[i].tcp_fd = tcp_fd;
                                 ws_clients[i].active = true;
                                 ws_clients[i].client_id = next_client_id++;
+                                ws_clients[i].session_token[0] = '\0';
                                 ws_client_count++;
                                 printf("[WS] Client %d connected (WS:%d, TCP:%d)\n", 
                                        ws_clients[i].client_id, client_fd, tcp_fd);
@@ -377,6 +365,7 @@ void* ws_thread_func(void* arg) {
                 if (bytes <= 0) {
                     // Disconnected
                     printf("[WS] Client %d disconnected\n", ws_clients[i].client_id);
+                    request_udp_session(ws, &ws_clients[i], "");
                     close(ws_clients[i].ws_fd);
                     if (ws_clients[i].tcp_fd > 0) close(ws_clients[i].tcp_fd);
                     ws_clients[i].active = false;
@@ -389,6 +378,12 @@ void* ws_thread_func(void* arg) {
                         payload[payload_len] = '\0';
                         printf("[WS] Client %d sent: %s\n", ws_clients[i].client_id, payload);
                         
+                        MessageType type;
+                        if (json_get_type(payload, &type) == 0 && type == MSG_RECONNECT_REQUEST) {
+                            json_get_string(payload, "session_token", ws_clients[i].session_token,
+                                            sizeof(ws_clients[i].session_token));
+                        }
+                        
                         // Forward directly to TCP (serialize with length prefix)
                         char tcp_buffer[BUFFER_SIZE];
                         int tcp_len = ws_serialize_tcp_message(payload, tcp_buffer, sizeof(tcp_buffer));
@@ -421,6 +416,20 @@ void* ws_thread_func(void* arg) {
                             char* json_payload = buffer + offset + 4;
                             printf("[TCP] Client %d received: %.*s\n", ws_clients[i].client_id, (int)json_len, json_payload);
                             
+                            // Once the server knows the player, bind its UDP endpoint
+                            char json[BUFFER_SIZE];
+                            snprintf(json, sizeof(json), "%.*s", (int)json_len, json_payload);
+                            MessageType type;
+                            if (json_get_type(json, &type) == 0) {
+                                if (type == MSG_REGISTER_ACK &&
+                                    json_get_string(json, "session_token", ws_clients[i].session_token,
+                                                    sizeof(ws_clients[i].session_token)) == 0) {
+                                    request_udp_session(ws, &ws_clients[i], ws_clients[i].session_token);
+                                } else if (type == MSG_RECONNECT_SUCCESS && ws_clients[i].session_token[0]) {
+                                    request_udp_session(ws, &ws_clients[i], ws_clients[i].session_token);
+                                }
+                            }
+                            
                             // Encode as WebSocket frame and send to browser
                             char ws_frame[BUFFER_SIZE];
                             int frame_len = ws_encode_frame(json_payload, json_len, ws_frame, sizeof(ws_frame));
@@ -441,7 +450,9 @@ void* ws_thread_func(void* arg) {
             }
         }
         
-        // Note: Direct TCP<->WebSocket forwarding now, no dispatcher queues needed
+        // Game messages are forwarded directly above; only UDP-relayed
+        // strokes come through the dispatcher
+        send_queued_to_browsers(ws);
     }
     
     close(server_fd);
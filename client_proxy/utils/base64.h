@@ -0,0 +1,9 @@
+#ifndef BASE64_H
+#define BASE64_H
+
+#define BASE64_ENCODED_LEN(n) ((((n) + 2) / 3) * 4)
+
+// Writes BASE64_ENCODED_LEN(length) chars plus a terminating NUL
+void base64_encode(const unsigned char* input, int length, char* output);
+
+#endif // BASE64_H
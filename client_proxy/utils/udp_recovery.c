@@ -0,0 +1,59 @@
+#include "udp_recovery.h"
+#include <string.h>
+
+#define FEC_HEADER_SIZE 4  // count:u8 reserved:u8 len_xor:u16
+
+// Keep a stroke payload the parity of its group may need
+void udp_recovery_store(UdpRecovery* rec, uint32_t room_id, uint32_t seq,
+                        const uint8_t* payload, size_t len) {
+    if (room_id != rec->room_id) {
+        memset(rec->slots, 0, sizeof(rec->slots));
+        rec->room_id = room_id;
+    }
+    if (seq == 0 || len > UDP_MAX_PAYLOAD) return;
+    
+    UdpRecoverySlot* slot = &rec->slots[seq % UDP_RECOVERY_SLOTS];
+    slot->seq = seq;
+    slot->len = (uint16_t)len;
+    memcpy(slot->payload, payload, len);
+}
+
+// Rebuild the one payload the group first_seq's parity covers and the
+// window lacks. Returns its length and sets *seq; -1 when none or more
+// than one is missing, or the parity doesn't add up.
+int udp_recovery_rebuild(UdpRecovery* rec, uint32_t room_id, uint32_t first_seq,
+                         const uint8_t* parity, size_t parity_len,
+                         uint32_t* seq, uint8_t* out, size_t out_size) {
+    if (room_id != rec->room_id || parity_len < FEC_HEADER_SIZE) return -1;
+    
+    int count = parity[0];
+    uint16_t len = (uint16_t)((parity[2] << 8) | parity[3]);
+    size_t longest = parity_len - FEC_HEADER_SIZE;
+    if (count < 1 || count > UDP_RECOVERY_SLOTS / 2 || longest > out_size) return -1;
+    
+    uint32_t missing = 0;
+    for (int i = 0; i < count; i++) {
+        uint32_t s = first_seq + (uint32_t)i;
+        if (rec->slots[s % UDP_RECOVERY_SLOTS].seq == s) continue;
+        if (missing != 0) return -1;  // Two lost; only a resend helps
+        missing = s;
+    }
+    if (missing == 0) return -1;
+    
+    memcpy(out, parity + FEC_HEADER_SIZE, longest);
+    for (int i = 0; i < count; i++) {
+        uint32_t s = first_seq + (uint32_t)i;
+        if (s == missing) continue;
+        
+        const UdpRecoverySlot* slot = &rec->slots[s % UDP_RECOVERY_SLOTS];
+        if (slot->len > longest) return -1;
+        for (size_t k = 0; k < slot->len; k++) {
+            out[k] ^= slot->payload[k];
+        }
+        len ^= slot->len;
+    }
+    if (len == 0 || len > longest) return -1;
+    
+    *seq = missing;
+    return len;
+}
@@ -0,0 +1,34 @@
+#ifndef UDP_RECOVERY_H
+#define UDP_RECOVERY_H
+
+#include "udp_wire.h"
+#include <stdint.h>
+#include <stddef.h>
+
+// Rebuilds a lost stroke datagram from the server's UDP_FEC parity
+// (server/udp/udp_fec.h). The parity covers count datagrams from its
+// header's seq on, and is the XOR of their payloads, each zero-padded to
+// the longest, with len_xor the XOR of their lengths. With every payload
+// of the group but one at hand, XORing them into the parity leaves the
+// missing one.
+
+#define UDP_RECOVERY_SLOTS 32  // Recent payloads kept; twice the largest group
+
+typedef struct {
+    uint32_t seq;  // 0 = empty
+    uint16_t len;
+    uint8_t payload[UDP_MAX_PAYLOAD];
+} UdpRecoverySlot;
+
+typedef struct {
+    uint32_t room_id;
+    UdpRecoverySlot slots[UDP_RECOVERY_SLOTS];  // Indexed by seq % UDP_RECOVERY_SLOTS
+} UdpRecovery;
+
+void udp_recovery_store(UdpRecovery* rec, uint32_t room_id, uint32_t seq,
+                        const uint8_t* payload, size_t len);
+int udp_recovery_rebuild(UdpRecovery* rec, uint32_t room_id, uint32_t first_seq,
+                         const uint8_t* parity, size_t parity_len,
+                         uint32_t* seq, uint8_t* out, size_t out_size);
+
+#endif // UDP_RECOVERY_H
@@ -0,0 +1,79 @@
+#include "udp_wire.h"
+#include <string.h>
+
+static uint32_t crc_table[256];
+static bool crc_table_ready = false;  // Only the UDP thread encodes or decodes
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t* p, size_t length) {
+    if (!crc_table_ready) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            crc_table[i] = c;
+        }
+        crc_table_ready = true;
+    }
+    
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc = crc_table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static void put_u32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static uint32_t get_u32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// Returns the datagram length
+int udp_wire_encode(const UdpHeader* header, const void* payload, size_t payload_len,
+                    uint8_t* out, size_t out_size) {
+    if (payload_len > UDP_MAX_PAYLOAD || UDP_HEADER_SIZE + payload_len > out_size) return -1;
+    
+    out[0] = UDP_WIRE_VERSION;
+    out[1] = (uint8_t)header->type;
+    out[2] = (uint8_t)(payload_len >> 8);
+    out[3] = (uint8_t)payload_len;
+    put_u32(out + 4, header->room_id);
+    put_u32(out + 8, header->seq);
+    put_u32(out + 12, header->ack);
+    put_u32(out + 16, header->ack_bits);
+    put_u32(out + 20, 0);
+    if (payload_len > 0) memcpy(out + UDP_HEADER_SIZE, payload, payload_len);
+    
+    put_u32(out + 20, crc32_update(0, out, UDP_HEADER_SIZE + payload_len));
+    return (int)(UDP_HEADER_SIZE + payload_len);
+}
+
+// Rejects other versions, truncated datagrams and bad checksums
+int udp_wire_decode(const uint8_t* in, size_t len, UdpHeader* header,
+                    const uint8_t** payload, size_t* payload_len) {
+    if (len < UDP_HEADER_SIZE || in[0] != UDP_WIRE_VERSION) return -1;
+    
+    size_t body = (size_t)((in[2] << 8) | in[3]);
+    if (UDP_HEADER_SIZE + body != len) return -1;
+    
+    static const uint8_t zero_crc[4] = {0, 0, 0, 0};
+    uint32_t crc = crc32_update(0, in, 20);
+    crc = crc32_update(crc, zero_crc, sizeof(zero_crc));
+    crc = crc32_update(crc, in + UDP_HEADER_SIZE, body);
+    if (crc != get_u32(in + 20)) return -1;
+    
+    header->type = (UDPMessageType)in[1];
+    header->room_id = get_u32(in + 4);
+    header->seq = get_u32(in + 8);
+    header->ack = get_u32(in + 12);
+    header->ack_bits = get_u32(in + 16);
+    *payload = in + UDP_HEADER_SIZE;
+    *payload_len = body;
+    return 0;
+}
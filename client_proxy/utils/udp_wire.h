@@ -0,0 +1,37 @@
+#ifndef UDP_WIRE_H
+#define UDP_WIRE_H
+
+#include "../protocol.h"
+#include <stddef.h>
+
+// The server's UDP datagram format (server/udp/udp_wire.h), all fields in
+// network order:
+//
+//   0  version:u8      UDP_WIRE_VERSION
+//   1  type:u8         UDPMessageType
+//   2  payload_len:u16
+//   4  room_id:u32
+//   8  seq:u32         Server -> proxy: the room's datagram sequence, from 1
+//  12  ack:u32         Proxy -> server: highest seq received
+//  16  ack_bits:u32    Bit i set: seq ack - 1 - i was received too
+//  20  crc:u32         CRC-32 of the header (crc zeroed) and the payload
+//  24  payload
+
+#define UDP_WIRE_VERSION 2
+#define UDP_HEADER_SIZE 24
+#define UDP_MAX_PAYLOAD (UDP_MAX_DATAGRAM - UDP_HEADER_SIZE)
+
+typedef struct {
+    UDPMessageType type;
+    uint32_t room_id;
+    uint32_t seq;
+    uint32_t ack;
+    uint32_t ack_bits;
+} UdpHeader;
+
+int udp_wire_encode(const UdpHeader* header, const void* payload, size_t payload_len,
+                    uint8_t* out, size_t out_size);
+int udp_wire_decode(const uint8_t* in, size_t len, UdpHeader* header,
+                    const uint8_t** payload, size_t* payload_len);
+
+#endif // UDP_WIRE_H
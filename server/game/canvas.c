@@ -0,0 +1,121 @@
+#include "canvas.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define TILE_PIXELS (CANVAS_TILE_SIZE * CANVAS_TILE_SIZE)
+#define RLE_MAX_RUN 16  // Each RLE byte is (run - 1) << 4 | palette index
+
+CanvasRaster* canvas_create() {
+    return calloc(1, sizeof(CanvasRaster));
+}
+
+void canvas_clear(CanvasRaster* canvas) {
+    if (!canvas) return;
+
+    for (int i = 0; i < CANVAS_TILE_COUNT; i++) {
+        free(canvas->tiles[i].pixels);
+        free(canvas->tiles[i].rle);
+    }
+    memset(canvas, 0, sizeof(CanvasRaster));
+}
+
+void canvas_destroy(CanvasRaster* canvas) {
+    canvas_clear(canvas);
+    free(canvas);
+}
+
+static void set_pixel(CanvasRaster* canvas, int x, int y, uint8_t value) {
+    int tile_idx = (y / CANVAS_TILE_SIZE) * CANVAS_TILES_X + (x / CANVAS_TILE_SIZE);
+    CanvasTile* tile = &canvas->tiles[tile_idx];
+
+    if (!tile->pixels) {
+        tile->pixels = calloc(TILE_PIXELS, 1);
+        if (!tile->pixels) return;
+    }
+
+    int offset = (y % CANVAS_TILE_SIZE) * CANVAS_TILE_SIZE + (x % CANVAS_TILE_SIZE);
+    if (tile->pixels[offset] != value) {
+        tile->pixels[offset] = value;
+        tile->dirty = true;
+    }
+}
+
+// Round-capped line: every pixel whose center lies within thickness/2 of the segment
+void canvas_draw_stroke(CanvasRaster* canvas, const Stroke* stroke) {
+    if (!canvas) return;
+
+    uint8_t value = (uint8_t)((stroke->color < 15 ? stroke->color : 14) + 1);
+    float radius = stroke->thickness > 1 ? stroke->thickness / 2.0f : 0.5f;
+
+    int min_x = (int)floorf(fminf(stroke->x1, stroke->x2) - radius);
+    int max_x = (int)ceilf(fmaxf(stroke->x1, stroke->x2) + radius);
+    int min_y = (int)floorf(fminf(stroke->y1, stroke->y2) - radius);
+    int max_y = (int)ceilf(fmaxf(stroke->y1, stroke->y2) + radius);
+
+    if (min_x < 0) min_x = 0;
+    if (min_y < 0) min_y = 0;
+    if (max_x > CANVAS_WIDTH - 1) max_x = CANVAS_WIDTH - 1;
+    if (max_y > CANVAS_HEIGHT - 1) max_y = CANVAS_HEIGHT - 1;
+
+    float dx = stroke->x2 - stroke->x1;
+    float dy = stroke->y2 - stroke->y1;
+    float len_sq = dx * dx + dy * dy;
+    float radius_sq = radius * radius;
+
+    for (int y = min_y; y <= max_y; y++) {
+        for (int x = min_x; x <= max_x; x++) {
+            float px = x + 0.5f - stroke->x1;
+            float py = y + 0.5f - stroke->y1;
+
+            float t = len_sq > 0 ? (px * dx + py * dy) / len_sq : 0;
+            if (t < 0) t = 0;
+            if (t > 1) t = 1;
+
+            float ex = px - t * dx;
+            float ey = py - t * dy;
+            if (ex * ex + ey * ey <= radius_sq) {
+                set_pixel(canvas, x, y, value);
+            }
+        }
+    }
+}
+
+int canvas_next_tile(const CanvasRaster* canvas, int from) {
+    if (!canvas) return -1;
+
+    for (int i = from; i < CANVAS_TILE_COUNT; i++) {
+        if (canvas->tiles[i].pixels) return i;
+    }
+    return -1;
+}
+
+const uint8_t* canvas_tile_rle(CanvasRaster* canvas, int tile_idx, int* out_len) {
+    CanvasTile* tile = &canvas->tiles[tile_idx];
+    if (!tile->pixels) return NULL;
+
+    if (tile->dirty || !tile->rle) {
+        if (!tile->rle) {
+            tile->rle = malloc(TILE_PIXELS);  // Worst case: one byte per pixel
+            if (!tile->rle) return NULL;
+        }
+
+        int len = 0;
+        int i = 0;
+        while (i < TILE_PIXELS) {
+            uint8_t value = tile->pixels[i];
+            int run = 1;
+            while (i + run < TILE_PIXELS && run < RLE_MAX_RUN && tile->pixels[i + run] == value) {
+                run++;
+            }
+            tile->rle[len++] = (uint8_t)(((run - 1) << 4) | value);
+            i += run;
+        }
+
+        tile->rle_len = len;
+        tile->dirty = false;
+    }
+
+    *out_len = tile->rle_len;
+    return tile->rle;
+}
@@ -0,0 +1,35 @@
+#ifndef CANVAS_H
+#define CANVAS_H
+
+#include "../protocol.h"
+
+// Server-side raster of a room's canvas, kept in sync with add_strokes so
+// late joiners get one snapshot instead of the full stroke history.
+// Pixels are palette indices: 0 = background, n = drawing color n - 1.
+
+#define CANVAS_WIDTH 800
+#define CANVAS_HEIGHT 600
+#define CANVAS_TILE_SIZE 32
+#define CANVAS_TILES_X ((CANVAS_WIDTH + CANVAS_TILE_SIZE - 1) / CANVAS_TILE_SIZE)
+#define CANVAS_TILES_Y ((CANVAS_HEIGHT + CANVAS_TILE_SIZE - 1) / CANVAS_TILE_SIZE)
+#define CANVAS_TILE_COUNT (CANVAS_TILES_X * CANVAS_TILES_Y)
+
+typedef struct {
+    uint8_t* pixels;  // TILE_SIZE * TILE_SIZE indices, NULL while blank
+    uint8_t* rle;     // Cached encoding of pixels, rebuilt when dirty
+    int rle_len;
+    bool dirty;
+} CanvasTile;
+
+struct CanvasRaster {
+    CanvasTile tiles[CANVAS_TILE_COUNT];
+};
+
+CanvasRaster* canvas_create();
+void canvas_destroy(CanvasRaster* canvas);
+void canvas_clear(CanvasRaster* canvas);
+void canvas_draw_stroke(CanvasRaster* canvas, const Stroke* stroke);
+int canvas_next_tile(const CanvasRaster* canvas, int from);
+const uint8_t* canvas_tile_rle(CanvasRaster* canvas, int tile_idx, int* out_len);
+
+#endif // CANVAS_H
@@ -0,0 +1,268 @@
+#include "checkpoint.h"
+#include "matchmaking.h"
+#include "reconnection.h"
+#include "../tcp/tcp_handler.h"
+#include "../utils/serial.h"
+#include "../utils/crc32.h"
+#include "../utils/timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <pthread.h>
+
+#define CHECKPOINT_MAGIC 0x54504B43  // "CKPT"
+#define CHECKPOINT_VERSION 2
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t crc;          // Over the payload
+    uint32_t reserved;
+    uint64_t payload_len;
+    uint64_t written_at;   // Wall clock, for the restore log line
+} CheckpointHeader;
+
+static char checkpoint_path[256];
+static bool checkpoint_running = false;
+static uint64_t next_capture_at = 0;
+static uint32_t last_crc = 0;
+
+// Reactor -> writer: at most one snapshot in flight; a capture that finds
+// the writer still busy is skipped rather than waited for. The rooms
+// captured in between live in matchmaking.c.
+static SerialWriter pending_head;
+static SerialWriter pending_tail;
+static bool pending_ready = false;
+static pthread_mutex_t checkpoint_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t checkpoint_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t checkpoint_tid;
+
+// Reactor side: scores and sessions are small and serialized here; rooms
+// are only copied
+static void capture(SerialWriter* head, SerialWriter* tail) {
+    tcp_handler_export(head);
+    matchmaking_checkpoint_capture();
+    reconnection_export(tail);
+}
+
+// Writer side: the payload checkpoint_restore() reads
+static void assemble(SerialWriter* w, const SerialWriter* head, const SerialWriter* tail) {
+    serial_put_bytes(w, head->data, head->len);
+    matchmaking_checkpoint_write(w);
+    serial_put_bytes(w, tail->data, tail->len);
+    if (head->failed || tail->failed) w->failed = true;
+}
+
+static int write_all(int fd, const void* data, size_t len) {
+    const char* p = data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Write to a temp file and rename over the old checkpoint, so a crash
+// mid-write leaves the previous one intact
+static int write_checkpoint(const char* path, const SerialWriter* w) {
+    char tmp_path[sizeof(checkpoint_path) + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    CheckpointHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = CHECKPOINT_MAGIC;
+    header.version = CHECKPOINT_VERSION;
+    header.crc = crc32_compute(w->data, w->len);
+    header.payload_len = w->len;
+    header.written_at = get_current_time_ms();
+
+    // Session tokens are in there; a leftover temp file may predate that
+    unlink(tmp_path);
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        perror("[CHECKPOINT] open");
+        return -1;
+    }
+    if (write_all(fd, &header, sizeof(header)) < 0 || write_all(fd, w->data, w->len) < 0 ||
+        fsync(fd) < 0) {
+        perror("[CHECKPOINT] write");
+        close(fd);
+        unlink(tmp_path);
+        return -1;
+    }
+    close(fd);
+
+    if (rename(tmp_path, path) < 0) {
+        perror("[CHECKPOINT] rename");
+        unlink(tmp_path);
+        return -1;
+    }
+
+    // Make the rename itself durable
+    char dir_path[sizeof(checkpoint_path)];
+    snprintf(dir_path, sizeof(dir_path), "%s", path);
+    int dir_fd = open(dirname(dir_path), O_RDONLY | O_DIRECTORY);
+    if (dir_fd >= 0) {
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+    return 0;
+}
+
+static void* checkpoint_thread(void* arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&checkpoint_mutex);
+    for (;;) {
+        while (checkpoint_running && !pending_ready) {
+            pthread_cond_wait(&checkpoint_cond, &checkpoint_mutex);
+        }
+        if (!pending_ready) break;
+
+        // pending stays claimed while we write, so captures skip meanwhile
+        pthread_mutex_unlock(&checkpoint_mutex);
+        SerialWriter w;
+        serial_writer_init(&w);
+        assemble(&w, &pending_head, &pending_tail);
+        serial_writer_free(&pending_head);
+        serial_writer_free(&pending_tail);
+
+        // An idle server produces the same bytes every time; don't rewrite them
+        uint32_t crc = crc32_compute(w.data, w.len);
+        if (!w.failed && crc != last_crc) {
+            last_crc = crc;
+            write_checkpoint(checkpoint_path, &w);
+        }
+        serial_writer_free(&w);
+        pthread_mutex_lock(&checkpoint_mutex);
+
+        pending_ready = false;
+    }
+    pthread_mutex_unlock(&checkpoint_mutex);
+    return NULL;
+}
+
+// Startup only, before any client can connect
+int checkpoint_restore(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        if (errno != ENOENT) perror("[CHECKPOINT] open");
+        return -1;
+    }
+
+    CheckpointHeader header;
+    uint8_t* payload = NULL;
+    ssize_t n = read(fd, &header, sizeof(header));
+    if (n != (ssize_t)sizeof(header) || header.magic != CHECKPOINT_MAGIC ||
+        header.version != CHECKPOINT_VERSION) {
+        fprintf(stderr, "[CHECKPOINT] Ignoring %s: unknown format\n", path);
+        close(fd);
+        return -1;
+    }
+
+    payload = malloc(header.payload_len ? header.payload_len : 1);
+    if (!payload || read(fd, payload, header.payload_len) != (ssize_t)header.payload_len ||
+        crc32_compute(payload, header.payload_len) != header.crc) {
+        fprintf(stderr, "[CHECKPOINT] Ignoring %s: truncated or corrupt\n", path);
+        free(payload);
+        close(fd);
+        return -1;
+    }
+    close(fd);
+
+    SerialReader r;
+    serial_reader_init(&r, payload, header.payload_len);
+    int result = 0;
+    if (tcp_handler_import(&r) < 0 || matchmaking_restore(&r) < 0 ||
+        reconnection_import(&r) < 0 || r.pos != r.len) {
+        fprintf(stderr, "[CHECKPOINT] Failed to restore %s, starting empty\n", path);
+        init_matchmaking();
+        init_reconnection();
+        result = -1;
+    } else {
+        uint64_t age_ms = get_current_time_ms() - header.written_at;
+        printf("[CHECKPOINT] Restored state from %s (%llu ms old)\n",
+               path, (unsigned long long)age_ms);
+    }
+
+    free(payload);
+    return result;
+}
+
+int checkpoint_init(const char* path) {
+    snprintf(checkpoint_path, sizeof(checkpoint_path), "%s", path);
+    serial_writer_init(&pending_head);
+    serial_writer_init(&pending_tail);
+    pending_ready = false;
+    next_capture_at = get_current_time_ms() + CHECKPOINT_INTERVAL_MS;
+
+    checkpoint_running = true;
+    if (pthread_create(&checkpoint_tid, NULL, checkpoint_thread, NULL) != 0) {
+        checkpoint_running = false;
+        perror("[CHECKPOINT] Failed to start checkpoint thread");
+        return -1;
+    }
+    return 0;
+}
+
+// Reactor thread: copy the current state and hand it to the writer, which
+// serializes the rooms and skips the write if nothing changed
+void checkpoint_capture_if_due(uint64_t now) {
+    if (!checkpoint_running || now < next_capture_at) return;
+    next_capture_at = now + CHECKPOINT_INTERVAL_MS;
+
+    pthread_mutex_lock(&checkpoint_mutex);
+    bool busy = pending_ready;
+    pthread_mutex_unlock(&checkpoint_mutex);
+    if (busy) return;
+
+    SerialWriter head, tail;
+    serial_writer_init(&head);
+    serial_writer_init(&tail);
+    capture(&head, &tail);
+
+    pthread_mutex_lock(&checkpoint_mutex);
+    pending_head = head;
+    pending_tail = tail;
+    pending_ready = true;
+    pthread_cond_signal(&checkpoint_cond);
+    pthread_mutex_unlock(&checkpoint_mutex);
+}
+
+// With final_snapshot, the caller has stopped the reactor and a last
+// checkpoint is written synchronously
+void checkpoint_shutdown(bool final_snapshot) {
+    pthread_mutex_lock(&checkpoint_mutex);
+    bool was_running = checkpoint_running;
+    checkpoint_running = false;
+    pthread_cond_signal(&checkpoint_cond);
+    pthread_mutex_unlock(&checkpoint_mutex);
+
+    if (!was_running) return;
+    pthread_join(checkpoint_tid, NULL);  // Finishes a write in flight
+
+    if (final_snapshot) {
+        SerialWriter head, tail, w;
+        serial_writer_init(&head);
+        serial_writer_init(&tail);
+        serial_writer_init(&w);
+        capture(&head, &tail);
+        assemble(&w, &head, &tail);
+        serial_writer_free(&head);
+        serial_writer_free(&tail);
+        if (!w.failed && write_checkpoint(checkpoint_path, &w) == 0) {
+            printf("[CHECKPOINT] Saved %zu bytes to %s\n", w.len, checkpoint_path);
+        }
+        serial_writer_free(&w);
+    }
+    last_crc = 0;
+}
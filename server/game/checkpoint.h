@@ -0,0 +1,21 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "../protocol.h"
+
+// Crash recovery. The reactor thread periodically copies rooms, scores and
+// reconnect sessions into memory (rooms whose versions haven't moved aren't
+// copied again) and a background thread serializes the copy and writes it
+// to disk, so game threads never wait on it. On startup the last checkpoint
+// is restored: every player becomes a saved session and can resume with
+// MSG_RECONNECT_REQUEST.
+
+#define CHECKPOINT_PATH "server/rooms.ckpt"
+#define CHECKPOINT_INTERVAL_MS 2000
+
+int checkpoint_restore(const char* path);
+int checkpoint_init(const char* path);
+void checkpoint_shutdown(bool final_snapshot);
+void checkpoint_capture_if_due(uint64_t now);
+
+#endif // CHECKPOINT_H
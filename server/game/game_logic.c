@@ -3,6 +3,8 @@
 #include "../utils/timer.h"
 #include "../utils/json.h"
 #include "../tcp/tcp_handler.h"
+#include "canvas.h"
+#include "stats.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -55,6 +57,7 @@ const char* get_random_word() {
 
 void init_room(Room* room, uint32_t room_id, bool is_private) {
     memset(room, 0, sizeof(Room));
+    pthread_mutex_init(&room->stroke_lock, NULL);
     room->room_id = room_id;
     room->is_private = is_private;
     room->created_at = get_current_time_ms();
@@ -74,6 +77,22 @@ void init_room(Room* room, uint32_t room_id, bool is_private) {
     log_room_event(room_id, "created", is_private ? "private" : "public");
 }
 
+// Anything json_create_room_state() reports must call this when it changes
+void room_state_changed(Room* room) {
+    room->state_version++;
+}
+
+// Send only what changed; fields is the inside of a JSON object without braces.
+// Clients apply patches in seq order on top of their last full state.
+void broadcast_room_patch(Room* room, const char* fields, Player* exclude) {
+    room->patch_seq++;
+    room_state_changed(room);  // Full states must report the new seq
+    
+    char patch[BUFFER_SIZE - 64];
+    snprintf(patch, sizeof(patch), "{\"seq\":%u,%s}", room->patch_seq, fields);
+    broadcast_to_room(room, MSG_ROOM_PATCH, patch, exclude);
+}
+
 int add_player_to_room(Room* room, Player* player) {
     if (room->player_count >= MAX_PLAYERS) {
         return -1;
@@ -82,6 +101,7 @@ int add_player_to_room(Room* room, Player* player) {
     room->players[room->player_count] = player;
     room->player_count++;
     player->state = PLAYER_IN_ROOM;
+    room_state_changed(room);
     
     log_room_event(room->room_id, "player_joined", player->username);
     
@@ -110,9 +130,13 @@ int remove_player_from_room(Room* room, Player* player) {
     }
     room->players[room->player_count - 1] = NULL;
     room->player_count--;
+    room_state_changed(room);
     
     printf("[GAME] Player %s left. Remaining: %d players\n", player->username, room->player_count);
     
+    bool round_over = false;
+    bool game_over = false;
+    
     // If game is in progress, adjust rounds and drawer index
     if (was_in_game && room->player_count >= 2) {
         // Recalculate total rounds based on remaining players who haven't drawn
@@ -124,6 +148,7 @@ int remove_player_from_room(Room* room, Player* player) {
         }
         
         room->total_rounds = room->round_number + remaining_rounds;
+        room_state_changed(room);
         printf("[GAME] Adjusted total rounds to %d (current: %d, remaining: %d)\n",
                room->total_rounds, room->round_number, remaining_rounds);
         
@@ -136,16 +161,30 @@ int remove_player_from_room(Room* room, Player* player) {
                 room->current_drawer_idx = room->player_count - 1;
             }
             printf("[GAME] Current drawer left, ending round early\n");
-            end_round(room);
+            round_over = true;
         } else {
             // Adjust drawer index if it was after the removed player
             if (room->current_drawer_idx > player_idx) {
                 room->current_drawer_idx--;
+                room_state_changed(room);
             }
         }
     } else if (room->player_count < 2 && was_in_game) {
         // Not enough players to continue
         printf("[GAME] Not enough players remaining, ending game\n");
+        game_over = true;
+    }
+    
+    // Remaining players drop the leaver before any round/game end snapshot
+    char fields[256];
+    snprintf(fields, sizeof(fields),
+             "\"leave\":%u,\"player_count\":%d,\"current_drawer\":%d,\"total_rounds\":%d",
+             player->player_id, room->player_count, room->current_drawer_idx, room->total_rounds);
+    broadcast_room_patch(room, fields, NULL);
+    
+    if (round_over) {
+        end_round(room);
+    } else if (game_over) {
         end_game(room);
     }
     
@@ -168,6 +207,7 @@ void start_game(Room* room) {
             room->players[i]->has_drawn = false;  // Track if player has had their turn
         }
     }
+    room_state_changed(room);
     
     printf("[GAME] Starting game with %d players, %d total rounds\n", 
            room->player_count, room->total_rounds);
@@ -177,6 +217,7 @@ void start_game(Room* room) {
 
 void start_next_round(Room* room) {
     room->round_number++;
+    room_state_changed(room);
     
     // Check if all remaining players have had their turn or if we've exceeded total rounds
     int players_who_havent_drawn = 0;
@@ -221,7 +262,8 @@ void start_next_round(Room* room) {
     
     room->time_remaining = ROUND_TIME;
     room->round_start_time = get_current_time_ms();
-    room->stroke_count = 0;
+    room->round_deadline = get_monotonic_time_ms() + ROUND_TIME * 1000;
+    clear_strokes(room);
     
     // Reset player states
     for (int i = 0; i < room->player_count; i++) {
@@ -235,6 +277,7 @@ void start_next_round(Room* room) {
                    room->players[i]->is_drawing, room->players[i]->state);
         }
     }
+    room_state_changed(room);
     
     log_room_event(room->room_id, "round_started", room->current_word);
 }
@@ -253,6 +296,7 @@ void end_round(Room* room) {
     room_state = json_create_room_state(room);
     broadcast_to_room(room, MSG_ROUND_START, room_state, NULL);
     free(room_state);
+    send_room_timer(room, NULL);
     
     // Send word to new drawer
     if (room->players[room->current_drawer_idx]) {
@@ -273,6 +317,7 @@ void end_round(Room* room) {
 
 void end_game(Room* room) {
     room->state = ROOM_ENDED;
+    room_state_changed(room);
     
     // Find winner
     int max_score = -1;
@@ -288,6 +333,13 @@ void end_game(Room* room) {
         log_room_event(room->room_id, "game_ended", winner->username);
     }
     
+    for (int i = 0; i < room->player_count; i++) {
+        if (room->players[i]) {
+            stats_record_game(room->players[i]->username, room->players[i]->score,
+                              room->players[i] == winner);
+        }
+    }
+    
     // Broadcast game end with final scores
     char* room_state = json_create_room_state(room);
     broadcast_to_room(room, MSG_GAME_END, room_state, NULL);
@@ -328,14 +380,21 @@ int process_guess(Room* room, Player* player, const char* guess) {
         // Score based on time remaining (more time = more points)
         int points = 10 + (room->time_remaining * 90 / ROUND_TIME);
         player->score += points;
+        room_state_changed(room);
         
         log_guess(room->room_id, player->player_id, guess, true);
         log_score(room->room_id, player->player_id, player->score);
         
-        // Broadcast score update
-        char* room_state = json_create_room_state(room);
-        broadcast_to_room(room, MSG_SCORE_UPDATE, room_state, NULL);
-        free(room_state);
+        uint64_t round_start = room->round_deadline - (uint64_t)ROUND_TIME * 1000;
+        uint64_t now = get_monotonic_time_ms();
+        stats_record_guess(player->username, points,
+                           now > round_start ? (uint32_t)(now - round_start) : 0);
+        
+        // Only the guesser's score changed
+        char fields[128];
+        snprintf(fields, sizeof(fields), "\"players\":[{\"player_id\":%u,\"score\":%d}]",
+                 player->player_id, player->score);
+        broadcast_room_patch(room, fields, NULL);
         
         // Check if all players have guessed
         int guessed_count = 0;
@@ -361,34 +420,72 @@ int process_guess(Room* room, Player* player, const char* guess) {
 void update_timer(Room* room) {
     if (room->state != ROOM_PLAYING) return;
     
-    uint64_t elapsed = (get_current_time_ms() - room->round_start_time) / 1000;
-    room->time_remaining = ROUND_TIME - (int)elapsed;
+    uint64_t now = get_monotonic_time_ms();
+    int remaining = now >= room->round_deadline ? 0 :
+                    (int)((room->round_deadline - now + 999) / 1000);
+    
+    if (remaining != room->time_remaining) {
+        room->time_remaining = remaining;
+        room_state_changed(room);
+    }
     
     if (room->time_remaining <= 0) {
-        room->time_remaining = 0;
         end_round(room);
     }
     
     log_timer(room->room_id, room->time_remaining);
 }
 
-void check_game_start_countdown(Room* room) {
-    if (!room->countdown_active || room->state != ROOM_WAITING) return;
+// Send the running deadline (round or pre-game countdown) instead of a tick
+// every second; clients count down locally from deadline - server_now.
+// only == NULL broadcasts to the whole room.
+void send_room_timer(Room* room, Player* only) {
+    uint64_t now = get_monotonic_time_ms();
+    uint64_t deadline;
+    MessageType type;
+    const char* field;
+    
+    if (room->state == ROOM_PLAYING) {
+        type = MSG_TIMER_UPDATE;
+        field = "time_remaining";
+        deadline = room->round_deadline;
+    } else if (room->state == ROOM_WAITING && room->countdown_active) {
+        type = MSG_COUNTDOWN_UPDATE;
+        field = "countdown";
+        deadline = room->countdown_deadline;
+    } else {
+        return;  // Nothing is counting down
+    }
     
-    uint64_t elapsed = (get_current_time_ms() - room->game_start_countdown) / 1000;
-    int remaining = 15 - (int)elapsed;
+    int remaining = now >= deadline ? 0 : (int)((deadline - now + 999) / 1000);
+    char msg[160];
+    snprintf(msg, sizeof(msg), "{\"deadline\":%llu,\"server_now\":%llu,\"%s\":%d}",
+             (unsigned long long)deadline, (unsigned long long)now, field, remaining);
     
-    // Broadcast countdown update to players
-    if (remaining > 0 && remaining <= 15) {
-        char countdown_msg[128];
-        snprintf(countdown_msg, sizeof(countdown_msg), "{\"countdown\":%d}", remaining);
-        broadcast_to_room(room, MSG_COUNTDOWN_UPDATE, countdown_msg, NULL);
+    if (only) {
+        send_tcp_message(only->fd, type, msg);
+    } else {
+        broadcast_to_room(room, type, msg, NULL);
+        room->timer_resync_at = now + TIMER_RESYNC_INTERVAL_MS;
+    }
+}
+
+// Occasional re-send so clients whose clocks drifted converge again
+void resync_room_timer(Room* room) {
+    if (get_monotonic_time_ms() >= room->timer_resync_at) {
+        send_room_timer(room, NULL);
     }
+}
+
+void check_game_start_countdown(Room* room) {
+    if (!room->countdown_active || room->state != ROOM_WAITING) return;
     
-    // Start game after 15 seconds if at least 2 players and round hasn't started
-    if (elapsed >= 15 && room->player_count >= 2) {
-        printf("[COUNTDOWN] Starting game for room %u after %llu seconds with %d players\n", 
-               room->room_id, elapsed, room->player_count);
+    // Clients count down from the deadline they were sent when the countdown began
+    
+    // Start game once the countdown runs out if at least 2 players and round hasn't started
+    if (get_monotonic_time_ms() >= room->countdown_deadline && room->player_count >= 2) {
+        printf("[COUNTDOWN] Starting game for room %u with %d players\n", 
+               room->room_id, room->player_count);
         room->countdown_active = false;
         start_game(room);
         
@@ -396,6 +493,7 @@ void check_game_start_countdown(Room* room) {
         char* game_state = json_create_room_state(room);
         broadcast_to_room(room, MSG_GAME_START, game_state, NULL);
         free(game_state);
+        send_room_timer(room, NULL);
         
         // Send the actual word to the drawer
         if (room->players[room->current_drawer_idx]) {
@@ -417,13 +515,97 @@ void check_game_start_countdown(Room* room) {
     }
 }
 
-void add_stroke(Room* room, const Stroke* stroke) {
-    if (room->stroke_count < MAX_STROKES) {
-        room->strokes[room->stroke_count] = *stroke;
-        room->strokes[room->stroke_count].stroke_id = room->stroke_count;
-        log_stroke(room->room_id, room->stroke_count, stroke);
-        room->stroke_count++;
+// Caller holds room->stroke_lock
+static bool store_stroke(Room* room, const Stroke* stroke) {
+    if (!room->canvas) {
+        room->canvas = canvas_create();
+    }
+    canvas_draw_stroke(room->canvas, stroke);
+    
+    if (room->stroke_count >= MAX_STROKES) {
+        room->stroke_log_overflowed = true;
+        return false;
     }
+    
+    // A new group id means the pen went up and down again
+    StrokeGroup* group = room->group_count > 0 ? &room->stroke_groups[room->group_count - 1] : NULL;
+    if (!group || group->group_id != stroke->group_id) {
+        if (room->group_count < MAX_STROKE_GROUPS) {
+            group = &room->stroke_groups[room->group_count++];
+            group->group_id = stroke->group_id;
+            group->first_stroke = room->stroke_count;
+            group->stroke_count = 0;
+        } else {
+            group = NULL;  // Index full: stored, but not undoable (nor is anything before it)
+        }
+    }
+    if (group) {
+        group->stroke_count++;
+    }
+    
+    room->strokes[room->stroke_count] = *stroke;
+    room->strokes[room->stroke_count].stroke_id = room->stroke_count;
+    log_stroke(room->room_id, room->stroke_count, stroke);
+    room->stroke_count++;
+    room->strokes_version++;
+    return true;
+}
+
+// Draw strokes onto the canvas and append them to the log. Returns where
+// strokes[0] now sits in room->strokes, or -1 if the log had no room for
+// all of them (the canvas still has every one).
+int add_strokes(Room* room, const Stroke* strokes, int count) {
+    pthread_mutex_lock(&room->stroke_lock);
+    int first_stroke = room->stroke_count;
+    int stored = 0;
+    for (int i = 0; i < count; i++) {
+        if (store_stroke(room, &strokes[i])) stored++;
+    }
+    pthread_mutex_unlock(&room->stroke_lock);
+    
+    return stored == count ? first_stroke : -1;
+}
+
+int undo_last_stroke_group(Room* room, StrokeGroup* out_group) {
+    pthread_mutex_lock(&room->stroke_lock);
+    
+    // Groups are contiguous, so while the last one is at the tail of the
+    // stroke log, undo is a truncate plus a raster rebuild. Once the index
+    // is full, later strokes are stored ungrouped after it; truncating
+    // would take those too while clients remove only the group, so undo
+    // is over for this canvas. The same goes once the log itself is full:
+    // the raster rebuilt from it would lose every stroke it had no room for.
+    StrokeGroup* group = room->group_count > 0 ? &room->stroke_groups[room->group_count - 1] : NULL;
+    if (!group || room->stroke_log_overflowed || group->first_stroke + group->stroke_count != room->stroke_count) {
+        pthread_mutex_unlock(&room->stroke_lock);
+        return -1;
+    }
+    room->group_count--;
+    *out_group = *group;
+    room->stroke_count = group->first_stroke;
+    room->strokes_version++;
+    
+    canvas_clear(room->canvas);
+    for (int i = 0; i < room->stroke_count; i++) {
+        canvas_draw_stroke(room->canvas, &room->strokes[i]);
+    }
+    pthread_mutex_unlock(&room->stroke_lock);
+    
+    log_room_event(room->room_id, "stroke_group_undone", "");
+    return 0;
+}
+
+void clear_strokes(Room* room) {
+    pthread_mutex_lock(&room->stroke_lock);
+    room->stroke_count = 0;
+    room->group_count = 0;
+    room->stroke_log_overflowed = false;
+    room->canvas_epoch++;
+    room->strokes_version++;
+    canvas_clear(room->canvas);
+    pthread_mutex_unlock(&room->stroke_lock);
+    // The reactor owns pending_path and stroke_batch and drops them when it
+    // sees the new epoch; this may be the timer thread
 }
 
 void cleanup_word_list() {
@@ -6,6 +6,8 @@
 int load_word_list(const char* filename);
 const char* get_random_word();
 void init_room(Room* room, uint32_t room_id, bool is_private);
+void room_state_changed(Room* room);
+void broadcast_room_patch(Room* room, const char* fields, Player* exclude);
 int add_player_to_room(Room* room, Player* player);
 int remove_player_from_room(Room* room, Player* player);
 void start_game(Room* room);
@@ -14,8 +16,12 @@ void end_round(Room* room);
 void end_game(Room* room);
 int process_guess(Room* room, Player* player, const char* guess);
 void update_timer(Room* room);
+void send_room_timer(Room* room, Player* only);
+void resync_room_timer(Room* room);
 void check_game_start_countdown(Room* room);
-void add_stroke(Room* room, const Stroke* stroke);
+int add_strokes(Room* room, const Stroke* strokes, int count);
+int undo_last_stroke_group(Room* room, StrokeGroup* out_group);
+void clear_strokes(Room* room);
 void cleanup_word_list();
 
 #endif // GAME_LOGIC_H
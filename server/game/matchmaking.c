@@ -3,8 +3,12 @@
 #include "../utils/json.h"
 #include "../utils/timer.h"
 #include "../tcp/tcp_handler.h"
+#include "../tcp/tcp_server.h"
 #include "game_logic.h"
+#include "canvas.h"
+#include "reconnection.h"
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdio.h>
 
@@ -16,15 +20,24 @@ static int queue_size = 0;
 static uint32_t next_room_id = 1;
 static pthread_mutex_t matchmaking_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+// Empty rooms restored from a checkpoint stay reserved for their players
+static bool room_in_use(const Room* room) {
+    return room->player_count > 0 ||
+           (room->restored_until != 0 && get_current_time_ms() < room->restored_until);
+}
+
 void init_matchmaking() {
     memset(rooms, 0, sizeof(rooms));
+    for (int i = 0; i < MAX_ROOMS; i++) {
+        pthread_mutex_init(&rooms[i].stroke_lock, NULL);
+    }
     memset(waiting_queue, 0, sizeof(waiting_queue));
     queue_size = 0;
 }
 
 Room* find_room_by_id(uint32_t room_id) {
     for (int i = 0; i < MAX_ROOMS; i++) {
-        if (rooms[i].room_id == room_id && rooms[i].player_count > 0) {
+        if (rooms[i].room_id == room_id && room_in_use(&rooms[i])) {
             return &rooms[i];
         }
     }
@@ -45,7 +58,7 @@ void iterate_active_rooms(void (*callback)(Room*)) {
 Room* find_room_by_code(const char* code) {
     for (int i = 0; i < MAX_ROOMS; i++) {
         if (rooms[i].is_private && 
-            rooms[i].player_count > 0 && 
+            room_in_use(&rooms[i]) && 
             strcmp(rooms[i].room_code, code) == 0) {
             return &rooms[i];
         }
@@ -59,7 +72,9 @@ Room* create_private_room() {
     // Find empty room slot
     Room* room = NULL;
     for (int i = 0; i < MAX_ROOMS; i++) {
-        if (rooms[i].player_count == 0) {
+        if (!room_in_use(&rooms[i])) {
+            canvas_destroy(rooms[i].canvas);
+            free(rooms[i].state_json);
             room = &rooms[i];
             init_room(room, next_room_id++, true);
             break;
@@ -130,7 +145,9 @@ int join_matchmaking(Player* player) {
     // If no suitable room found, create new one
     if (!best_room) {
         for (int i = 0; i < MAX_ROOMS; i++) {
-            if (rooms[i].player_count == 0) {
+            if (!room_in_use(&rooms[i])) {
+                canvas_destroy(rooms[i].canvas);
+                free(rooms[i].state_json);
                 best_room = &rooms[i];
                 init_room(best_room, next_room_id++, false);
                 break;
@@ -149,9 +166,11 @@ int join_matchmaking(Player* player) {
     if (best_room->player_count == 2 && !best_room->countdown_active) {
         best_room->countdown_active = true;
         best_room->game_start_countdown = get_current_time_ms();
+        best_room->countdown_deadline = get_monotonic_time_ms() + GAME_START_COUNTDOWN * 1000;
         printf("[COUNTDOWN] Room %u countdown started with %d players at timestamp %llu\n", 
                best_room->room_id, best_room->player_count, best_room->game_start_countdown);
         log_room_event(best_room->room_id, "countdown_started", "15s until game starts");
+        send_room_timer(best_room, NULL);
     }
     
     // Start game immediately if room is full
@@ -163,6 +182,7 @@ int join_matchmaking(Player* player) {
         char* game_state = json_create_room_state(best_room);
         broadcast_to_room(best_room, MSG_GAME_START, game_state, NULL);
         free(game_state);
+        send_room_timer(best_room, NULL);
         
         // Send the actual word to the drawer
         if (best_room->players[best_room->current_drawer_idx]) {
@@ -188,7 +208,13 @@ void leave_room(Player* player) {
                 
                 // If room is empty, reset it
                 if (rooms[i].player_count == 0) {
+                    pthread_mutex_lock(&rooms[i].stroke_lock);
+                    canvas_destroy(rooms[i].canvas);
+                    rooms[i].canvas = NULL;
+                    pthread_mutex_unlock(&rooms[i].stroke_lock);
+                    free(rooms[i].state_json);
                     memset(&rooms[i], 0, sizeof(Room));
+                    pthread_mutex_init(&rooms[i].stroke_lock, NULL);
                 }
                 
                 pthread_mutex_unlock(&matchmaking_mutex);
@@ -210,3 +236,524 @@ Room* get_player_room(Player* player) {
     }
     return NULL;
 }
+
+static void put_stroke(SerialWriter* w, const Stroke* stroke) {
+    serial_put_u32(w, stroke->stroke_id);
+    serial_put_float(w, stroke->x1);
+    serial_put_float(w, stroke->y1);
+    serial_put_float(w, stroke->x2);
+    serial_put_float(w, stroke->y2);
+    serial_put_u32(w, stroke->color);
+    serial_put_u8(w, stroke->thickness);
+    serial_put_u32(w, stroke->group_id);
+    serial_put_u64(w, stroke->timestamp);
+}
+
+static void get_stroke(SerialReader* r, Stroke* stroke) {
+    stroke->stroke_id = serial_get_u32(r);
+    stroke->x1 = serial_get_float(r);
+    stroke->y1 = serial_get_float(r);
+    stroke->x2 = serial_get_float(r);
+    stroke->y2 = serial_get_float(r);
+    stroke->color = serial_get_u32(r);
+    stroke->thickness = serial_get_u8(r);
+    stroke->group_id = serial_get_u32(r);
+    stroke->timestamp = serial_get_u64(r);
+}
+
+// The part of a room covered by state_version and strokes_version: everything
+// but its players, clock-relative deadlines and not-yet-fanned-out strokes
+static void put_room_body(SerialWriter* w, const Room* room) {
+    serial_put_u32(w, room->room_id);
+    serial_put_str(w, room->room_code);
+    serial_put_u32(w, room->state);
+    serial_put_i32(w, room->current_drawer_idx);
+    serial_put_str(w, room->current_word);
+    serial_put_i32(w, room->round_number);
+    serial_put_i32(w, room->total_rounds);
+    serial_put_u64(w, room->round_start_time);
+    serial_put_i32(w, room->time_remaining);
+    
+    serial_put_u32(w, (uint32_t)room->stroke_count);
+    for (int j = 0; j < room->stroke_count; j++) {
+        put_stroke(w, &room->strokes[j]);
+    }
+    serial_put_u32(w, (uint32_t)room->group_count);
+    for (int j = 0; j < room->group_count; j++) {
+        serial_put_u32(w, room->stroke_groups[j].group_id);
+        serial_put_i32(w, room->stroke_groups[j].first_stroke);
+        serial_put_i32(w, room->stroke_groups[j].stroke_count);
+    }
+    serial_put_u8(w, room->stroke_log_overflowed);
+    serial_put_u32(w, room->canvas_epoch);
+    
+    serial_put_u32(w, room->state_version);
+    serial_put_u32(w, room->patch_seq);
+    serial_put_u8(w, room->is_private);
+    serial_put_u64(w, room->created_at);
+}
+
+static void get_room_body(SerialReader* r, Room* room) {
+    room->room_id = serial_get_u32(r);
+    serial_get_str(r, room->room_code, sizeof(room->room_code));
+    room->state = (RoomState)serial_get_u32(r);
+    room->current_drawer_idx = serial_get_i32(r);
+    serial_get_str(r, room->current_word, sizeof(room->current_word));
+    room->round_number = serial_get_i32(r);
+    room->total_rounds = serial_get_i32(r);
+    room->round_start_time = serial_get_u64(r);
+    room->time_remaining = serial_get_i32(r);
+    
+    uint32_t stroke_count = serial_get_u32(r);
+    if (stroke_count > MAX_STROKES) {
+        r->failed = true;
+        return;
+    }
+    for (uint32_t j = 0; j < stroke_count; j++) {
+        get_stroke(r, &room->strokes[j]);
+    }
+    room->stroke_count = (int)stroke_count;
+    
+    uint32_t group_count = serial_get_u32(r);
+    if (group_count > MAX_STROKE_GROUPS) {
+        r->failed = true;
+        return;
+    }
+    for (uint32_t j = 0; j < group_count; j++) {
+        room->stroke_groups[j].group_id = serial_get_u32(r);
+        room->stroke_groups[j].first_stroke = serial_get_i32(r);
+        room->stroke_groups[j].stroke_count = serial_get_i32(r);
+    }
+    room->group_count = (int)group_count;
+    room->stroke_log_overflowed = serial_get_u8(r);
+    room->canvas_epoch = serial_get_u32(r);
+    
+    room->state_version = serial_get_u32(r);
+    room->patch_seq = serial_get_u32(r);
+    room->is_private = serial_get_u8(r);
+    room->created_at = serial_get_u64(r);
+    
+    // Rebuild the raster late joiners are served from
+    if (room->stroke_count > 0) {
+        room->canvas = canvas_create();
+        for (int j = 0; j < room->stroke_count; j++) {
+            canvas_draw_stroke(room->canvas, &room->strokes[j]);
+        }
+    }
+}
+
+// Live rooms, with players written as their index in the TCP server's table.
+// The canvas raster and cached state JSON are derived, so they are rebuilt.
+void matchmaking_export(SerialWriter* w) {
+    pthread_mutex_lock(&matchmaking_mutex);
+    
+    uint32_t live = 0;
+    for (int i = 0; i < MAX_ROOMS; i++) {
+        if (room_in_use(&rooms[i])) live++;
+    }
+    
+    serial_put_u32(w, next_room_id);
+    serial_put_u32(w, MAX_PLAYERS);
+    serial_put_u32(w, live);
+    
+    for (int i = 0; i < MAX_ROOMS; i++) {
+        const Room* room = &rooms[i];
+        if (!room_in_use(room)) continue;
+        
+        serial_put_u32(w, (uint32_t)i);
+        put_room_body(w, room);
+        serial_put_u32(w, room->strokes_version);
+        
+        for (int j = 0; j < MAX_PLAYERS; j++) {
+            serial_put_i32(w, tcp_server_player_index(room->players[j]));
+        }
+        serial_put_i32(w, room->player_count);
+        serial_put_u64(w, room->round_deadline);
+        serial_put_u64(w, room->game_start_countdown);
+        serial_put_u8(w, room->countdown_active);
+        serial_put_u64(w, room->countdown_deadline);
+        serial_put_u64(w, room->timer_resync_at);
+        serial_put_u64(w, room->restored_until);
+        serial_put_u32(w, room->udp_seq);
+        
+        // The resend window, so acks for datagrams sent before the handoff
+        // still find what they cover
+        uint32_t sent = 0;
+        for (int j = 0; j < UDP_RESEND_WINDOW; j++) {
+            if (room->udp_sent[j].seq != 0) sent++;
+        }
+        serial_put_u32(w, sent);
+        for (int j = 0; j < UDP_RESEND_WINDOW; j++) {
+            const UdpSentDatagram* d = &room->udp_sent[j];
+            if (d->seq == 0) continue;
+            serial_put_u32(w, d->seq);
+            serial_put_u32(w, d->epoch);
+            serial_put_i32(w, d->first_stroke);
+            serial_put_i32(w, d->stroke_count);
+            serial_put_u64(w, d->first_timestamp);
+            serial_put_u64(w, d->last_timestamp);
+            serial_put_u32(w, d->sender_id);
+            serial_put_u64(w, d->sent_at);
+        }
+        
+        // An open parity group, which the new process closes on time
+        const UdpFecGroup* fec = &room->fec;
+        serial_put_u32(w, (uint32_t)fec->count);
+        if (fec->count > 0) {
+            serial_put_u32(w, fec->first_seq);
+            serial_put_u32(w, (uint32_t)fec->size);
+            serial_put_u32(w, fec->sender_id);
+            serial_put_u64(w, fec->opened_at);
+            serial_put_u32(w, fec->len_xor);
+            serial_put_u32(w, fec->max_len);
+            serial_put_bytes(w, fec->parity, fec->max_len);
+        }
+        
+        const StrokePath* path = &room->pending_path;
+        serial_put_u32(w, (uint32_t)path->count);
+        for (int j = 0; j < path->count; j++) {
+            serial_put_float(w, path->xs[j]);
+            serial_put_float(w, path->ys[j]);
+        }
+        serial_put_u32(w, path->color);
+        serial_put_u8(w, path->thickness);
+        serial_put_u32(w, path->group_id);
+        serial_put_u64(w, path->started_at);
+        
+        serial_put_u32(w, (uint32_t)room->stroke_batch_count);
+        for (int j = 0; j < room->stroke_batch_count; j++) {
+            put_stroke(w, &room->stroke_batch[j]);
+        }
+        serial_put_i32(w, room->stroke_batch_first);
+        serial_put_u64(w, room->stroke_batch_started_at);
+    }
+    
+    pthread_mutex_unlock(&matchmaking_mutex);
+}
+
+// Players must already be in the TCP server's table (tcp_server_import)
+int matchmaking_import(SerialReader* r) {
+    pthread_mutex_lock(&matchmaking_mutex);
+    
+    next_room_id = serial_get_u32(r);
+    uint32_t max_players = serial_get_u32(r);
+    uint32_t live = serial_get_u32(r);
+    if (r->failed || max_players != MAX_PLAYERS || live > MAX_ROOMS) {
+        pthread_mutex_unlock(&matchmaking_mutex);
+        return -1;
+    }
+    
+    for (uint32_t n = 0; n < live && !r->failed; n++) {
+        uint32_t slot = serial_get_u32(r);
+        if (slot >= MAX_ROOMS) {
+            r->failed = true;
+            break;
+        }
+        Room* room = &rooms[slot];
+        memset(room, 0, sizeof(Room));
+        pthread_mutex_init(&room->stroke_lock, NULL);
+        
+        get_room_body(r, room);
+        room->strokes_version = serial_get_u32(r);
+        
+        for (int j = 0; j < MAX_PLAYERS; j++) {
+            room->players[j] = tcp_server_player_at(serial_get_i32(r));
+        }
+        room->player_count = serial_get_i32(r);
+        room->round_deadline = serial_get_u64(r);
+        room->game_start_countdown = serial_get_u64(r);
+        room->countdown_active = serial_get_u8(r);
+        room->countdown_deadline = serial_get_u64(r);
+        room->timer_resync_at = serial_get_u64(r);
+        room->restored_until = serial_get_u64(r);
+        room->udp_seq = serial_get_u32(r);
+        
+        uint32_t sent = serial_get_u32(r);
+        if (sent > UDP_RESEND_WINDOW) {
+            r->failed = true;
+            break;
+        }
+        for (uint32_t j = 0; j < sent; j++) {
+            uint32_t seq = serial_get_u32(r);
+            UdpSentDatagram* d = &room->udp_sent[seq % UDP_RESEND_WINDOW];
+            d->seq = seq;
+            d->epoch = serial_get_u32(r);
+            d->first_stroke = serial_get_i32(r);
+            d->stroke_count = serial_get_i32(r);
+            d->first_timestamp = serial_get_u64(r);
+            d->last_timestamp = serial_get_u64(r);
+            d->sender_id = serial_get_u32(r);
+            d->sent_at = serial_get_u64(r);
+        }
+        
+        UdpFecGroup* fec = &room->fec;
+        uint32_t fec_count = serial_get_u32(r);
+        if (fec_count > 0) {
+            fec->first_seq = serial_get_u32(r);
+            uint32_t fec_size = serial_get_u32(r);
+            fec->sender_id = serial_get_u32(r);
+            fec->opened_at = serial_get_u64(r);
+            fec->len_xor = (uint16_t)serial_get_u32(r);
+            uint32_t max_len = serial_get_u32(r);
+            if (fec_count > UDP_FEC_MAX_GROUP || fec_size > UDP_FEC_MAX_GROUP ||
+                max_len > sizeof(fec->parity)) {
+                r->failed = true;
+                break;
+            }
+            serial_get_bytes(r, fec->parity, max_len);
+            fec->count = (int)fec_count;
+            fec->size = (int)fec_size;
+            fec->max_len = (uint16_t)max_len;
+        }
+        
+        StrokePath* path = &room->pending_path;
+        uint32_t path_count = serial_get_u32(r);
+        if (path_count > STROKE_PATH_MAX_POINTS) {
+            r->failed = true;
+            break;
+        }
+        for (uint32_t j = 0; j < path_count; j++) {
+            path->xs[j] = serial_get_float(r);
+            path->ys[j] = serial_get_float(r);
+        }
+        path->count = (int)path_count;
+        path->color = serial_get_u32(r);
+        path->thickness = serial_get_u8(r);
+        path->group_id = serial_get_u32(r);
+        path->started_at = serial_get_u64(r);
+        
+        uint32_t batch_count = serial_get_u32(r);
+        if (batch_count > STROKE_BATCH_MAX) {
+            r->failed = true;
+            break;
+        }
+        for (uint32_t j = 0; j < batch_count; j++) {
+            get_stroke(r, &room->stroke_batch[j]);
+        }
+        room->stroke_batch_count = (int)batch_count;
+        room->stroke_batch_first = serial_get_i32(r);
+        room->stroke_batch_started_at = serial_get_u64(r);
+        room->stroke_batch_epoch = room->canvas_epoch;
+        
+        room_state_changed(room);
+        
+        if (room->player_count < 0 || room->player_count > MAX_PLAYERS) {
+            r->failed = true;
+        }
+    }
+    
+    int result = r->failed ? -1 : 0;
+    pthread_mutex_unlock(&matchmaking_mutex);
+    return result;
+}
+
+// Checkpoint state of one room slot. The reactor fills head and, when the
+// room's versions have moved, copy; the writer thread turns copy into body,
+// which is reused while the versions stay put. The two never overlap: the
+// reactor only captures while the writer is idle (see checkpoint.c).
+typedef struct {
+    bool live;
+    SerialWriter head;       // Deadlines and players, small enough to serialize on the reactor
+    Room* copy;              // What put_room_body() reads, taken under stroke_lock
+    bool copy_pending;       // copy is newer than body
+    SerialWriter body;
+    uint32_t room_id;
+    uint32_t state_version;
+    uint32_t strokes_version;
+} CheckpointSlot;
+
+static CheckpointSlot checkpoint_slots[MAX_ROOMS];
+static uint32_t checkpoint_next_room_id;
+
+static uint64_t remaining_ms(uint64_t deadline, uint64_t now) {
+    return deadline > now ? deadline - now : 0;
+}
+
+// Everything put_room_body() reads, with only the used part of the stroke
+// log and group index. Caller holds src->stroke_lock.
+static void copy_room_body(Room* dst, const Room* src) {
+    memcpy(dst, src, offsetof(Room, strokes));
+    memcpy(dst->strokes, src->strokes, (size_t)src->stroke_count * sizeof(Stroke));
+    dst->stroke_count = src->stroke_count;
+    memcpy(dst->stroke_groups, src->stroke_groups, (size_t)src->group_count * sizeof(StrokeGroup));
+    dst->group_count = src->group_count;
+    dst->stroke_log_overflowed = src->stroke_log_overflowed;
+    dst->canvas_epoch = src->canvas_epoch;
+    dst->state_version = src->state_version;
+    dst->patch_seq = src->patch_seq;
+    dst->is_private = src->is_private;
+    dst->created_at = src->created_at;
+}
+
+// Crash-recovery snapshot, reactor side: every player in a room is written
+// as a saved session, since their connections won't survive. Deadlines are
+// stored as time left, the monotonic clock being meaningless after a
+// reboot. Rooms whose strokes or state changed are copied, not serialized;
+// matchmaking_checkpoint_write() does that on the writer thread.
+void matchmaking_checkpoint_capture() {
+    pthread_mutex_lock(&matchmaking_mutex);
+    
+    uint64_t now = get_monotonic_time_ms();
+    checkpoint_next_room_id = next_room_id;
+    
+    for (int i = 0; i < MAX_ROOMS; i++) {
+        Room* room = &rooms[i];
+        CheckpointSlot* slot = &checkpoint_slots[i];
+        slot->live = room_in_use(room);
+        if (!slot->live) {
+            serial_writer_free(&slot->body);
+            slot->copy_pending = false;
+            continue;
+        }
+        
+        SerialWriter* w = &slot->head;
+        w->len = 0;
+        w->failed = false;
+        serial_put_u64(w, room->state == ROOM_PLAYING ? remaining_ms(room->round_deadline, now) : 0);
+        serial_put_u8(w, room->countdown_active);
+        serial_put_u64(w, room->countdown_active ? remaining_ms(room->countdown_deadline, now) : 0);
+        
+        uint32_t players = 0;
+        for (int j = 0; j < room->player_count; j++) {
+            if (room->players[j]) players++;
+        }
+        serial_put_u32(w, players);
+        for (int j = 0; j < room->player_count; j++) {
+            const Player* p = room->players[j];
+            if (!p) continue;
+            serial_put_str(w, p->session_token);
+            serial_put_u32(w, p->player_id);
+            serial_put_u32(w, p->state);
+            serial_put_i32(w, p->score);
+            serial_put_u8(w, p->is_drawing);
+            serial_put_u8(w, p->has_guessed);
+        }
+        
+        if (slot->body.len > 0 && !slot->copy_pending && slot->room_id == room->room_id &&
+            slot->state_version == room->state_version &&
+            slot->strokes_version == room->strokes_version) {
+            continue;
+        }
+        if (!slot->copy) {
+            slot->copy = malloc(sizeof(Room));
+            if (!slot->copy) {
+                w->failed = true;
+                continue;
+            }
+        }
+        pthread_mutex_lock(&room->stroke_lock);
+        copy_room_body(slot->copy, room);
+        pthread_mutex_unlock(&room->stroke_lock);
+        slot->copy_pending = true;
+        slot->room_id = room->room_id;
+        slot->state_version = room->state_version;
+        slot->strokes_version = room->strokes_version;
+    }
+    
+    pthread_mutex_unlock(&matchmaking_mutex);
+}
+
+// Crash-recovery snapshot, writer side: what the last capture took
+void matchmaking_checkpoint_write(SerialWriter* w) {
+    uint32_t live = 0;
+    for (int i = 0; i < MAX_ROOMS; i++) {
+        if (checkpoint_slots[i].live) live++;
+    }
+    
+    serial_put_u32(w, checkpoint_next_room_id);
+    serial_put_u32(w, live);
+    
+    for (int i = 0; i < MAX_ROOMS; i++) {
+        CheckpointSlot* slot = &checkpoint_slots[i];
+        if (!slot->live) continue;
+        
+        if (slot->copy_pending) {
+            slot->body.len = 0;
+            slot->body.failed = false;
+            put_room_body(&slot->body, slot->copy);
+            slot->copy_pending = false;
+        }
+        
+        serial_put_u32(w, (uint32_t)i);
+        serial_put_bytes(w, slot->head.data, slot->head.len);
+        serial_put_u32(w, (uint32_t)slot->body.len);
+        serial_put_bytes(w, slot->body.data, slot->body.len);
+        if (slot->head.failed || slot->body.failed) w->failed = true;
+    }
+}
+
+// Startup only. Restored rooms sit empty, reserved for RECONNECT_TIMEOUT,
+// until their players come back with their session tokens.
+int matchmaking_restore(SerialReader* r) {
+    pthread_mutex_lock(&matchmaking_mutex);
+    
+    uint64_t now = get_monotonic_time_ms();
+    uint64_t reserve_until = get_current_time_ms() + (uint64_t)RECONNECT_TIMEOUT * 1000;
+    
+    next_room_id = serial_get_u32(r);
+    uint32_t live = serial_get_u32(r);
+    if (r->failed || live > MAX_ROOMS) {
+        pthread_mutex_unlock(&matchmaking_mutex);
+        return -1;
+    }
+    
+    int restored_rooms = 0;
+    int restored_players = 0;
+    for (uint32_t n = 0; n < live && !r->failed; n++) {
+        uint32_t slot = serial_get_u32(r);
+        if (slot >= MAX_ROOMS) {
+            r->failed = true;
+            break;
+        }
+        Room* room = &rooms[slot];
+        memset(room, 0, sizeof(Room));
+        pthread_mutex_init(&room->stroke_lock, NULL);
+        
+        uint64_t round_left = serial_get_u64(r);
+        bool countdown_active = serial_get_u8(r);
+        uint64_t countdown_left = serial_get_u64(r);
+        
+        // Sessions have to be saved against the room's id, which comes later
+        uint32_t players = serial_get_u32(r);
+        if (players > MAX_PLAYERS) {
+            r->failed = true;
+            break;
+        }
+        Player saved[MAX_PLAYERS];
+        memset(saved, 0, sizeof(saved));
+        for (uint32_t j = 0; j < players; j++) {
+            serial_get_str(r, saved[j].session_token, sizeof(saved[j].session_token));
+            saved[j].player_id = serial_get_u32(r);
+            saved[j].state = (PlayerState)serial_get_u32(r);
+            saved[j].score = serial_get_i32(r);
+            saved[j].is_drawing = serial_get_u8(r);
+            saved[j].has_guessed = serial_get_u8(r);
+        }
+        
+        uint32_t body_len = serial_get_u32(r);
+        size_t body_end = r->pos + body_len;
+        get_room_body(r, room);
+        if (r->failed || r->pos != body_end) {
+            r->failed = true;
+            break;
+        }
+        
+        room->round_deadline = now + round_left;
+        room->countdown_active = countdown_active;
+        room->countdown_deadline = now + countdown_left;
+        room->restored_until = reserve_until;
+        room_state_changed(room);
+        
+        for (uint32_t j = 0; j < players; j++) {
+            save_player_state(&saved[j], room);
+        }
+        restored_rooms++;
+        restored_players += players;
+    }
+    
+    pthread_mutex_unlock(&matchmaking_mutex);
+    if (r->failed) return -1;
+    
+    printf("[CHECKPOINT] Restored %d rooms awaiting %d players\n", restored_rooms, restored_players);
+    return 0;
+}
@@ -2,6 +2,7 @@
 #define MATCHMAKING_H
 
 #include "../protocol.h"
+#include "../utils/serial.h"
 #include <pthread.h>
 
 void init_matchmaking();
@@ -13,5 +14,10 @@ int join_matchmaking(Player* player);
 void leave_room(Player* player);
 Room* get_player_room(Player* player);
 void iterate_active_rooms(void (*callback)(Room*));
+void matchmaking_export(SerialWriter* w);
+int matchmaking_import(SerialReader* r);
+void matchmaking_checkpoint_capture();
+void matchmaking_checkpoint_write(SerialWriter* w);
+int matchmaking_restore(SerialReader* r);
 
 #endif // MATCHMAKING_H
@@ -2,13 +2,22 @@
 #include "../utils/logger.h"
 #include "../utils/timer.h"
 #include "matchmaking.h"
+#include "game_logic.h"
+#include "../tcp/tcp_server.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#ifdef __linux__
+#include <sys/random.h>
+#endif
 
-#define MAX_DISCONNECTED_PLAYERS 100
+#define RECONNECT_INITIAL_BUCKETS 64   // Must be a power of two
+#define SESSION_TOKEN_BYTES 16         // 128 bits of entropy, hex-encoded
 
-typedef struct {
+typedef struct DisconnectedPlayerState {
     char session_token[64];
     uint32_t player_id;
     uint32_t room_id;
@@ -17,47 +26,247 @@ typedef struct {
     bool is_drawing;
     bool has_guessed;
     uint64_t disconnect_time;
-    bool valid;
+    uint64_t expires_at;
+    int heap_index;                        // Position in expiry_heap
+    struct DisconnectedPlayerState* next;  // Hash bucket chain
 } DisconnectedPlayerState;
 
-static DisconnectedPlayerState disconnected_players[MAX_DISCONNECTED_PLAYERS];
+// Hash table keyed by session token (chained, doubles when load > 3/4)
+static DisconnectedPlayerState** buckets = NULL;
+static size_t bucket_count = 0;
+static size_t entry_count = 0;
+
+// Min-heap of entries ordered by expires_at
+static DisconnectedPlayerState** expiry_heap = NULL;
+static size_t heap_size = 0;
+static size_t heap_capacity = 0;
+
 static pthread_mutex_t reconnect_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-void init_reconnection() {
-    memset(disconnected_players, 0, sizeof(disconnected_players));
+// FNV-1a
+static uint64_t hash_token(const char* token) {
+    uint64_t h = 1469598103934665603ULL;
+    for (const unsigned char* p = (const unsigned char*)token; *p; p++) {
+        h ^= *p;
+        h *= 1099511628211ULL;
+    }
+    return h;
 }
 
-void generate_session_token(char* token, uint32_t player_id) {
-    uint64_t timestamp = get_current_time_ms();
-    snprintf(token, 64, "%u-%lu-%d", player_id, timestamp, rand() % 10000);
+static void heap_swap(size_t a, size_t b) {
+    DisconnectedPlayerState* tmp = expiry_heap[a];
+    expiry_heap[a] = expiry_heap[b];
+    expiry_heap[b] = tmp;
+    expiry_heap[a]->heap_index = (int)a;
+    expiry_heap[b]->heap_index = (int)b;
 }
 
-void save_player_state(Player* player, Room* room) {
+static void heap_sift_up(size_t i) {
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (expiry_heap[parent]->expires_at <= expiry_heap[i]->expires_at) break;
+        heap_swap(i, parent);
+        i = parent;
+    }
+}
+
+static void heap_sift_down(size_t i) {
+    for (;;) {
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        size_t smallest = i;
+
+        if (left < heap_size && expiry_heap[left]->expires_at < expiry_heap[smallest]->expires_at) {
+            smallest = left;
+        }
+        if (right < heap_size && expiry_heap[right]->expires_at < expiry_heap[smallest]->expires_at) {
+            smallest = right;
+        }
+        if (smallest == i) break;
+
+        heap_swap(i, smallest);
+        i = smallest;
+    }
+}
+
+static int heap_push(DisconnectedPlayerState* state) {
+    if (heap_size == heap_capacity) {
+        size_t new_capacity = heap_capacity ? heap_capacity * 2 : RECONNECT_INITIAL_BUCKETS;
+        DisconnectedPlayerState** grown = realloc(expiry_heap, new_capacity * sizeof(*grown));
+        if (!grown) return -1;
+        expiry_heap = grown;
+        heap_capacity = new_capacity;
+    }
+
+    state->heap_index = (int)heap_size;
+    expiry_heap[heap_size++] = state;
+    heap_sift_up(heap_size - 1);
+    return 0;
+}
+
+static void heap_remove(DisconnectedPlayerState* state) {
+    size_t i = (size_t)state->heap_index;
+    heap_size--;
+
+    if (i != heap_size) {
+        expiry_heap[i] = expiry_heap[heap_size];
+        expiry_heap[i]->heap_index = (int)i;
+        heap_sift_down(i);
+        heap_sift_up(i);
+    }
+    state->heap_index = -1;
+}
+
+static int table_grow() {
+    size_t new_count = bucket_count * 2;
+    DisconnectedPlayerState** new_buckets = calloc(new_count, sizeof(*new_buckets));
+    if (!new_buckets) return -1;
+
+    for (size_t i = 0; i < bucket_count; i++) {
+        DisconnectedPlayerState* entry = buckets[i];
+        while (entry) {
+            DisconnectedPlayerState* next = entry->next;
+            size_t idx = hash_token(entry->session_token) & (new_count - 1);
+            entry->next = new_buckets[idx];
+            new_buckets[idx] = entry;
+            entry = next;
+        }
+    }
+
+    free(buckets);
+    buckets = new_buckets;
+    bucket_count = new_count;
+    return 0;
+}
+
+static DisconnectedPlayerState* table_find(const char* session_token) {
+    if (!buckets) return NULL;
+
+    size_t idx = hash_token(session_token) & (bucket_count - 1);
+    for (DisconnectedPlayerState* entry = buckets[idx]; entry; entry = entry->next) {
+        if (strcmp(entry->session_token, session_token) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void table_insert(DisconnectedPlayerState* state) {
+    size_t idx = hash_token(state->session_token) & (bucket_count - 1);
+    state->next = buckets[idx];
+    buckets[idx] = state;
+    entry_count++;
+}
+
+// Unlink from both the table and the heap, then free
+static void remove_state(DisconnectedPlayerState* state) {
+    size_t idx = hash_token(state->session_token) & (bucket_count - 1);
+    DisconnectedPlayerState** link = &buckets[idx];
+    while (*link && *link != state) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = state->next;
+        entry_count--;
+    }
+
+    if (state->heap_index >= 0) {
+        heap_remove(state);
+    }
+    free(state);
+}
+
+void init_reconnection() {
     pthread_mutex_lock(&reconnect_mutex);
-    
-    // Find empty slot
-    int slot = -1;
-    for (int i = 0; i < MAX_DISCONNECTED_PLAYERS; i++) {
-        if (!disconnected_players[i].valid) {
-            slot = i;
+
+    free(buckets);
+    free(expiry_heap);
+
+    bucket_count = RECONNECT_INITIAL_BUCKETS;
+    buckets = calloc(bucket_count, sizeof(*buckets));
+    entry_count = 0;
+
+    expiry_heap = NULL;
+    heap_size = 0;
+    heap_capacity = 0;
+
+    pthread_mutex_unlock(&reconnect_mutex);
+}
+
+// Fill buf with bytes from the kernel CSPRNG
+static int secure_random_bytes(unsigned char* buf, size_t len) {
+#ifdef __linux__
+    size_t filled = 0;
+    while (filled < len) {
+        ssize_t n = getrandom(buf + filled, len - filled, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
             break;
         }
+        filled += (size_t)n;
     }
-    
-    if (slot == -1) {
-        // No space, overwrite oldest
-        slot = 0;
-        uint64_t oldest_time = disconnected_players[0].disconnect_time;
-        for (int i = 1; i < MAX_DISCONNECTED_PLAYERS; i++) {
-            if (disconnected_players[i].disconnect_time < oldest_time) {
-                oldest_time = disconnected_players[i].disconnect_time;
-                slot = i;
-            }
+    if (filled == len) return 0;
+#endif
+
+    int fd = open("/dev/urandom", O_RDONLY);
+    if (fd < 0) return -1;
+
+    size_t total = 0;
+    while (total < len) {
+        ssize_t n = read(fd, buf + total, len - total);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            close(fd);
+            return -1;
         }
+        total += (size_t)n;
+    }
+    close(fd);
+    return 0;
+}
+
+void generate_session_token(char* token, uint32_t player_id) {
+    unsigned char random[SESSION_TOKEN_BYTES];
+
+    if (secure_random_bytes(random, sizeof(random)) < 0) {
+        // Never hand out a guessable token; fail closed with an unusable one
+        fprintf(stderr, "[RECONNECT] Failed to read random bytes for player %u\n", player_id);
+        token[0] = '\0';
+        return;
+    }
+
+    static const char hex[] = "0123456789abcdef";
+    for (int i = 0; i < SESSION_TOKEN_BYTES; i++) {
+        token[i * 2] = hex[random[i] >> 4];
+        token[i * 2 + 1] = hex[random[i] & 0x0F];
+    }
+    token[SESSION_TOKEN_BYTES * 2] = '\0';
+}
+
+void save_player_state(Player* player, Room* room) {
+    if (player->session_token[0] == '\0') return;
+
+    pthread_mutex_lock(&reconnect_mutex);
+
+    // A repeat disconnect replaces the previous entry for the same token
+    DisconnectedPlayerState* existing = table_find(player->session_token);
+    if (existing) {
+        remove_state(existing);
+    }
+
+    if ((entry_count + 1) * 4 > bucket_count * 3 && table_grow() < 0) {
+        fprintf(stderr, "[RECONNECT] Failed to grow reconnection table\n");
     }
-    
-    DisconnectedPlayerState* state = &disconnected_players[slot];
-    strncpy(state->session_token, player->session_token, 63);
+
+    DisconnectedPlayerState* state = calloc(1, sizeof(DisconnectedPlayerState));
+    if (!state) {
+        pthread_mutex_unlock(&reconnect_mutex);
+        fprintf(stderr, "[RECONNECT] Out of memory saving player %u\n", player->player_id);
+        return;
+    }
+
+    memcpy(state->session_token, player->session_token, sizeof(state->session_token));
+    state->session_token[sizeof(state->session_token) - 1] = '\0';
     state->player_id = player->player_id;
     state->room_id = room->room_id;
     state->state = player->state;
@@ -65,96 +274,154 @@ void save_player_state(Player* player, Room* room) {
     state->is_drawing = player->is_drawing;
     state->has_guessed = player->has_guessed;
     state->disconnect_time = get_current_time_ms();
-    state->valid = true;
-    
+    state->expires_at = state->disconnect_time + (uint64_t)RECONNECT_TIMEOUT * 1000;
+
+    if (heap_push(state) < 0) {
+        pthread_mutex_unlock(&reconnect_mutex);
+        free(state);
+        fprintf(stderr, "[RECONNECT] Out of memory saving player %u\n", player->player_id);
+        return;
+    }
+    table_insert(state);
+
     log_disconnect(player->player_id, "connection_lost");
-    
+
     pthread_mutex_unlock(&reconnect_mutex);
 }
 
 int restore_player_state(Player* player, const char* session_token, Room** out_room) {
     pthread_mutex_lock(&reconnect_mutex);
-    
-    // Find player state
-    DisconnectedPlayerState* state = NULL;
-    for (int i = 0; i < MAX_DISCONNECTED_PLAYERS; i++) {
-        if (disconnected_players[i].valid && 
-            strcmp(disconnected_players[i].session_token, session_token) == 0) {
-            state = &disconnected_players[i];
-            break;
-        }
-    }
-    
+
+    DisconnectedPlayerState* state = table_find(session_token);
+
     if (!state) {
         pthread_mutex_unlock(&reconnect_mutex);
         log_reconnect(0, session_token, false);
         return -1;  // Token not found
     }
-    
+
+    uint32_t player_id = state->player_id;
+
     // Check if timeout
-    uint64_t elapsed = (get_current_time_ms() - state->disconnect_time) / 1000;
-    if (elapsed > RECONNECT_TIMEOUT) {
-        state->valid = false;
+    if (get_current_time_ms() > state->expires_at) {
+        remove_state(state);
         pthread_mutex_unlock(&reconnect_mutex);
-        log_reconnect(state->player_id, session_token, false);
+        log_reconnect(player_id, session_token, false);
         return -2;  // Timeout
     }
-    
+
     // Find room
     Room* room = find_room_by_id(state->room_id);
     if (!room) {
-        state->valid = false;
+        remove_state(state);
         pthread_mutex_unlock(&reconnect_mutex);
-        log_reconnect(state->player_id, session_token, false);
+        log_reconnect(player_id, session_token, false);
         return -3;  // Room no longer exists
     }
-    
-    // Restore player state
-    player->player_id = state->player_id;
-    player->score = state->score;
-    player->state = state->state;
-    player->is_drawing = state->is_drawing;
-    player->has_guessed = state->has_guessed;
-    strncpy(player->session_token, state->session_token, 63);
-    
+
     // Add player back to room
     int added = 0;
     for (int i = 0; i < MAX_PLAYERS; i++) {
         if (room->players[i] == NULL) {
             room->players[i] = player;
             room->player_count++;
+            if (state->is_drawing) {
+                room->current_drawer_idx = i;  // Slots may have been compacted meanwhile
+            }
             added = 1;
             break;
         }
     }
-    
+
     if (!added) {
+        // Keep the entry so the player can retry once a slot frees up
         pthread_mutex_unlock(&reconnect_mutex);
-        log_reconnect(state->player_id, session_token, false);
+        log_reconnect(player_id, session_token, false);
         return -4;  // Room full
     }
-    
+
+    // Restore player state
+    tcp_server_set_session(player, state->player_id, state->session_token);
+    player->score = state->score;
+    player->state = state->state;
+    player->is_drawing = state->is_drawing;
+    player->has_guessed = state->has_guessed;
+    room_state_changed(room);
+
     *out_room = room;
-    state->valid = false;  // Mark as used
-    
+    remove_state(state);  // Tokens are single-use
+
     log_reconnect(player->player_id, session_token, true);
     pthread_mutex_unlock(&reconnect_mutex);
-    
+
     return 0;
 }
 
 void cleanup_expired_states() {
     pthread_mutex_lock(&reconnect_mutex);
-    
+
+    // Only touch entries that have actually expired: O(k log n) for k expiries
     uint64_t now = get_current_time_ms();
-    for (int i = 0; i < MAX_DISCONNECTED_PLAYERS; i++) {
-        if (disconnected_players[i].valid) {
-            uint64_t elapsed = (now - disconnected_players[i].disconnect_time) / 1000;
-            if (elapsed > RECONNECT_TIMEOUT) {
-                disconnected_players[i].valid = false;
-            }
+    while (heap_size > 0 && expiry_heap[0]->expires_at < now) {
+        remove_state(expiry_heap[0]);
+    }
+
+    pthread_mutex_unlock(&reconnect_mutex);
+}
+
+// Saved sessions, so players who dropped before a hot restart can still come back
+void reconnection_export(SerialWriter* w) {
+    pthread_mutex_lock(&reconnect_mutex);
+
+    serial_put_u32(w, (uint32_t)heap_size);
+    for (size_t i = 0; i < heap_size; i++) {
+        const DisconnectedPlayerState* state = expiry_heap[i];
+        serial_put_str(w, state->session_token);
+        serial_put_u32(w, state->player_id);
+        serial_put_u32(w, state->room_id);
+        serial_put_u32(w, state->state);
+        serial_put_i32(w, state->score);
+        serial_put_u8(w, state->is_drawing);
+        serial_put_u8(w, state->has_guessed);
+        serial_put_u64(w, state->disconnect_time);
+        serial_put_u64(w, state->expires_at);
+    }
+
+    pthread_mutex_unlock(&reconnect_mutex);
+}
+
+int reconnection_import(SerialReader* r) {
+    uint32_t count = serial_get_u32(r);
+    if (r->failed) return -1;
+
+    pthread_mutex_lock(&reconnect_mutex);
+
+    for (uint32_t i = 0; i < count && !r->failed; i++) {
+        DisconnectedPlayerState* state = calloc(1, sizeof(DisconnectedPlayerState));
+        if (!state) {
+            r->failed = true;
+            break;
         }
+
+        serial_get_str(r, state->session_token, sizeof(state->session_token));
+        state->player_id = serial_get_u32(r);
+        state->room_id = serial_get_u32(r);
+        state->state = (PlayerState)serial_get_u32(r);
+        state->score = serial_get_i32(r);
+        state->is_drawing = serial_get_u8(r);
+        state->has_guessed = serial_get_u8(r);
+        state->disconnect_time = serial_get_u64(r);
+        state->expires_at = serial_get_u64(r);
+
+        if (r->failed || table_find(state->session_token) ||
+            ((entry_count + 1) * 4 > bucket_count * 3 && table_grow() < 0) ||
+            heap_push(state) < 0) {
+            free(state);
+            continue;
+        }
+        table_insert(state);
     }
-    
+
     pthread_mutex_unlock(&reconnect_mutex);
+    return r->failed ? -1 : 0;
 }
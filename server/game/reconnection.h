@@ -2,6 +2,7 @@
 #define RECONNECTION_H
 
 #include "../protocol.h"
+#include "../utils/serial.h"
 #include <pthread.h>
 
 void init_reconnection();
@@ -9,5 +10,7 @@ void generate_session_token(char* token, uint32_t player_id);
 void save_player_state(Player* player, Room* room);
 int restore_player_state(Player* player, const char* session_token, Room** out_room);
 void cleanup_expired_states();
+void reconnection_export(SerialWriter* w);
+int reconnection_import(SerialReader* r);
 
 #endif // RECONNECTION_H
@@ -0,0 +1,535 @@
+#include "stats.h"
+#include "../utils/crc32.h"
+#include "../utils/timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define STATS_QUEUE_SIZE 1024        // Deltas waiting for the writer; full = drop
+#define STATS_INDEX_MAGIC 0x58444953  // "SIDX"
+#define STATS_INDEX_VERSION 1
+#define STATS_INITIAL_SLOTS 256
+#define STATS_CHECKPOINT_MS 5000     // How often the index is msync'd
+
+enum {
+    STATS_GUESS = 1,
+    STATS_GAME = 2
+};
+
+// One appended log record; the log is the source of truth
+typedef struct {
+    uint32_t crc;       // Over the rest of the record
+    uint16_t kind;
+    uint16_t won;
+    int32_t score;      // Points for a guess, final score for a game
+    uint32_t guess_ms;  // Round start to correct guess
+    char username[MAX_USERNAME];
+} StatsRecord;
+
+// Index slot: a player's totals as of next_offset in the log
+typedef struct {
+    char username[MAX_USERNAME];
+    int64_t total_score;
+    uint32_t games;
+    uint32_t wins;
+    uint32_t guesses;
+    uint32_t reserved;
+    uint64_t guess_ms_total;
+    uint64_t next_offset;  // Log offset just past the last record applied here
+    uint32_t crc;          // Over everything above
+    uint32_t padding;
+} StatsEntry;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t capacity;
+    uint64_t checkpoint_offset;  // Every entry reflects the log at least up to here
+    uint64_t reserved;
+} StatsIndexHeader;
+
+// Writer side
+static int log_fd = -1;
+static uint64_t log_size = 0;
+static int index_fd = -1;
+static StatsIndexHeader* index_map = NULL;
+static size_t index_map_size = 0;
+static StatsEntry* entries = NULL;
+
+// Username -> slot, plus each slot's position in top[] (-1 when outside it)
+static int* hash_heads = NULL;
+static int* hash_next = NULL;
+static int* top_rank = NULL;
+static uint32_t hash_size = 0;
+static int top[STATS_TOP_N];
+static int top_count = 0;
+
+// Guards entries/top against leaderboard readers while the writer applies deltas
+static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Game threads -> writer
+static StatsRecord queue[STATS_QUEUE_SIZE];
+static int queue_head = 0;
+static int queue_count = 0;
+static bool stats_running = false;
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t stats_tid;
+
+static uint32_t record_crc(const StatsRecord* rec) {
+    return crc32_compute((const uint8_t*)rec + sizeof(rec->crc), sizeof(*rec) - sizeof(rec->crc));
+}
+
+static uint32_t entry_crc(const StatsEntry* entry) {
+    return crc32_compute(entry, offsetof(StatsEntry, crc));
+}
+
+static uint32_t hash_name(const char* name) {
+    uint32_t h = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*)name; *p; p++) {
+        h ^= *p;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void hash_insert(int slot) {
+    uint32_t bucket = hash_name(entries[slot].username) & (hash_size - 1);
+    hash_next[slot] = hash_heads[bucket];
+    hash_heads[bucket] = slot;
+}
+
+static int hash_find(const char* name) {
+    uint32_t bucket = hash_name(name) & (hash_size - 1);
+    for (int slot = hash_heads[bucket]; slot >= 0; slot = hash_next[slot]) {
+        if (strncmp(entries[slot].username, name, MAX_USERNAME) == 0) {
+            return slot;
+        }
+    }
+    return -1;
+}
+
+// Size the in-memory side tables for capacity slots and rehash
+static int rebuild_tables(uint32_t capacity) {
+    uint32_t size = 16;
+    while (size < capacity * 2) size *= 2;
+
+    int* heads = malloc(size * sizeof(int));
+    int* next = realloc(hash_next, capacity * sizeof(int));
+    if (next) hash_next = next;
+    int* ranks = realloc(top_rank, capacity * sizeof(int));
+    if (ranks) top_rank = ranks;
+    if (!heads || !next || !ranks) {
+        free(heads);
+        return -1;
+    }
+
+    free(hash_heads);
+    hash_heads = heads;
+    hash_size = size;
+    memset(hash_heads, 0xFF, size * sizeof(int));
+
+    for (uint32_t i = 0; i < index_map->count; i++) {
+        hash_insert((int)i);
+    }
+    for (uint32_t i = index_map->count; i < capacity; i++) {
+        top_rank[i] = -1;
+    }
+    return 0;
+}
+
+static int map_index(size_t size) {
+    if (index_map) {
+        munmap(index_map, index_map_size);
+        index_map = NULL;
+    }
+
+    void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, index_fd, 0);
+    if (map == MAP_FAILED) {
+        perror("[STATS] mmap index");
+        return -1;
+    }
+    index_map = map;
+    index_map_size = size;
+    entries = (StatsEntry*)(index_map + 1);
+    return 0;
+}
+
+static size_t index_bytes(uint32_t capacity) {
+    return sizeof(StatsIndexHeader) + (size_t)capacity * sizeof(StatsEntry);
+}
+
+static int reset_index() {
+    if (ftruncate(index_fd, 0) < 0 || ftruncate(index_fd, index_bytes(STATS_INITIAL_SLOTS)) < 0) {
+        perror("[STATS] ftruncate index");
+        return -1;
+    }
+    if (map_index(index_bytes(STATS_INITIAL_SLOTS)) < 0) return -1;
+
+    index_map->magic = STATS_INDEX_MAGIC;
+    index_map->version = STATS_INDEX_VERSION;
+    index_map->count = 0;
+    index_map->capacity = STATS_INITIAL_SLOTS;
+    index_map->checkpoint_offset = 0;
+    return 0;
+}
+
+static int grow_index() {
+    uint32_t capacity = index_map->capacity * 2;
+    if (ftruncate(index_fd, index_bytes(capacity)) < 0) {
+        perror("[STATS] grow index");
+        return -1;
+    }
+    if (map_index(index_bytes(capacity)) < 0) return -1;
+
+    index_map->capacity = capacity;
+    return rebuild_tables(capacity);
+}
+
+static int find_or_add(const char* name) {
+    int slot = hash_find(name);
+    if (slot >= 0) return slot;
+
+    if (index_map->count == index_map->capacity && grow_index() < 0) {
+        return -1;
+    }
+
+    slot = (int)index_map->count;
+    StatsEntry* entry = &entries[slot];
+    memset(entry, 0, sizeof(*entry));
+    snprintf(entry->username, MAX_USERNAME, "%s", name);
+    entry->crc = entry_crc(entry);
+    index_map->count++;
+
+    top_rank[slot] = -1;
+    hash_insert(slot);
+    return slot;
+}
+
+static void top_swap(int a, int b) {
+    int tmp = top[a];
+    top[a] = top[b];
+    top[b] = tmp;
+    top_rank[top[a]] = a;
+    top_rank[top[b]] = b;
+}
+
+// Totals only grow, so a changed entry can only enter the ranking or move up
+static void top_update(int slot) {
+    int64_t score = entries[slot].total_score;
+    int pos = top_rank[slot];
+
+    if (pos < 0) {
+        if (top_count < STATS_TOP_N) {
+            pos = top_count++;
+        } else if (score > entries[top[top_count - 1]].total_score) {
+            pos = top_count - 1;
+            top_rank[top[pos]] = -1;
+        } else {
+            return;
+        }
+        top[pos] = slot;
+        top_rank[slot] = pos;
+    }
+
+    while (pos > 0 && entries[top[pos - 1]].total_score < score) {
+        top_swap(pos, pos - 1);
+        pos--;
+    }
+}
+
+static void apply_record(const StatsRecord* rec, uint64_t offset) {
+    int slot = find_or_add(rec->username);
+    if (slot < 0) return;
+
+    StatsEntry* entry = &entries[slot];
+    if (offset < entry->next_offset) return;  // Already folded in before a crash
+
+    if (rec->kind == STATS_GUESS) {
+        entry->guesses++;
+        entry->guess_ms_total += rec->guess_ms;
+    } else if (rec->kind == STATS_GAME) {
+        entry->games++;
+        entry->wins += rec->won ? 1 : 0;
+        entry->total_score += rec->score;
+    }
+    entry->next_offset = offset + sizeof(StatsRecord);
+    entry->crc = entry_crc(entry);
+
+    top_update(slot);
+}
+
+// Make the index durable and record how much of the log it covers
+static void checkpoint() {
+    if (!index_map) return;
+
+    msync(index_map, index_map_size, MS_SYNC);
+    index_map->checkpoint_offset = log_size;
+    msync(index_map, sizeof(StatsIndexHeader), MS_SYNC);
+}
+
+// Scan the log, drop a torn tail, and fold everything past the checkpoint
+static int recover_log() {
+    if (lseek(log_fd, 0, SEEK_SET) < 0) return -1;
+
+    StatsRecord rec;
+    uint64_t offset = 0;
+    for (;;) {
+        ssize_t n = read(log_fd, &rec, sizeof(rec));
+        if (n < 0 && errno == EINTR) continue;
+        if (n != (ssize_t)sizeof(rec) || rec.crc != record_crc(&rec)) break;
+
+        rec.username[MAX_USERNAME - 1] = '\0';
+        if (offset >= index_map->checkpoint_offset) {
+            apply_record(&rec, offset);
+        }
+        offset += sizeof(rec);
+    }
+
+    struct stat st;
+    if (fstat(log_fd, &st) == 0 && (uint64_t)st.st_size != offset) {
+        fprintf(stderr, "[STATS] Truncating %llu bytes of torn log tail\n",
+                (unsigned long long)(st.st_size - offset));
+        if (ftruncate(log_fd, offset) < 0) return -1;
+    }
+    log_size = offset;
+    return 0;
+}
+
+static bool index_valid() {
+    if (index_map->magic != STATS_INDEX_MAGIC || index_map->version != STATS_INDEX_VERSION ||
+        index_map->count > index_map->capacity ||
+        index_bytes(index_map->capacity) != index_map_size) {
+        return false;
+    }
+    for (uint32_t i = 0; i < index_map->count; i++) {
+        if (entries[i].crc != entry_crc(&entries[i])) return false;
+    }
+    return true;
+}
+
+static int open_index(const char* index_path) {
+    index_fd = open(index_path, O_RDWR | O_CREAT, 0644);
+    if (index_fd < 0) {
+        perror("[STATS] open index");
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(index_fd, &st) < 0) return -1;
+
+    if ((size_t)st.st_size >= index_bytes(0) && map_index(st.st_size) == 0 && index_valid()) {
+        return 0;
+    }
+
+    // Missing or damaged: rebuild everything from the log
+    if (st.st_size > 0) {
+        fprintf(stderr, "[STATS] Index damaged, rebuilding from log\n");
+    }
+    return reset_index();
+}
+
+static int write_all(int fd, const void* data, size_t len) {
+    const char* p = data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Group commit: one write and one fdatasync for the whole batch
+static void persist_batch(StatsRecord* batch, int count) {
+    for (int i = 0; i < count; i++) {
+        batch[i].crc = record_crc(&batch[i]);
+    }
+
+    if (write_all(log_fd, batch, count * sizeof(StatsRecord)) < 0 || fdatasync(log_fd) < 0) {
+        perror("[STATS] Failed to persist stats");
+        // Whatever landed is torn or unsynced; cut back so the next batch starts clean
+        if (ftruncate(log_fd, log_size) < 0) {
+            perror("[STATS] ftruncate log");
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&stats_mutex);
+    for (int i = 0; i < count; i++) {
+        apply_record(&batch[i], log_size);
+        log_size += sizeof(StatsRecord);
+    }
+    pthread_mutex_unlock(&stats_mutex);
+}
+
+static void* stats_thread(void* arg) {
+    (void)arg;
+    static StatsRecord batch[STATS_QUEUE_SIZE];
+    uint64_t last_checkpoint = get_current_time_ms();
+    bool dirty = false;
+
+    pthread_mutex_lock(&queue_mutex);
+    while (stats_running || queue_count > 0) {
+        if (queue_count == 0) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += 1;
+            pthread_cond_timedwait(&queue_cond, &queue_mutex, &deadline);
+        }
+
+        int count = 0;
+        while (queue_count > 0) {
+            batch[count++] = queue[queue_head];
+            queue_head = (queue_head + 1) % STATS_QUEUE_SIZE;
+            queue_count--;
+        }
+        pthread_mutex_unlock(&queue_mutex);
+
+        if (count > 0) {
+            persist_batch(batch, count);
+            dirty = true;
+        }
+
+        uint64_t now = get_current_time_ms();
+        if (dirty && now - last_checkpoint >= STATS_CHECKPOINT_MS) {
+            checkpoint();
+            last_checkpoint = now;
+            dirty = false;
+        }
+
+        pthread_mutex_lock(&queue_mutex);
+    }
+    pthread_mutex_unlock(&queue_mutex);
+
+    checkpoint();
+    return NULL;
+}
+
+int stats_init(const char* log_path, const char* index_path) {
+    log_fd = open(log_path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (log_fd < 0) {
+        perror("[STATS] open log");
+        return -1;
+    }
+
+    if (open_index(index_path) < 0 || rebuild_tables(index_map->capacity) < 0) {
+        return -1;
+    }
+
+    // Rank everything already in the index once; from here on it's incremental
+    for (uint32_t i = 0; i < index_map->count; i++) {
+        top_rank[i] = -1;
+    }
+    for (uint32_t i = 0; i < index_map->count; i++) {
+        top_update((int)i);
+    }
+
+    if (recover_log() < 0) {
+        perror("[STATS] recover log");
+        return -1;
+    }
+    checkpoint();
+
+    stats_running = true;
+    if (pthread_create(&stats_tid, NULL, stats_thread, NULL) != 0) {
+        stats_running = false;
+        return -1;
+    }
+
+    printf("[STATS] Loaded %u players, %llu log bytes\n",
+           index_map->count, (unsigned long long)log_size);
+    return 0;
+}
+
+void stats_shutdown() {
+    pthread_mutex_lock(&queue_mutex);
+    bool was_running = stats_running;
+    stats_running = false;
+    pthread_cond_signal(&queue_cond);
+    pthread_mutex_unlock(&queue_mutex);
+
+    if (was_running) {
+        pthread_join(stats_tid, NULL);  // Drains the queue and checkpoints
+    }
+
+    if (index_map) munmap(index_map, index_map_size);
+    if (index_fd >= 0) close(index_fd);
+    if (log_fd >= 0) close(log_fd);
+    index_map = NULL;
+    index_fd = -1;
+    log_fd = -1;
+
+    free(hash_heads);
+    free(hash_next);
+    free(top_rank);
+    hash_heads = hash_next = top_rank = NULL;
+}
+
+// Never blocks on disk: a full queue drops the delta
+static void enqueue(const StatsRecord* rec) {
+    pthread_mutex_lock(&queue_mutex);
+    if (!stats_running || queue_count == STATS_QUEUE_SIZE) {
+        pthread_mutex_unlock(&queue_mutex);
+        if (stats_running) {
+            fprintf(stderr, "[STATS] Queue full, dropping stats for %s\n", rec->username);
+        }
+        return;
+    }
+
+    queue[(queue_head + queue_count) % STATS_QUEUE_SIZE] = *rec;
+    queue_count++;
+    pthread_cond_signal(&queue_cond);
+    pthread_mutex_unlock(&queue_mutex);
+}
+
+void stats_record_guess(const char* username, int points, uint32_t guess_ms) {
+    StatsRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.kind = STATS_GUESS;
+    rec.score = points;
+    rec.guess_ms = guess_ms;
+    strncpy(rec.username, username, MAX_USERNAME - 1);
+    enqueue(&rec);
+}
+
+void stats_record_game(const char* username, int score, bool won) {
+    StatsRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.kind = STATS_GAME;
+    rec.score = score;
+    rec.won = won ? 1 : 0;
+    strncpy(rec.username, username, MAX_USERNAME - 1);
+    enqueue(&rec);
+}
+
+int stats_leaderboard_json(char* out, int out_size, int limit) {
+    pthread_mutex_lock(&stats_mutex);
+
+    int len = snprintf(out, out_size, "{\"entries\":[");
+    for (int i = 0; i < top_count && i < limit && len < out_size; i++) {
+        const StatsEntry* entry = &entries[top[i]];
+        uint64_t avg_guess_ms = entry->guesses ? entry->guess_ms_total / entry->guesses : 0;
+        len += snprintf(out + len, out_size - len,
+                        "%s{\"rank\":%d,\"username\":\"%s\",\"score\":%lld,\"games\":%u,\"wins\":%u,\"avg_guess_ms\":%llu}",
+                        i > 0 ? "," : "", i + 1, entry->username, (long long)entry->total_score,
+                        entry->games, entry->wins, (unsigned long long)avg_guess_ms);
+    }
+    if (len < out_size) {
+        len += snprintf(out + len, out_size - len, "]}");
+    }
+
+    pthread_mutex_unlock(&stats_mutex);
+    return len < out_size ? len : -1;
+}
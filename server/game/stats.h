@@ -0,0 +1,22 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "../protocol.h"
+
+// Persistent per-player totals, keyed by username, and the all-time leaderboard.
+// Game threads only queue deltas; a background thread appends them to an
+// fsync'd log, folds them into an mmap'd index and keeps the top-N ranking
+// up to date, so serving the leaderboard never scans every player.
+
+#define STATS_LOG_PATH "server/stats.log"
+#define STATS_INDEX_PATH "server/stats.idx"
+#define STATS_TOP_N 100      // Ranking depth kept in memory
+#define LEADERBOARD_SIZE 10  // Entries sent to clients
+
+int stats_init(const char* log_path, const char* index_path);
+void stats_shutdown();
+void stats_record_guess(const char* username, int points, uint32_t guess_ms);
+void stats_record_game(const char* username, int score, bool won);
+int stats_leaderboard_json(char* out, int out_size, int limit);
+
+#endif // STATS_H
@@ -0,0 +1,153 @@
+#include "stroke_codec.h"
+#include <string.h>
+#include <math.h>
+
+static uint16_t quantize(float v) {
+    float q = roundf(v * STROKE_CODEC_SCALE);
+    if (q < 0) return 0;
+    if (q > 65535) return 65535;
+    return (uint16_t)q;
+}
+
+static int put_varint(uint8_t* out, int pos, int out_size, uint64_t value) {
+    do {
+        if (pos >= out_size) return -1;
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        out[pos++] = byte | (value ? 0x80 : 0);
+    } while (value);
+    return pos;
+}
+
+static int get_varint(const uint8_t* in, int pos, int len, uint64_t* value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos >= len) return -1;
+        uint8_t byte = in[pos++];
+        result |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return pos;
+        }
+    }
+    return -1;
+}
+
+static int put_delta(uint8_t* out, int pos, int out_size, int32_t delta) {
+    uint32_t zigzag = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+    return put_varint(out, pos, out_size, zigzag);
+}
+
+static int get_delta(const uint8_t* in, int pos, int len, int32_t* delta) {
+    uint64_t zigzag;
+    pos = get_varint(in, pos, len, &zigzag);
+    if (pos < 0 || zigzag > 0xFFFFFFFFu) return -1;
+    *delta = (int32_t)((uint32_t)zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+    return pos;
+}
+
+// Does b continue the polyline ending in a?
+static bool continues_run(const Stroke* a, const Stroke* b) {
+    return a->color == b->color && a->thickness == b->thickness &&
+           a->group_id == b->group_id &&
+           quantize(a->x2) == quantize(b->x1) && quantize(a->y2) == quantize(b->y1);
+}
+
+int stroke_codec_encode(const Stroke* strokes, int count, uint64_t base_time,
+                        uint8_t* out, int out_size) {
+    if (out_size < 1) return -1;
+
+    int pos = 0;
+    out[pos++] = STROKE_CODEC_VERSION;
+
+    uint64_t prev_time = base_time;
+    int32_t prev_x = 0, prev_y = 0;
+
+    int i = 0;
+    while (i < count) {
+        int run_end = i + 1;
+        while (run_end < count && continues_run(&strokes[run_end - 1], &strokes[run_end])) {
+            run_end++;
+        }
+
+        const Stroke* first = &strokes[i];
+        uint64_t dt = first->timestamp > prev_time ? first->timestamp - prev_time : 0;
+        prev_time = first->timestamp > prev_time ? first->timestamp : prev_time;
+
+        if (pos + 2 > out_size) return -1;
+        out[pos++] = (uint8_t)(first->color < 255 ? first->color : 255);
+        out[pos++] = first->thickness;
+        pos = put_varint(out, pos, out_size, first->group_id);
+        if (pos >= 0) pos = put_varint(out, pos, out_size, dt);
+        if (pos >= 0) pos = put_varint(out, pos, out_size, (uint64_t)(run_end - i + 1));
+        if (pos < 0) return -1;
+
+        // Run start, then the end of every segment in the run
+        for (int p = i - 1; p < run_end; p++) {
+            int32_t x = p < i ? quantize(first->x1) : quantize(strokes[p].x2);
+            int32_t y = p < i ? quantize(first->y1) : quantize(strokes[p].y2);
+            pos = put_delta(out, pos, out_size, x - prev_x);
+            if (pos >= 0) pos = put_delta(out, pos, out_size, y - prev_y);
+            if (pos < 0) return -1;
+            prev_x = x;
+            prev_y = y;
+        }
+
+        i = run_end;
+    }
+
+    return pos;
+}
+
+int stroke_codec_decode(const uint8_t* in, int len, uint64_t base_time,
+                        Stroke* out, int max_strokes) {
+    if (len < 1 || in[0] != STROKE_CODEC_VERSION) return -1;
+
+    int pos = 1;
+    int count = 0;
+    uint64_t time = base_time;
+    int32_t x = 0, y = 0;
+
+    while (pos < len) {
+        if (pos + 2 > len) return -1;
+        uint8_t color = in[pos++];
+        uint8_t thickness = in[pos++];
+
+        uint64_t group, dt, points;
+        pos = get_varint(in, pos, len, &group);
+        if (pos >= 0) pos = get_varint(in, pos, len, &dt);
+        if (pos >= 0) pos = get_varint(in, pos, len, &points);
+        if (pos < 0 || points < 2 || group > 0xFFFFFFFFu) return -1;
+        if (points - 1 > (uint64_t)(max_strokes - count)) return -1;
+
+        time += dt;
+
+        for (uint64_t p = 0; p < points; p++) {
+            int32_t dx, dy;
+            pos = get_delta(in, pos, len, &dx);
+            if (pos >= 0) pos = get_delta(in, pos, len, &dy);
+            if (pos < 0) return -1;
+
+            int32_t nx = x + dx;
+            int32_t ny = y + dy;
+            if (nx < 0 || nx > 65535 || ny < 0 || ny > 65535) return -1;
+
+            if (p > 0) {
+                Stroke* s = &out[count++];
+                memset(s, 0, sizeof(*s));
+                s->x1 = (float)x / STROKE_CODEC_SCALE;
+                s->y1 = (float)y / STROKE_CODEC_SCALE;
+                s->x2 = (float)nx / STROKE_CODEC_SCALE;
+                s->y2 = (float)ny / STROKE_CODEC_SCALE;
+                s->color = color;
+                s->thickness = thickness;
+                s->group_id = (uint32_t)group;
+                s->timestamp = time;
+            }
+            x = nx;
+            y = ny;
+        }
+    }
+
+    return count;
+}
@@ -0,0 +1,27 @@
+#ifndef STROKE_CODEC_H
+#define STROKE_CODEC_H
+
+#include "../protocol.h"
+
+// Compact stroke encoding used by UDP_STROKE_PACKED (base64 inside the JSON
+// envelope, since both the proxy and the browser link carry text frames).
+//
+//   blob := version:u8 run*
+//   run  := palette:u8 thickness:u8 group:varint dt:varint count:varint point*count
+//   point:= dx:zigzag-varint dy:zigzag-varint
+//
+// Coordinates are quantized to 16 bits (1/STROKE_CODEC_SCALE px) and every
+// point is a delta from the previous one, starting at (0, 0). A run is a
+// polyline of count >= 2 points sharing color, thickness and group. dt is ms
+// since the previous run, the first run being relative to base_time (round start).
+
+#define STROKE_CODEC_VERSION 1
+#define STROKE_CODEC_SCALE 16
+#define STROKE_CODEC_MAX_SEGMENT_BYTES 40  // Worst case: a segment in its own run
+
+int stroke_codec_encode(const Stroke* strokes, int count, uint64_t base_time,
+                        uint8_t* out, int out_size);
+int stroke_codec_decode(const uint8_t* in, int len, uint64_t base_time,
+                        Stroke* out, int max_strokes);
+
+#endif // STROKE_CODEC_H
@@ -0,0 +1,112 @@
+#include "stroke_simplify.h"
+#include <string.h>
+#include <math.h>
+
+#define JOIN_EPSILON 0.01f  // Endpoints closer than this count as connected
+
+void stroke_path_reset(StrokePath* path) {
+    path->count = 0;
+}
+
+bool stroke_path_extends(const StrokePath* path, const Stroke* stroke) {
+    if (path->count == 0) return false;
+    
+    return path->color == stroke->color &&
+           path->thickness == stroke->thickness &&
+           path->group_id == stroke->group_id &&
+           fabsf(path->xs[path->count - 1] - stroke->x1) < JOIN_EPSILON &&
+           fabsf(path->ys[path->count - 1] - stroke->y1) < JOIN_EPSILON;
+}
+
+// Returns false once the path is full and should be flushed
+bool stroke_path_append(StrokePath* path, const Stroke* stroke, uint64_t now) {
+    if (!stroke_path_extends(path, stroke)) {
+        path->count = 0;
+        path->color = stroke->color;
+        path->thickness = stroke->thickness;
+        path->group_id = stroke->group_id;
+        path->started_at = now;
+        path->xs[path->count] = stroke->x1;
+        path->ys[path->count] = stroke->y1;
+        path->count++;
+    }
+    
+    path->xs[path->count] = stroke->x2;
+    path->ys[path->count] = stroke->y2;
+    path->count++;
+    
+    return path->count < STROKE_PATH_MAX_POINTS;
+}
+
+static float point_segment_distance(float px, float py, float ax, float ay, float bx, float by) {
+    float dx = bx - ax;
+    float dy = by - ay;
+    float len_sq = dx * dx + dy * dy;
+    
+    float t = len_sq > 0 ? ((px - ax) * dx + (py - ay) * dy) / len_sq : 0;
+    if (t < 0) t = 0;
+    if (t > 1) t = 1;
+    
+    float ex = px - (ax + t * dx);
+    float ey = py - (ay + t * dy);
+    return sqrtf(ex * ex + ey * ey);
+}
+
+// Iterative Douglas-Peucker; writes one Stroke per kept segment
+int stroke_path_simplify(const StrokePath* path, float tolerance, Stroke* out, int max_out) {
+    if (path->count < 2) return 0;
+    
+    bool keep[STROKE_PATH_MAX_POINTS];
+    memset(keep, 0, sizeof(keep));
+    keep[0] = true;
+    keep[path->count - 1] = true;
+    
+    int stack[STROKE_PATH_MAX_POINTS * 2];
+    int top = 0;
+    stack[top++] = 0;
+    stack[top++] = path->count - 1;
+    
+    while (top > 0) {
+        int last = stack[--top];
+        int first = stack[--top];
+        
+        float max_dist = 0;
+        int index = -1;
+        for (int i = first + 1; i < last; i++) {
+            float d = point_segment_distance(path->xs[i], path->ys[i],
+                                             path->xs[first], path->ys[first],
+                                             path->xs[last], path->ys[last]);
+            if (d > max_dist) {
+                max_dist = d;
+                index = i;
+            }
+        }
+        
+        if (index >= 0 && max_dist > tolerance) {
+            keep[index] = true;
+            stack[top++] = first;
+            stack[top++] = index;
+            stack[top++] = index;
+            stack[top++] = last;
+        }
+    }
+    
+    int written = 0;
+    int prev = 0;
+    for (int i = 1; i < path->count && written < max_out; i++) {
+        if (!keep[i]) continue;
+        
+        Stroke* s = &out[written++];
+        memset(s, 0, sizeof(Stroke));
+        s->x1 = path->xs[prev];
+        s->y1 = path->ys[prev];
+        s->x2 = path->xs[i];
+        s->y2 = path->ys[i];
+        s->color = path->color;
+        s->thickness = path->thickness;
+        s->group_id = path->group_id;
+        prev = i;
+    }
+    
+    return written;
+}
@@ -0,0 +1,16 @@
+#ifndef STROKE_SIMPLIFY_H
+#define STROKE_SIMPLIFY_H
+
+#include "../protocol.h"
+
+// Consecutive segments from the drawer collected into one polyline, then
+// reduced with Douglas-Peucker before storage and broadcast.
+
+#define STROKE_SIMPLIFY_TOLERANCE 0.75f  // Max deviation in canvas pixels
+
+void stroke_path_reset(StrokePath* path);
+bool stroke_path_extends(const StrokePath* path, const Stroke* stroke);
+bool stroke_path_append(StrokePath* path, const Stroke* stroke, uint64_t now);
+int stroke_path_simplify(const StrokePath* path, float tolerance, Stroke* out, int max_out);
+
+#endif // STROKE_SIMPLIFY_H
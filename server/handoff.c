@@ -0,0 +1,356 @@
+#include "handoff.h"
+#include "protocol.h"
+#include "http/http_server.h"
+#include "tcp/tcp_server.h"
+#include "tcp/tcp_handler.h"
+#include "udp/udp_server.h"
+#include "game/matchmaking.h"
+#include "game/reconnection.h"
+#include "game/stats.h"
+#include "game/checkpoint.h"
+#include "utils/serial.h"
+#include "utils/timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define HANDOFF_MAX_FDS 128  // Listeners + every client; the kernel caps one message at 253
+#define HANDOFF_ACK 'A'
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+} HandoffHello;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    int32_t status;        // 0, or -1 when the old process refuses
+    uint32_t fd_count;     // Sockets attached to this header
+    uint32_t udp_fd_count; // UDP workers; their sockets follow tcp and http
+    uint64_t payload_len;  // Snapshot bytes that follow the header
+} HandoffHeader;
+
+static int send_all(int fd, const void* data, size_t len) {
+    const char* p = data;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int recv_all(int fd, void* data, size_t len) {
+    char* p = data;
+    while (len > 0) {
+        ssize_t n = recv(fd, p, len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static void set_timeouts(int fd) {
+    struct timeval tv = {
+        .tv_sec = HANDOFF_TIMEOUT_MS / 1000,
+        .tv_usec = (HANDOFF_TIMEOUT_MS % 1000) * 1000
+    };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+static int unix_address(const char* path, struct sockaddr_un* addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) return -1;
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+int handoff_listen(const char* path) {
+    struct sockaddr_un addr;
+    if (unix_address(path, &addr) < 0) return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("[HANDOFF] socket");
+        return -1;
+    }
+
+    // A previous generation's path is ours now
+    unlink(path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 1) < 0) {
+        perror("[HANDOFF] bind");
+        close(fd);
+        return -1;
+    }
+
+    printf("[HANDOFF] Listening for takeover on %s\n", path);
+    return fd;
+}
+
+// Wait up to timeout_ms for a new process; -1 on timeout, signal or error
+int handoff_accept(int listen_fd, int timeout_ms) {
+    if (listen_fd < 0) {
+        sleep_ms(timeout_ms);
+        return -1;
+    }
+
+    struct pollfd pfd = { .fd = listen_fd, .events = POLLIN };
+    if (poll(&pfd, 1, timeout_ms) <= 0) return -1;
+
+    int conn = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+    if (conn < 0) return -1;
+
+    set_timeouts(conn);
+    return conn;
+}
+
+static void send_refusal(int conn) {
+    HandoffHeader header = { HANDOFF_MAGIC, HANDOFF_VERSION, -1, 0, 0, 0 };
+    send_all(conn, &header, sizeof(header));
+}
+
+// Header and sockets go in one sendmsg; the snapshot follows as plain bytes
+static int send_state(int conn, const int* fds, int nfds, int udp_count, const SerialWriter* w) {
+    HandoffHeader header = { HANDOFF_MAGIC, HANDOFF_VERSION, 0, (uint32_t)nfds,
+                             (uint32_t)udp_count, w->len };
+
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * HANDOFF_MAX_FDS)];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct iovec iov = { .iov_base = &header, .iov_len = sizeof(header) };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * nfds);
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * nfds);
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * nfds);
+
+    ssize_t sent;
+    do {
+        sent = sendmsg(conn, &msg, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+
+    if (sent < 0) return -1;
+    if ((size_t)sent < sizeof(header) &&
+        send_all(conn, (char*)&header + sent, sizeof(header) - sent) < 0) {
+        return -1;
+    }
+    return send_all(conn, w->data, w->len);
+}
+
+// Called with the timer thread stopped. On success every socket now belongs
+// to the new process and the caller should exit; on failure this process
+// has resumed serving.
+int handoff_send(int conn) {
+    HandoffHello hello;
+    if (recv_all(conn, &hello, sizeof(hello)) < 0) {
+        close(conn);
+        return -1;
+    }
+    if (hello.magic != HANDOFF_MAGIC || hello.version != HANDOFF_VERSION) {
+        fprintf(stderr, "[HANDOFF] Refusing takeover: snapshot version %u, ours is %u\n",
+                hello.version, HANDOFF_VERSION);
+        send_refusal(conn);
+        close(conn);
+        return -1;
+    }
+
+    // Browsers reconnect on their own; closing their keep-alives between
+    // requests beats the old process cutting them off mid-request later
+    if (http_server_close_connections() < 0) {
+        fprintf(stderr, "[HANDOFF] Some HTTP connections are still busy, handing off anyway\n");
+    }
+
+    // Clients wait from here until the new process adopts the sockets
+    uint64_t paused_at = get_monotonic_time_ms();
+
+    int fds[HANDOFF_MAX_FDS];
+    fds[0] = tcp_server_detach();
+    fds[1] = http_server_detach();
+    int udp_count = udp_server_detach(fds + 2, UDP_MAX_WORKERS);
+    int nfds = 2 + udp_count;
+
+    SerialWriter w;
+    serial_writer_init(&w);
+    int result = tcp_server_export(&w, fds, &nfds, HANDOFF_MAX_FDS);
+    tcp_handler_export(&w);
+    matchmaking_export(&w);
+    reconnection_export(&w);
+
+    // The new process opens the stats log and checkpoint file only after
+    // we have let go of them
+    stats_shutdown();
+    checkpoint_shutdown(false);
+
+    char ack = 0;
+    if (result < 0 || w.failed) {
+        fprintf(stderr, "[HANDOFF] Failed to snapshot state\n");
+        send_refusal(conn);
+    } else if (send_state(conn, fds, nfds, udp_count, &w) < 0 || recv_all(conn, &ack, 1) < 0 ||
+               ack != HANDOFF_ACK) {
+        fprintf(stderr, "[HANDOFF] New process did not take over\n");
+    }
+
+    uint64_t paused_ms = get_monotonic_time_ms() - paused_at;
+    size_t snapshot_len = w.len;
+    serial_writer_free(&w);
+    close(conn);
+
+    if (ack == HANDOFF_ACK) {
+        printf("[HANDOFF] Handed off %d sockets and %zu bytes of state in %llu ms\n",
+               nfds, snapshot_len, (unsigned long long)paused_ms);
+        return 0;
+    }
+
+    // Nothing was taken over: pick up where we left off
+    if (stats_init(STATS_LOG_PATH, STATS_INDEX_PATH) < 0) {
+        fprintf(stderr, "[WARN] Failed to restart stats, leaderboard disabled\n");
+    }
+    checkpoint_init(CHECKPOINT_PATH);
+    tcp_server_adopt(fds[0]);
+    http_server_adopt(fds[1]);
+    udp_server_adopt(fds + 2, udp_count);
+    printf("[HANDOFF] Resumed serving\n");
+    return -1;
+}
+
+static int receive_header(int fd, HandoffHeader* header, int* fds, int* nfds) {
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * HANDOFF_MAX_FDS)];
+        struct cmsghdr align;
+    } control;
+
+    struct iovec iov = { .iov_base = header, .iov_len = sizeof(*header) };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    ssize_t n;
+    do {
+        n = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) return -1;
+
+    *nfds = 0;
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            *nfds = (int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * *nfds);
+        }
+    }
+
+    if ((size_t)n < sizeof(*header) &&
+        recv_all(fd, (char*)header + n, sizeof(*header) - n) < 0) {
+        return -1;
+    }
+    if (msg.msg_flags & MSG_CTRUNC) return -1;
+    return 0;
+}
+
+static int import_state(const uint8_t* data, size_t len, const int* fds, int nfds) {
+    SerialReader r;
+    serial_reader_init(&r, data, len);
+
+    if (tcp_server_import(&r, fds, nfds) < 0) return -1;
+    if (tcp_handler_import(&r) < 0) return -1;
+    if (matchmaking_import(&r) < 0) return -1;
+    if (reconnection_import(&r) < 0) return -1;
+    return r.pos == r.len ? 0 : -1;
+}
+
+int handoff_receive(const char* path, HandoffListeners* out) {
+    struct sockaddr_un addr;
+    if (unix_address(path, &addr) < 0) return -1;
+
+    int conn = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (conn < 0) {
+        perror("[HANDOFF] socket");
+        return -1;
+    }
+    if (connect(conn, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("[HANDOFF] connect to running server");
+        close(conn);
+        return -1;
+    }
+    set_timeouts(conn);
+
+    HandoffHello hello = { HANDOFF_MAGIC, HANDOFF_VERSION };
+    HandoffHeader header;
+    int fds[HANDOFF_MAX_FDS];
+    int nfds = 0;
+    uint8_t* payload = NULL;
+
+    if (send_all(conn, &hello, sizeof(hello)) < 0 ||
+        receive_header(conn, &header, fds, &nfds) < 0) {
+        fprintf(stderr, "[HANDOFF] No response from running server\n");
+        goto fail;
+    }
+    if (header.magic != HANDOFF_MAGIC || header.version != HANDOFF_VERSION || header.status != 0) {
+        fprintf(stderr, "[HANDOFF] Running server refused the takeover\n");
+        goto fail;
+    }
+    if (header.fd_count != (uint32_t)nfds || header.udp_fd_count < 1 ||
+        header.udp_fd_count > UDP_MAX_WORKERS || (uint32_t)nfds < 2 + header.udp_fd_count) {
+        fprintf(stderr, "[HANDOFF] Expected %u sockets, got %d\n", header.fd_count, nfds);
+        goto fail;
+    }
+
+    payload = malloc(header.payload_len ? header.payload_len : 1);
+    if (!payload || recv_all(conn, payload, header.payload_len) < 0) {
+        fprintf(stderr, "[HANDOFF] Failed to read state snapshot\n");
+        goto fail;
+    }
+    if (import_state(payload, header.payload_len, fds, nfds) < 0) {
+        fprintf(stderr, "[HANDOFF] Corrupt state snapshot\n");
+        goto fail;
+    }
+
+    // From here the old process exits; without this byte it resumes instead
+    char ack = HANDOFF_ACK;
+    if (send_all(conn, &ack, 1) < 0) goto fail;
+
+    free(payload);
+    close(conn);
+
+    out->tcp_fd = fds[0];
+    out->http_fd = fds[1];
+    out->udp_count = (int)header.udp_fd_count;
+    memcpy(out->udp_fds, fds + 2, sizeof(int) * out->udp_count);
+    printf("[HANDOFF] Took over %d sockets and %llu bytes of state\n",
+           nfds, (unsigned long long)header.payload_len);
+    return 0;
+
+fail:
+    free(payload);
+    for (int i = 0; i < nfds; i++) {
+        close(fds[i]);
+    }
+    close(conn);
+    return -1;
+}
@@ -0,0 +1,33 @@
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+// Hot restart. A new server started with --takeover connects to the running
+// one over a Unix socket; the old process stops its network threads, passes
+// its listener and player sockets across (SCM_RIGHTS) along with a snapshot
+// of players, rooms and saved sessions, and exits once the new process has
+// acknowledged. Clients keep their connections throughout. If the new
+// process goes away before acknowledging, the old one resumes serving.
+
+#include "udp/udp_server.h"
+
+#define HANDOFF_SOCKET_PATH "server/handoff.sock"
+#define HANDOFF_MAGIC 0x48524353    // "SCRH"
+#define HANDOFF_VERSION 10          // Bump whenever the snapshot format changes
+#define HANDOFF_TIMEOUT_MS 5000     // Either side gives up on a silent peer
+
+typedef struct {
+    int tcp_fd;
+    int http_fd;
+    int udp_fds[UDP_MAX_WORKERS];  // In SO_REUSEPORT group order
+    int udp_count;
+} HandoffListeners;
+
+// Old process
+int handoff_listen(const char* path);
+int handoff_accept(int listen_fd, int timeout_ms);
+int handoff_send(int conn);
+
+// New process: fills the module state and returns the sockets to adopt
+int handoff_receive(const char* path, HandoffListeners* out);
+
+#endif // HANDOFF_H
@@ -0,0 +1,121 @@
+#include "http_parser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+static const char* find_line_end(const char* p, const char* end) {
+    for (; p + 1 < end; p++) {
+        if (p[0] == '\r' && p[1] == '\n') return p;
+    }
+    return NULL;
+}
+
+// Copy the value of header name (case-insensitive, surrounding spaces
+// trimmed); false if absent or too long
+bool http_header_value(const HttpRequest* req, const char* name, char* out, size_t out_size) {
+    size_t name_len = strlen(name);
+    const char* p = req->headers;
+    const char* end = req->headers + req->headers_len;
+    
+    while (p < end) {
+        const char* eol = find_line_end(p, end + 2);
+        if (!eol) eol = end;
+        
+        if ((size_t)(eol - p) > name_len && p[name_len] == ':' &&
+            strncasecmp(p, name, name_len) == 0) {
+            const char* v = p + name_len + 1;
+            while (v < eol && (*v == ' ' || *v == '\t')) v++;
+            const char* v_end = eol;
+            while (v_end > v && (v_end[-1] == ' ' || v_end[-1] == '\t')) v_end--;
+            
+            size_t len = (size_t)(v_end - v);
+            if (len >= out_size) return false;
+            memcpy(out, v, len);
+            out[len] = '\0';
+            return true;
+        }
+        p = eol + 2;
+    }
+    return false;
+}
+
+// Does a comma-separated header (Connection, Accept-Encoding, ...) list token?
+bool http_header_has_token(const HttpRequest* req, const char* name, const char* token) {
+    char value[512];
+    if (!http_header_value(req, name, value, sizeof(value))) return false;
+    
+    size_t token_len = strlen(token);
+    char* p = value;
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == ',') p++;
+        char* item_end = p;
+        while (*item_end && *item_end != ',' && *item_end != ';' &&
+               *item_end != ' ' && *item_end != '\t') {
+            item_end++;
+        }
+        if ((size_t)(item_end - p) == token_len && strncasecmp(p, token, token_len) == 0) {
+            return true;
+        }
+        p = item_end;
+        while (*p && *p != ',') p++;
+    }
+    return false;
+}
+
+// Returns the bytes the first request occupies (headers plus any body),
+// 0 while it is incomplete, -1 if it is malformed or can never fit
+int http_parse_request(const char* buf, size_t len, HttpRequest* req) {
+    const char* end = NULL;
+    for (size_t i = 0; i + 3 < len; i++) {
+        if (memcmp(buf + i, "\r\n\r\n", 4) == 0) {
+            end = buf + i;
+            break;
+        }
+    }
+    if (!end) return len >= HTTP_MAX_REQUEST ? -1 : 0;
+    
+    // Request line: METHOD SP path SP HTTP/1.x
+    const char* line_end = find_line_end(buf, end + 2);
+    char version[16];
+    char line[sizeof(req->method) + sizeof(req->path) + sizeof(version) + 3];
+    size_t line_len = (size_t)(line_end - buf);
+    if (line_len >= sizeof(line)) return -1;
+    memcpy(line, buf, line_len);
+    line[line_len] = '\0';
+    
+    if (sscanf(line, "%15s %511s %15s", req->method, req->path, version) != 3 ||
+        strncmp(version, "HTTP/1.", 7) != 0 || !isdigit((unsigned char)version[7])) {
+        return -1;
+    }
+    req->version_minor = version[7] - '0';
+    
+    // No header lines at all leaves the request line ending at the blank line
+    req->headers = line_end + 2;
+    req->headers_len = line_end < end ? (size_t)(end - req->headers) : 0;
+    
+    // HTTP/1.1 keeps the connection unless told otherwise, 1.0 the reverse
+    if (req->version_minor >= 1) {
+        req->keep_alive = !http_header_has_token(req, "Connection", "close");
+    } else {
+        req->keep_alive = http_header_has_token(req, "Connection", "keep-alive");
+    }
+    
+    // Bodies aren't used, but must be skipped to find the next request
+    char value[32];
+    if (http_header_value(req, "Transfer-Encoding", value, sizeof(value))) return -1;
+    
+    size_t body = 0;
+    if (http_header_value(req, "Content-Length", value, sizeof(value))) {
+        char* num_end;
+        unsigned long n = strtoul(value, &num_end, 10);
+        if (num_end == value || *num_end != '\0') return -1;
+        body = n;
+    }
+    
+    size_t total = (size_t)(end - buf) + 4 + body;
+    if (total > HTTP_MAX_REQUEST) return -1;
+    if (total > len) return 0;
+    return (int)total;
+}
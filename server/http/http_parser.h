@@ -0,0 +1,26 @@
+#ifndef HTTP_PARSER_H
+#define HTTP_PARSER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Incremental HTTP/1.x request parsing over a connection's input buffer.
+// Requests may arrive in pieces or several at once (pipelining); each call
+// looks at the first one only.
+
+#define HTTP_MAX_REQUEST 8192  // Request line, headers and body together
+
+typedef struct {
+    char method[16];
+    char path[512];
+    int version_minor;     // The x in HTTP/1.x
+    bool keep_alive;       // After HTTP/1.x defaults and any Connection header
+    const char* headers;   // Header lines, valid until the request is consumed
+    size_t headers_len;
+} HttpRequest;
+
+int http_parse_request(const char* buf, size_t len, HttpRequest* req);
+bool http_header_value(const HttpRequest* req, const char* name, char* out, size_t out_size);
+bool http_header_has_token(const HttpRequest* req, const char* name, const char* token);
+
+#endif // HTTP_PARSER_H
@@ -1,128 +1,544 @@
 #include "http_server.h"
+#include "http_parser.h"
 #include "router.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
 #include <netinet/in.h>
 #include <pthread.h>
 #include <errno.h>
+#include <fcntl.h>
+#include "../utils/timer.h"
+
+#define HTTP_MAX_CONNECTIONS 256
+#define HTTP_MAX_PIPELINE 8                    // Queued responses before reading pauses
+#define HTTP_KEEPALIVE_TIMEOUT_MS 5000         // Idle persistent connection
+#define HTTP_REQUEST_TIMEOUT_MS 10000          // From a request's first byte to its last
+#define HTTP_WRITE_TIMEOUT_MS 10000            // Response output making no progress
+#define HTTP_DRAIN_TIMEOUT_MS 2000             // How long stop waits for in-flight responses
+#define HTTP_HANDOFF_DRAIN_MS 1000             // How long a handoff waits for keep-alives to close
+#define HTTP_SWEEP_INTERVAL_MS 1000
+
+#define HTTP_TOKEN_LISTEN UINT32_MAX
+#define HTTP_TOKEN_WAKE (UINT32_MAX - 1)
+
+// One client connection. Requests are parsed out of in[] as they complete
+// and their responses queued in out[], in order, so pipelined requests are
+// answered in sequence. Bodies are written straight from the static cache.
+typedef struct {
+    int fd;                       // -1 when the slot is free
+    char in[HTTP_MAX_REQUEST];
+    size_t in_len;
+    HttpResponse out[HTTP_MAX_PIPELINE];  // Ring of responses not yet fully sent
+    int out_head;
+    int out_count;
+    size_t out_sent;              // Bytes of the head response already sent
+    uint32_t events;              // Interest currently registered with epoll
+    bool peer_closed;             // Peer finished sending
+    bool close_after_write;       // Nothing more will be answered
+    uint32_t requests;            // Answered so far
+    uint64_t last_active;         // Last read or write progress
+    uint64_t request_started;     // First byte of the pending request, 0 if none
+} HttpConn;
 
 static int http_server_fd = -1;
 static pthread_t http_thread;
 static volatile bool http_running = false;
+static volatile bool http_closing = false;   // Handoff coming: answer with Connection: close
+static volatile bool http_drained = false;   // Set by the loop once closing has closed everything
+static int wake_pipe[2] = {-1, -1};  // Interrupts epoll_wait() on detach
+static int epoll_fd = -1;
 
-typedef struct {
-    int client_fd;
-} HttpClientData;
-
-void* handle_http_client(void* arg) {
-    HttpClientData* data = (HttpClientData*)arg;
-    int client_fd = data->client_fd;
-    free(data);
-    
-    char request[8192];
-    int bytes_read = recv(client_fd, request, sizeof(request) - 1, 0);
-    
-    if (bytes_read > 0) {
-        request[bytes_read] = '\0';
-        
-        char* response = NULL;
-        int response_len = 0;
-        
-        int status = route_request(request, &response, &response_len);
-        
-        if (response) {
-            send(client_fd, response, response_len, 0);
-            free(response);
-        }
-        
-        printf("[HTTP] %d - %s\n", status, request);
-    }
-    
-    close(client_fd);
-    return NULL;
+// Only the event loop touches these, and only while it runs; stop drains
+// them after the loop has exited
+static HttpConn conns[HTTP_MAX_CONNECTIONS];
+static int conn_count = 0;
+static bool conns_initialized = false;
+
+static const char* webui_dir = NULL;  // NULL: serve the embedded web UI
+
+// Level-triggered, so only ask for input we can take and output we have
+static void conn_update_events(HttpConn* c, int slot) {
+    uint32_t events = 0;
+    if (!c->peer_closed && !c->close_after_write && c->in_len < sizeof(c->in)) {
+        events |= EPOLLIN;
+    }
+    if (c->out_count > 0) events |= EPOLLOUT;
+    if (events == c->events) return;
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.u32 = (uint32_t)slot;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+    c->events = events;
 }
 
-void* http_server_thread(void* arg) {
-    (void)arg;
-    
-    while (http_running) {
-        struct sockaddr_in client_addr;
-        socklen_t client_len = sizeof(client_addr);
-        
-        int client_fd = accept(http_server_fd, (struct sockaddr*)&client_addr, &client_len);
+static void conn_pop_response(HttpConn* c) {
+    static_asset_release(c->out[c->out_head].asset);
+    c->out_head = (c->out_head + 1) % HTTP_MAX_PIPELINE;
+    c->out_count--;
+    c->out_sent = 0;
+}
+
+static void conn_close(HttpConn* c) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    while (c->out_count > 0) conn_pop_response(c);
+    c->fd = -1;
+    c->in_len = 0;
+    conn_count--;
+}
+
+// Answer every complete request in the input buffer, while there is room
+// to queue the responses
+static void conn_process(HttpConn* c) {
+    while (!c->close_after_write && c->in_len > 0 && c->out_count < HTTP_MAX_PIPELINE) {
+        HttpRequest request;
+        int consumed = http_parse_request(c->in, c->in_len, &request);
+        if (consumed == 0) break;
+
+        HttpResponse* response = &c->out[(c->out_head + c->out_count) % HTTP_MAX_PIPELINE];
+        c->out_count++;
+
+        if (consumed < 0) {
+            static const char bad_request[] =
+                "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+            memset(response, 0, sizeof(*response));
+            memcpy(response->header, bad_request, sizeof(bad_request) - 1);
+            response->header_len = sizeof(bad_request) - 1;
+            printf("[HTTP] 400 - malformed request\n");
+            c->close_after_write = true;
+            c->in_len = 0;
+            break;
+        }
+
+        if (http_closing) request.keep_alive = false;
+        int status = route_request(&request, response);
+        printf("[HTTP] %d - %s %s\n", status, request.method, request.path);
+        c->requests++;
+
+        if (!request.keep_alive) c->close_after_write = true;
+
+        memmove(c->in, c->in + consumed, c->in_len - consumed);
+        c->in_len -= consumed;
+        c->request_started = c->in_len > 0 ? get_monotonic_time_ms() : 0;
+    }
+}
+
+// Send what the socket takes, every queued header and body in one
+// sendmsg(); returns false if the connection was closed
+static bool conn_flush(HttpConn* c, int slot) {
+    while (c->out_count > 0) {
+        struct iovec iov[HTTP_MAX_PIPELINE * 2];
+        int iov_count = 0;
+        size_t skip = c->out_sent;
+        for (int i = 0; i < c->out_count; i++) {
+            HttpResponse* r = &c->out[(c->out_head + i) % HTTP_MAX_PIPELINE];
+            if (skip < r->header_len) {
+                iov[iov_count].iov_base = r->header + skip;
+                iov[iov_count].iov_len = r->header_len - skip;
+                iov_count++;
+                skip = 0;
+            } else {
+                skip -= r->header_len;
+            }
+            if (r->body_len > skip) {
+                iov[iov_count].iov_base = (void*)(r->body + skip);
+                iov[iov_count].iov_len = r->body_len - skip;
+                iov_count++;
+            }
+            skip = 0;
+        }
+
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iov_count;
+        ssize_t n = sendmsg(c->fd, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            conn_close(c);
+            return false;
+        }
+        c->last_active = get_monotonic_time_ms();
+
+        // Retire the responses that went out completely
+        size_t sent = (size_t)n;
+        while (c->out_count > 0) {
+            HttpResponse* r = &c->out[c->out_head];
+            size_t remaining = r->header_len + r->body_len - c->out_sent;
+            if (sent < remaining) {
+                c->out_sent += sent;
+                break;
+            }
+            sent -= remaining;
+            conn_pop_response(c);
+        }
+    }
+
+    if (c->out_count == 0 && c->close_after_write) {
+        conn_close(c);
+        return false;
+    }
+
+    conn_update_events(c, slot);
+    return true;
+}
+
+// Answer buffered requests and write the responses, for as long as writing
+// frees queue slots that requests are waiting for
+static void conn_advance(HttpConn* c, int slot) {
+    for (;;) {
+        conn_process(c);
+        bool full = c->out_count == HTTP_MAX_PIPELINE;
+        if (c->peer_closed && !full) c->close_after_write = true;  // Nothing more to come
+        if (!conn_flush(c, slot)) return;
+        if (!full || c->out_count == HTTP_MAX_PIPELINE) return;
+    }
+}
+
+static void conn_readable(HttpConn* c, int slot) {
+    ssize_t n = recv(c->fd, c->in + c->in_len, sizeof(c->in) - c->in_len, 0);
+    if (n < 0) {
+        if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) return;
+        conn_close(c);
+        return;
+    }
+
+    if (n == 0) {
+        c->peer_closed = true;
+    } else {
+        uint64_t now = get_monotonic_time_ms();
+        if (c->in_len == 0) c->request_started = now;
+        c->in_len += (size_t)n;
+        c->last_active = now;
+    }
+
+    conn_advance(c, slot);
+}
+
+static void conn_writable(HttpConn* c, int slot) {
+    conn_advance(c, slot);
+}
+
+static void accept_connections() {
+    for (;;) {
+        int client_fd = accept(http_server_fd, NULL, NULL);
         if (client_fd < 0) {
-            if (http_running) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
                 perror("HTTP accept failed");
             }
+            return;
+        }
+
+        int slot = -1;
+        for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+            if (conns[i].fd < 0) {
+                slot = i;
+                break;
+            }
+        }
+        if (slot < 0) {
+            printf("[HTTP] Connection limit reached, rejecting\n");
+            close(client_fd);
             continue;
         }
-        
-        // Create thread for each HTTP request
-        HttpClientData* data = malloc(sizeof(HttpClientData));
-        data->client_fd = client_fd;
-        
-        pthread_t thread;
-        if (pthread_create(&thread, NULL, handle_http_client, data) != 0) {
-            perror("Failed to create HTTP client thread");
+
+        fcntl(client_fd, F_SETFL, fcntl(client_fd, F_GETFL) | O_NONBLOCK);
+
+        HttpConn* c = &conns[slot];
+        memset(c, 0, sizeof(*c));
+        c->fd = client_fd;
+        c->events = EPOLLIN;
+        c->last_active = get_monotonic_time_ms();
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.u32 = (uint32_t)slot;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_fd, &ev) < 0) {
+            perror("HTTP epoll_ctl failed");
             close(client_fd);
-            free(data);
-        } else {
-            pthread_detach(thread);
+            c->fd = -1;
+            continue;
+        }
+        conn_count++;
+    }
+}
+
+// Close connections that have gone quiet: idle keep-alives, requests that
+// never finish arriving, and responses the peer stopped reading
+static void sweep_connections(uint64_t now) {
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        HttpConn* c = &conns[i];
+        if (c->fd < 0) continue;
+
+        bool writing = c->out_count > 0;
+        if (writing) {
+            if (now - c->last_active >= HTTP_WRITE_TIMEOUT_MS) conn_close(c);
+        } else if (c->in_len > 0) {
+            if (now - c->request_started >= HTTP_REQUEST_TIMEOUT_MS) conn_close(c);
+        } else if (now - c->last_active >= HTTP_KEEPALIVE_TIMEOUT_MS) {
+            conn_close(c);
+        }
+    }
+}
+
+// While closing: a keep-alive between requests is closed now, rather than
+// left to the handoff and cut off without an answer by the old process.
+// A connection that has yet to send its first request gets to send it.
+static void close_idle_connections() {
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        HttpConn* c = &conns[i];
+        if (c->fd >= 0 && c->requests > 0 && c->in_len == 0 && c->out_count == 0) {
+            conn_close(c);
+        }
+    }
+    http_drained = conn_count == 0;
+}
+
+static void dispatch(const struct epoll_event* ev) {
+    uint32_t token = ev->data.u32;
+    if (token == HTTP_TOKEN_LISTEN) {
+        accept_connections();
+        return;
+    }
+    if (token == HTTP_TOKEN_WAKE) {
+        char drain[16];
+        while (read(wake_pipe[0], drain, sizeof(drain)) > 0) {}
+        return;
+    }
+    if (token >= HTTP_MAX_CONNECTIONS) return;
+
+    HttpConn* c = &conns[token];
+    if (c->fd < 0) return;  // Closed earlier in this batch
+
+    if (ev->events & (EPOLLERR | EPOLLHUP) && !(ev->events & EPOLLIN)) {
+        conn_close(c);
+        return;
+    }
+    if (ev->events & EPOLLOUT) {
+        conn_writable(c, token);
+        if (c->fd < 0) return;
+    }
+    if (ev->events & EPOLLIN) {
+        conn_readable(c, token);
+    }
+}
+
+void* http_server_thread(void* arg) {
+    (void)arg;
+
+    struct epoll_event events[64];
+    uint64_t next_sweep = get_monotonic_time_ms() + HTTP_SWEEP_INTERVAL_MS;
+
+    while (http_running) {
+        int n = epoll_wait(epoll_fd, events, 64, HTTP_SWEEP_INTERVAL_MS);
+        if (n < 0) {
+            if (errno != EINTR) perror("HTTP epoll_wait failed");
+            continue;
+        }
+        if (!http_running) break;
+
+        for (int i = 0; i < n; i++) {
+            dispatch(&events[i]);
+        }
+        if (http_closing) close_idle_connections();
+
+        uint64_t now = get_monotonic_time_ms();
+        if (now >= next_sweep) {
+            sweep_connections(now);
+            next_sweep = now + HTTP_SWEEP_INTERVAL_MS;
         }
     }
-    
+
     return NULL;
 }
 
+// Serve the web UI from dir, reloading files as they change, instead of
+// the copy built into the binary. Call before starting the server.
+void http_server_set_webui_dir(const char* dir) {
+    webui_dir = dir;
+}
+
 int http_server_start(int port) {
-    http_server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (http_server_fd < 0) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
         perror("Failed to create HTTP socket");
         return -1;
     }
-    
+
     int opt = 1;
-    setsockopt(http_server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-    
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
     struct sockaddr_in addr;
     memset(&addr, 0, sizeof(addr));
     addr.sin_family = AF_INET;
     addr.sin_addr.s_addr = INADDR_ANY;
     addr.sin_port = htons(port);
-    
-    if (bind(http_server_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
         perror("Failed to bind HTTP socket");
-        close(http_server_fd);
+        close(fd);
         return -1;
     }
-    
-    if (listen(http_server_fd, 10) < 0) {
+
+    if (listen(fd, 128) < 0) {
         perror("Failed to listen on HTTP socket");
-        close(http_server_fd);
+        close(fd);
+        return -1;
+    }
+
+    if (http_server_adopt(fd) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    printf("[HTTP] Server started on port %d\n", port);
+    return 0;
+}
+
+// Serve an already-listening socket. Connections accepted before a detach
+// are picked up again, so a failed handoff loses nothing.
+int http_server_adopt(int listen_fd) {
+    if (!conns_initialized) {
+        for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) conns[i].fd = -1;
+        conns_initialized = true;
+        static_cache_init(webui_dir);
+    }
+
+    if (epoll_fd < 0) {
+        if (pipe(wake_pipe) < 0) {
+            perror("Failed to create HTTP wake pipe");
+            return -1;
+        }
+        fcntl(wake_pipe[0], F_SETFL, O_NONBLOCK);
+
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd < 0) {
+            perror("Failed to create HTTP epoll instance");
+            return -1;
+        }
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.u32 = HTTP_TOKEN_WAKE;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_pipe[0], &ev);
+    }
+
+    // Never block in accept() if the connection epoll saw is already gone
+    fcntl(listen_fd, F_SETFL, fcntl(listen_fd, F_GETFL) | O_NONBLOCK);
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u32 = HTTP_TOKEN_LISTEN;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) < 0) {
+        perror("Failed to watch HTTP socket");
         return -1;
     }
-    
+
+    http_server_fd = listen_fd;
+    http_closing = false;
     http_running = true;
-    
+
     if (pthread_create(&http_thread, NULL, http_server_thread, NULL) != 0) {
         perror("Failed to create HTTP server thread");
-        close(http_server_fd);
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, listen_fd, NULL);
+        http_running = false;
+        http_server_fd = -1;
         return -1;
     }
-    
-    printf("[HTTP] Server started on port %d\n", port);
     return 0;
 }
 
-void http_server_stop() {
+// Ahead of a handoff: stop accepting, so new connections wait in the
+// listener's backlog for whichever process serves next, and close the
+// open ones as their current request is answered. Returns -1 if some are
+// still open after HTTP_HANDOFF_DRAIN_MS; detach leaves those as before.
+int http_server_close_connections() {
+    if (!http_running) return 0;
+
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, http_server_fd, NULL);
+    http_drained = false;
+    http_closing = true;
+    if (write(wake_pipe[1], "x", 1) < 0) {
+        perror("HTTP wake pipe");
+    }
+
+    uint64_t deadline = get_monotonic_time_ms() + HTTP_HANDOFF_DRAIN_MS;
+    while (!http_drained && get_monotonic_time_ms() < deadline) {
+        usleep(5000);
+    }
+    return http_drained ? 0 : -1;
+}
+
+// Stop serving but keep the listener open; returns it. Open connections
+// wait, and are either resumed by http_server_adopt() or drained by stop.
+int http_server_detach() {
+    if (!http_running) return http_server_fd;
+
     http_running = false;
+    if (write(wake_pipe[1], "x", 1) < 0) {
+        perror("HTTP wake pipe");
+    }
+    pthread_join(http_thread, NULL);
+
+    char drain[16];
+    while (read(wake_pipe[0], drain, sizeof(drain)) > 0) {}
+
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, http_server_fd, NULL);
+    return http_server_fd;
+}
+
+// After the loop has exited: finish responses already queued, answer
+// nothing new, then close every connection
+static void drain_connections(uint64_t deadline) {
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        HttpConn* c = &conns[i];
+        if (c->fd < 0) continue;
+        c->close_after_write = true;
+        c->in_len = 0;
+        if (c->out_count == 0) conn_close(c);
+        else conn_update_events(c, i);
+    }
+
+    struct epoll_event events[64];
+    while (conn_count > 0 && get_monotonic_time_ms() < deadline) {
+        int n = epoll_wait(epoll_fd, events, 64, 10);
+        for (int i = 0; i < n; i++) {
+            uint32_t token = events[i].data.u32;
+            if (token >= HTTP_MAX_CONNECTIONS || conns[token].fd < 0) continue;
+            if (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) {
+                conn_flush(&conns[token], (int)token);
+            }
+        }
+    }
+
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        if (conns[i].fd >= 0) conn_close(&conns[i]);
+    }
+}
+
+void http_server_stop() {
+    http_server_detach();
     if (http_server_fd >= 0) {
         close(http_server_fd);
         http_server_fd = -1;
     }
-    pthread_join(http_thread, NULL);
+
+    // Let in-flight responses finish before the process goes away
+    if (epoll_fd >= 0) {
+        drain_connections(get_monotonic_time_ms() + HTTP_DRAIN_TIMEOUT_MS);
+    }
+    static_cache_shutdown();
     printf("[HTTP] Server stopped\n");
 }
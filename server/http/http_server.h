@@ -3,7 +3,11 @@
 
 #include <stdbool.h>
 
+void http_server_set_webui_dir(const char* dir);
 int http_server_start(int port);
 void http_server_stop();
+int http_server_adopt(int listen_fd);
+int http_server_detach();
+int http_server_close_connections();
 
 #endif // HTTP_SERVER_H
@@ -1,14 +1,9 @@
 #include "router.h"
-#include "mime.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/stat.h>
-#include <unistd.h>
 #include <limits.h>
 
-#define WEBUI_DIR "./webui"
-
 // Sanitize path to prevent directory traversal
 int sanitize_path(const char* request_path, char* safe_path, int safe_path_size) {
     if (!request_path || !safe_path) return -1;
@@ -28,9 +23,9 @@ int sanitize_path(const char* request_path, char* safe_path, int safe_path_size)
     
     // Default to index.html if path is /
     if (strcmp(clean_path, "/") == 0) {
-        snprintf(safe_path, safe_path_size, "%s/index.html", WEBUI_DIR);
+        snprintf(safe_path, safe_path_size, "/index.html");
     } else {
-        snprintf(safe_path, safe_path_size, "%s%s", WEBUI_DIR, clean_path);
+        snprintf(safe_path, safe_path_size, "%s", clean_path);
     }
     
     // Check for directory traversal attempts
@@ -41,84 +36,84 @@ int sanitize_path(const char* request_path, char* safe_path, int safe_path_size)
     return 0;
 }
 
-int route_request(const char* request, char** response, int* response_len) {
-    // Parse HTTP method and path
-    char method[16], path[512], version[16];
-    if (sscanf(request, "%15s %511s %15s", method, path, version) != 3) {
-        *response = strdup("HTTP/1.1 400 Bad Request\r\n\r\n");
-        *response_len = strlen(*response);
-        return 400;
-    }
+// Header-only response; Content-Length keeps a persistent connection in sync
+static int empty_response(int status, const char* reason, bool keep_alive,
+                          HttpResponse* response) {
+    memset(response, 0, sizeof(*response));
+    response->header_len = snprintf(response->header, sizeof(response->header),
+                                    "HTTP/1.1 %d %s\r\n"
+                                    "Content-Length: 0\r\n"
+                                    "Connection: %s\r\n"
+                                    "\r\n",
+                                    status, reason, keep_alive ? "keep-alive" : "close");
+    return status;
+}
+
+// If-None-Match lists etag (or is *); weak comparison, as RFC 9110 asks
+static bool etag_matches(const HttpRequest* request, const StaticAsset* asset) {
+    char value[1024];
+    if (!http_header_value(request, "If-None-Match", value, sizeof(value))) return false;
+    if (strcmp(value, "*") == 0) return true;
+    return strstr(value, asset->etag) != NULL || strstr(value, asset->gzip_etag) != NULL;
+}
+
+int route_request(const HttpRequest* request, HttpResponse* response) {
+    bool keep_alive = request->keep_alive;
     
     // Only support GET
-    if (strcmp(method, "GET") != 0) {
-        *response = strdup("HTTP/1.1 405 Method Not Allowed\r\n\r\n");
-        *response_len = strlen(*response);
-        return 405;
+    if (strcmp(request->method, "GET") != 0) {
+        return empty_response(405, "Method Not Allowed", keep_alive, response);
     }
     
     // Sanitize and get safe path
-    char file_path[PATH_MAX];
-    if (sanitize_path(path, file_path, sizeof(file_path)) < 0) {
-        *response = strdup("HTTP/1.1 403 Forbidden\r\n\r\n");
-        *response_len = strlen(*response);
-        return 403;
+    char path[PATH_MAX];
+    if (sanitize_path(request->path, path, sizeof(path)) < 0) {
+        return empty_response(403, "Forbidden", keep_alive, response);
     }
     
-    // Check if file exists
-    struct stat st;
-    if (stat(file_path, &st) < 0 || !S_ISREG(st.st_mode)) {
-        *response = strdup("HTTP/1.1 404 Not Found\r\n\r\n");
-        *response_len = strlen(*response);
-        return 404;
+    StaticAsset* asset = static_cache_get(path);
+    if (!asset) {
+        return empty_response(404, "Not Found", keep_alive, response);
     }
     
-    // Read file
-    FILE* f = fopen(file_path, "rb");
-    if (!f) {
-        *response = strdup("HTTP/1.1 500 Internal Server Error\r\n\r\n");
-        *response_len = strlen(*response);
-        return 500;
+    bool gzip = asset->gzip && http_header_has_token(request, "Accept-Encoding", "gzip");
+    const char* etag = gzip ? asset->gzip_etag : asset->etag;
+    const char* vary = asset->gzip ? "Vary: Accept-Encoding\r\n" : "";
+    
+    // Fingerprinted URLs change with their contents, so browsers keep them
+    // without asking again; pages are revalidated on every load
+    const char* cache_control = asset->immutable ? "public, max-age=31536000, immutable" : "no-cache";
+    
+    memset(response, 0, sizeof(*response));
+    
+    if (etag_matches(request, asset)) {
+        response->header_len = snprintf(response->header, sizeof(response->header),
+                                        "HTTP/1.1 304 Not Modified\r\n"
+                                        "ETag: %s\r\n"
+                                        "Cache-Control: %s\r\n"
+                                        "%s"
+                                        "Connection: %s\r\n"
+                                        "\r\n",
+                                        etag, cache_control, vary, keep_alive ? "keep-alive" : "close");
+        static_asset_release(asset);
+        return 304;
     }
     
-    fseek(f, 0, SEEK_END);
-    long file_size = ftell(f);
-    fseek(f, 0, SEEK_SET);
-    
-    char* file_content = malloc(file_size);
-    if (!file_content) {
-        fclose(f);
-        *response = strdup("HTTP/1.1 500 Internal Server Error\r\n\r\n");
-        *response_len = strlen(*response);
-        return 500;
-    }
-    
-    fread(file_content, 1, file_size, f);
-    fclose(f);
-    
-    // Get MIME type
-    const char* mime_type = get_mime_type(file_path);
-    
-    // Build response
-    char header[512];
-    int header_len = snprintf(header, sizeof(header),
-                              "HTTP/1.1 200 OK\r\n"
-                              "Content-Type: %s\r\n"
-                              "Content-Length: %ld\r\n"
-                              "Connection: keep-alive\r\n"
-                              "\r\n",
-                              mime_type, file_size);
-    
-    *response_len = header_len + file_size;
-    *response = malloc(*response_len);
-    if (!*response) {
-        free(file_content);
-        return 500;
-    }
-    
-    memcpy(*response, header, header_len);
-    memcpy(*response + header_len, file_content, file_size);
-    
-    free(file_content);
+    response->body = gzip ? asset->gzip : asset->body;
+    response->body_len = gzip ? asset->gzip_len : asset->size;
+    response->asset = asset;
+    response->header_len = snprintf(response->header, sizeof(response->header),
+                                    "HTTP/1.1 200 OK\r\n"
+                                    "Content-Type: %s\r\n"
+                                    "Content-Length: %zu\r\n"
+                                    "%s"
+                                    "ETag: %s\r\n"
+                                    "Cache-Control: %s\r\n"
+                                    "%s"
+                                    "Connection: %s\r\n"
+                                    "\r\n",
+                                    asset->mime_type, response->body_len,
+                                    gzip ? "Content-Encoding: gzip\r\n" : "",
+                                    etag, cache_control, vary, keep_alive ? "keep-alive" : "close");
     return 200;
 }
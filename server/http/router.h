@@ -1,6 +1,21 @@
 #ifndef ROUTER_H
 #define ROUTER_H
 
-int route_request(const char* request, char** response, int* response_len);
+#include "http_parser.h"
+#include "static_cache.h"
+
+#define HTTP_MAX_RESPONSE_HEADER 512
+
+// Headers are formatted into the response; a file body is borrowed from
+// the static cache and stays valid until the asset reference is released
+typedef struct {
+    char header[HTTP_MAX_RESPONSE_HEADER];
+    size_t header_len;
+    const char* body;
+    size_t body_len;
+    StaticAsset* asset;  // NULL when there is no body
+} HttpResponse;
+
+int route_request(const HttpRequest* request, HttpResponse* response);
 
 #endif // ROUTER_H
@@ -0,0 +1,275 @@
+#include "static_cache.h"
+#include "mime.h"
+#include "webui_assets.h"
+#include "../utils/timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+static StaticAsset* assets[STATIC_CACHE_MAX_ASSETS];
+static int asset_count = 0;
+static char webui_dir[256];  // Empty when serving the embedded copy
+
+static uint64_t hash_contents(const char* data, size_t len) {
+    uint64_t hash = 0xcbf29ce484222325ULL;  // FNV-1a
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static bool is_compressible(const char* mime_type) {
+    return strncmp(mime_type, "text/", 5) == 0 ||
+           strcmp(mime_type, "application/javascript") == 0 ||
+           strcmp(mime_type, "application/json") == 0 ||
+           strcmp(mime_type, "image/svg+xml") == 0;
+}
+
+// gzip the body once, at the highest level; kept only if it saves 10%
+static void compress_asset(StaticAsset* asset) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return;
+    }
+
+    size_t bound = deflateBound(&zs, asset->size);
+    char* out = malloc(bound);
+    if (!out) {
+        deflateEnd(&zs);
+        return;
+    }
+
+    zs.next_in = (Bytef*)asset->body;
+    zs.avail_in = asset->size;
+    zs.next_out = (Bytef*)out;
+    zs.avail_out = bound;
+    int rc = deflate(&zs, Z_FINISH);
+    size_t len = zs.total_out;
+    deflateEnd(&zs);
+
+    if (rc != Z_STREAM_END || len >= asset->size - asset->size / 10) {
+        free(out);
+        return;
+    }
+    char* shrunk = realloc(out, len);
+    asset->gzip = shrunk ? shrunk : out;
+    asset->gzip_len = len;
+}
+
+static void free_asset(StaticAsset* asset) {
+    if (!asset->embedded) {
+        free((char*)asset->body);
+        free((char*)asset->gzip);
+    }
+    free(asset);
+}
+
+static StaticAsset* load_asset(const char* path) {
+    char file_path[PATH_MAX];
+    snprintf(file_path, sizeof(file_path), "%s%s", webui_dir, path);
+
+    int fd = open(file_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return NULL;
+    }
+
+    StaticAsset* asset = calloc(1, sizeof(StaticAsset));
+    char* body = malloc(st.st_size > 0 ? st.st_size : 1);
+    if (!asset || !body) {
+        free(asset);
+        free(body);
+        close(fd);
+        return NULL;
+    }
+
+    size_t got = 0;
+    while (got < (size_t)st.st_size) {
+        ssize_t n = read(fd, body + got, st.st_size - got);
+        if (n <= 0) break;
+        got += (size_t)n;
+    }
+    close(fd);
+    if (got != (size_t)st.st_size) {
+        free(asset);
+        free(body);
+        return NULL;
+    }
+
+    snprintf(asset->path, sizeof(asset->path), "%s", path);
+    asset->mime_type = get_mime_type(path);
+    asset->mtime = st.st_mtim;
+    asset->size = got;
+    asset->body = body;
+    asset->checked_at = get_monotonic_time_ms();
+
+    unsigned long long hash = hash_contents(body, got);
+    snprintf(asset->etag, sizeof(asset->etag), "\"%016llx\"", hash);
+    snprintf(asset->gzip_etag, sizeof(asset->gzip_etag), "\"%016llx-gz\"", hash);
+
+    if (is_compressible(asset->mime_type)) compress_asset(asset);
+    return asset;
+}
+
+static void evict(int index) {
+    StaticAsset* asset = assets[index];
+    assets[index] = assets[--asset_count];
+    asset->cached = false;
+    static_asset_release(asset);
+}
+
+static void insert(StaticAsset* asset) {
+    asset->cached = true;
+    asset->refs = 1;
+    assets[asset_count++] = asset;
+}
+
+static void load_embedded() {
+    int files = 0;
+    size_t total = 0;
+    size_t total_gzip = 0;
+    for (int i = 0; i < webui_asset_count && asset_count < STATIC_CACHE_MAX_ASSETS; i++) {
+        const WebuiAsset* source = &webui_assets[i];
+        StaticAsset* asset = calloc(1, sizeof(StaticAsset));
+        if (!asset) break;
+
+        snprintf(asset->path, sizeof(asset->path), "%s", source->path);
+        snprintf(asset->etag, sizeof(asset->etag), "%s", source->etag);
+        snprintf(asset->gzip_etag, sizeof(asset->gzip_etag), "%s", source->gzip_etag);
+        asset->mime_type = get_mime_type(source->path);
+        asset->body = (const char*)source->body;
+        asset->size = source->size;
+        asset->gzip = (const char*)source->gzip;
+        asset->gzip_len = source->gzip_len;
+        asset->embedded = true;
+        asset->immutable = source->immutable;
+        insert(asset);
+
+        if (!source->immutable) {  // Count each file once, not its fingerprinted alias
+            files++;
+            total += source->size;
+            total_gzip += source->gzip ? source->gzip_len : source->size;
+        }
+    }
+
+    printf("[HTTP] Serving %d embedded files (%zu KB, %zu KB gzipped)\n",
+           files, total / 1024, total_gzip / 1024);
+}
+
+static void load_directory() {
+    DIR* d = opendir(webui_dir);
+    if (!d) {
+        perror("Failed to open web UI directory");
+        return;
+    }
+
+    size_t total = 0;
+    size_t total_gzip = 0;
+    struct dirent* entry;
+    while ((entry = readdir(d)) != NULL && asset_count < STATIC_CACHE_MAX_ASSETS) {
+        if (entry->d_name[0] == '.') continue;
+
+        char path[300];
+        snprintf(path, sizeof(path), "/%s", entry->d_name);
+        StaticAsset* asset = static_cache_get(path);
+        if (!asset) continue;  // Not a regular file
+
+        total += asset->size;
+        total_gzip += asset->gzip ? asset->gzip_len : asset->size;
+        static_asset_release(asset);
+    }
+    closedir(d);
+
+    printf("[HTTP] Cached %d files from %s (%zu KB, %zu KB gzipped)\n",
+           asset_count, webui_dir, total / 1024, total_gzip / 1024);
+}
+
+// Serve the embedded web UI, or when dir is given, the files in it
+void static_cache_init(const char* dir) {
+    snprintf(webui_dir, sizeof(webui_dir), "%s", dir ? dir : "");
+    if (dir) {
+        load_directory();
+    } else {
+        load_embedded();
+    }
+}
+
+void static_cache_shutdown() {
+    while (asset_count > 0) {
+        evict(asset_count - 1);
+    }
+}
+
+// The current contents of path with a reference for the caller, or NULL if
+// there is no such file. Files past the cache's capacity are still served,
+// from an uncached copy that goes away with its last response.
+StaticAsset* static_cache_get(const char* path) {
+    int index = -1;
+    for (int i = 0; i < asset_count; i++) {
+        if (strcmp(assets[i]->path, path) == 0) {
+            index = i;
+            break;
+        }
+    }
+
+    if (!webui_dir[0]) {
+        if (index < 0) return NULL;
+        assets[index]->refs++;
+        return assets[index];
+    }
+
+    uint64_t now = get_monotonic_time_ms();
+    if (index >= 0) {
+        StaticAsset* asset = assets[index];
+        if (now - asset->checked_at < STATIC_CACHE_RECHECK_MS) {
+            asset->refs++;
+            return asset;
+        }
+
+        char file_path[PATH_MAX];
+        snprintf(file_path, sizeof(file_path), "%s%s", webui_dir, path);
+
+        struct stat st;
+        if (stat(file_path, &st) < 0 || !S_ISREG(st.st_mode)) {
+            evict(index);
+            return NULL;
+        }
+        if (st.st_mtim.tv_sec == asset->mtime.tv_sec &&
+            st.st_mtim.tv_nsec == asset->mtime.tv_nsec &&
+            (size_t)st.st_size == asset->size) {
+            asset->checked_at = now;
+            asset->refs++;
+            return asset;
+        }
+    }
+
+    StaticAsset* fresh = load_asset(path);
+    if (index >= 0) evict(index);
+    if (!fresh) return NULL;
+    if (index >= 0) printf("[HTTP] Reloaded %s%s\n", webui_dir, path);
+
+    if (asset_count < STATIC_CACHE_MAX_ASSETS) {
+        insert(fresh);
+        fresh->refs++;
+    } else {
+        fresh->refs = 1;
+    }
+    return fresh;
+}
+
+void static_asset_release(StaticAsset* asset) {
+    if (asset && --asset->refs == 0) {
+        free_asset(asset);
+    }
+}
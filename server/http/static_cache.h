@@ -0,0 +1,44 @@
+#ifndef STATIC_CACHE_H
+#define STATIC_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+// In-memory copies of the web UI files, each with a gzip variant (when it
+// is smaller) and a strong ETag over its contents. By default they come
+// from the copy compiled into the binary (webui_assets.h). Given a
+// directory, they are read from there instead and reloaded as the files
+// change. Responses point straight into an asset's buffers and hold a
+// reference, so an asset replaced while a response is still being written
+// stays alive until that write finishes. Only the HTTP thread touches the
+// cache.
+
+#define STATIC_CACHE_MAX_ASSETS 256
+#define STATIC_CACHE_RECHECK_MS 1000  // How often an asset's mtime is looked at again
+
+typedef struct StaticAsset {
+    char path[512];          // URL path, "/index.html"
+    const char* mime_type;
+    char etag[24];           // Quoted hash of the contents
+    char gzip_etag[28];      // Same, tagged for the gzip variant
+    struct timespec mtime;
+    size_t size;
+    const char* body;
+    const char* gzip;        // NULL when compressing doesn't pay
+    size_t gzip_len;
+    bool embedded;           // Buffers are in the binary
+    bool immutable;          // Fingerprinted URL; its contents never change
+    uint64_t checked_at;     // Last mtime check
+    int refs;                // The cache's own, plus one per response in flight
+    bool cached;             // Still the table's current version
+} StaticAsset;
+
+void static_cache_init(const char* dir);
+void static_cache_shutdown();
+
+StaticAsset* static_cache_get(const char* path);
+void static_asset_release(StaticAsset* asset);
+
+#endif // STATIC_CACHE_H
@@ -0,0 +1,27 @@
+#ifndef WEBUI_ASSETS_H
+#define WEBUI_ASSETS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// The web UI compiled into the server. The table is generated at build time
+// by tools/webui_embed from webui/. Every file except the HTML pages is also
+// listed under a fingerprinted name (main.1a2b3c4d.js), and the pages link
+// to those names. A fingerprinted URL's contents never change, so browsers
+// can cache it for good.
+
+typedef struct {
+    const char* path;            // URL path, e.g. "/index.html" or "/main.1a2b3c4d.js"
+    const unsigned char* body;
+    size_t size;
+    const unsigned char* gzip;   // NULL when compressing doesn't pay
+    size_t gzip_len;
+    const char* etag;
+    const char* gzip_etag;
+    bool immutable;              // Fingerprinted name
+} WebuiAsset;
+
+extern const WebuiAsset webui_assets[];
+extern const int webui_asset_count;
+
+#endif // WEBUI_ASSETS_H
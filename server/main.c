@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <signal.h>
 #include <unistd.h>
 #include "protocol.h"
@@ -7,13 +8,18 @@
 #include "tcp/tcp_server.h"
 #include "tcp/tcp_handler.h"
 #include "udp/udp_server.h"
+#include "udp/udp_fec.h"
 #include "game/game_logic.h"
 #include "game/matchmaking.h"
 #include "game/reconnection.h"
+#include "game/stats.h"
+#include "game/checkpoint.h"
+#include "handoff.h"
 #include "utils/logger.h"
 #include "utils/timer.h"
 
 static volatile bool server_running = true;
+static volatile bool timer_running = true;
 
 void signal_handler(int signum) {
     printf("\n[SERVER] Received signal %d, shutting down...\n", signum);
@@ -24,17 +30,21 @@ void timer_update_callback(Room* room) {
     check_game_start_countdown(room);
     update_timer(room);
     
-    // Broadcast timer update to all players
-    char timer_msg[128];
-    snprintf(timer_msg, sizeof(timer_msg), 
-             "{\"time_remaining\":%d}", room->time_remaining);
-    broadcast_to_room(room, MSG_TIMER_UPDATE, timer_msg, NULL);
+    // Clients count down from the deadline they already have; only resync occasionally
+    resync_room_timer(room);
+}
+
+static void init_stats() {
+    // Leaderboard is optional: the game runs without it
+    if (stats_init(STATS_LOG_PATH, STATS_INDEX_PATH) < 0) {
+        fprintf(stderr, "[WARN] Failed to initialize stats, leaderboard disabled\n");
+    }
 }
 
 void* timer_thread(void* arg) {
     (void)arg;
     
-    while (server_running) {
+    while (server_running && timer_running) {
         sleep_ms(1000);  // Update every second
         
         // Update timers for all active rooms
@@ -48,8 +58,32 @@ void* timer_thread(void* arg) {
 }
 
 int main(int argc, char* argv[]) {
-    (void)argc;  // Unused parameter
-    (void)argv;  // Unused parameter
+    bool simplify_strokes = false;
+    bool takeover = false;
+    int udp_workers = 0;
+    bool udp_fec = false;
+    const char* webui_dir = NULL;
+    int websocket_port = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--simplify-strokes") == 0) {
+            simplify_strokes = true;
+        } else if (strcmp(argv[i], "--takeover") == 0) {
+            takeover = true;
+        } else if (strcmp(argv[i], "--udp-workers") == 0 && i + 1 < argc) {
+            udp_workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--udp-fec") == 0) {
+            udp_fec = true;
+        } else if (strcmp(argv[i], "--webui-dir") == 0 && i + 1 < argc) {
+            webui_dir = argv[++i];
+        } else if (strcmp(argv[i], "--websocket") == 0 && i + 1 < argc) {
+            websocket_port = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--simplify-strokes] [--takeover] [--udp-workers N] [--udp-fec] "
+                    "[--webui-dir DIR] [--websocket PORT]\n", argv[0]);
+            return 1;
+        }
+    }
+    
     printf("╔══════════════════════════════════════════╗\n");
     printf("║   Scribble Game Server - Starting...    ║\n");
     printf("╚══════════════════════════════════════════╝\n\n");
@@ -80,28 +114,76 @@ int main(int argc, char* argv[]) {
     init_reconnection();
     printf("[SERVER] Reconnection system initialized\n");
     
-    // Start HTTP server
-    if (http_server_start(HTTP_PORT) < 0) {
-        fprintf(stderr, "[ERROR] Failed to start HTTP server\n");
-        logger_close();
-        return 1;
+    tcp_set_stroke_simplification(simplify_strokes);
+    if (simplify_strokes) {
+        printf("[SERVER] Stroke simplification enabled\n");
     }
     
-    // Start TCP server
-    if (tcp_server_start(TCP_PORT) < 0) {
-        fprintf(stderr, "[ERROR] Failed to start TCP server\n");
-        http_server_stop();
-        logger_close();
-        return 1;
+    udp_fec_set_enabled(udp_fec);
+    if (udp_fec) {
+        printf("[SERVER] UDP stroke parity enabled\n");
     }
     
-    // Start UDP server
-    if (udp_server_start(UDP_PORT) < 0) {
-        fprintf(stderr, "[ERROR] Failed to start UDP server\n");
-        tcp_server_stop();
-        http_server_stop();
-        logger_close();
-        return 1;
+    http_server_set_webui_dir(webui_dir);
+    
+    if (takeover) {
+        // Take the sockets and game state over from the running server
+        HandoffListeners listeners;
+        if (handoff_receive(HANDOFF_SOCKET_PATH, &listeners) < 0) {
+            fprintf(stderr, "[ERROR] Takeover failed; the running server keeps serving\n");
+            logger_close();
+            return 1;
+        }
+        
+        // The old process released the stats log and checkpoint before handing off
+        init_stats();
+        checkpoint_init(CHECKPOINT_PATH);
+        
+        if (http_server_adopt(listeners.http_fd) < 0 ||
+            tcp_server_adopt(listeners.tcp_fd) < 0 ||
+            udp_server_adopt(listeners.udp_fds, listeners.udp_count) < 0) {
+            fprintf(stderr, "[ERROR] Failed to adopt handed-off sockets\n");
+            logger_close();
+            return 1;
+        }
+    } else {
+        init_stats();
+        
+        // Rooms from before a crash wait for their players to reconnect
+        checkpoint_restore(CHECKPOINT_PATH);
+        checkpoint_init(CHECKPOINT_PATH);
+        
+        // Start HTTP server
+        if (http_server_start(HTTP_PORT) < 0) {
+            fprintf(stderr, "[ERROR] Failed to start HTTP server\n");
+            logger_close();
+            return 1;
+        }
+        
+        // Browsers can skip the proxy and speak WebSocket to the TCP reactor
+        if (websocket_port > 0 && tcp_server_listen_websocket(websocket_port) < 0) {
+            fprintf(stderr, "[ERROR] Failed to open WebSocket port\n");
+            http_server_stop();
+            logger_close();
+            return 1;
+        }
+        
+        // Start TCP server
+        if (tcp_server_start(TCP_PORT) < 0) {
+            fprintf(stderr, "[ERROR] Failed to start TCP server\n");
+            http_server_stop();
+            logger_close();
+            return 1;
+        }
+        
+        // Start UDP server
+        if (udp_server_start(UDP_PORT, udp_workers) < 0) {
+            fprintf(stderr, "[ERROR] Failed to start UDP server\n");
+            tcp_server_stop();
+            http_server_stop();
+            logger_close();
+            return 1;
+        }
     }
     
     // Start timer thread
@@ -114,12 +196,38 @@ int main(int argc, char* argv[]) {
     printf("║  HTTP (Web UI): http://localhost:%d   ║\n", HTTP_PORT);
     printf("║  TCP (Game):    port %d                 ║\n", TCP_PORT);
     printf("║  UDP (Drawing): port %d                 ║\n", UDP_PORT);
+    if (websocket_port > 0) {
+        printf("║  WebSocket:     port %-5d               ║\n", websocket_port);
+    }
     printf("╚══════════════════════════════════════════╝\n\n");
     printf("[SERVER] Press Ctrl+C to stop\n\n");
     
-    // Main loop
+    // Main loop: also waits for a new binary asking to take over
+    int handoff_fd = handoff_listen(HANDOFF_SOCKET_PATH);
+    bool handed_off = false;
     while (server_running) {
-        sleep(1);
+        int conn = handoff_accept(handoff_fd, 1000);
+        if (conn < 0) continue;
+        
+        // Rooms must not change under the snapshot; the network threads keep
+        // serving until handoff_send() detaches them
+        timer_running = false;
+        pthread_join(timer_tid, NULL);
+        
+        if (handoff_send(conn) == 0) {
+            handed_off = true;
+            break;
+        }
+        
+        timer_running = true;
+        pthread_create(&timer_tid, NULL, timer_thread, NULL);
+    }
+    
+    if (handoff_fd >= 0) {
+        close(handoff_fd);
+        if (!handed_off) {
+            unlink(HANDOFF_SOCKET_PATH);  // After a handoff the path is the new process's
+        }
     }
     
     // Cleanup
@@ -129,8 +237,14 @@ int main(int argc, char* argv[]) {
     tcp_server_stop();
     http_server_stop();
     
-    pthread_join(timer_tid, NULL);
+    if (!handed_off) {
+        pthread_join(timer_tid, NULL);
+    }
+    
+    // Nothing changes rooms any more; after a handoff they're the new process's
+    checkpoint_shutdown(!handed_off);
     
+    stats_shutdown();
     cleanup_word_list();
     logger_close();
     
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <pthread.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 
@@ -13,10 +14,26 @@
 #define MAX_CHAT_LEN 256
 #define MAX_ROOMS 100
 #define ROUND_TIME 90
+#define GAME_START_COUNTDOWN 15          // Seconds from the 2nd player joining to game start
+#define TIMER_RESYNC_INTERVAL_MS 15000   // Re-send deadlines so client clocks can't drift far
 #define RECONNECT_TIMEOUT 300  // 5 minutes
 #define MAX_CHAT_HISTORY 10
 #define MAX_STROKES 10000
 #define BUFFER_SIZE 4096
+#define MAX_STROKE_GROUPS 2048  // Pen-down to pen-up runs per canvas epoch
+#define STROKE_PATH_MAX_POINTS 64
+#define STROKE_PATH_MAX_DELAY_MS 50  // Longest a segment waits for simplification
+#define STROKE_BATCH_MAX 64           // Segments per UDP_STROKE_PACKED fanout message
+#define STROKE_BATCH_INTERVAL_MS 16   // Fanout tick for a room's batched strokes
+#define STROKE_LAG_ENTER_MS 250       // Send backlog (time to drain) that takes a receiver off live fanout
+#define STROKE_LAG_INTERVAL_MS 100    // Coalescing tick for a lagging receiver
+#define STROKE_LAG_TOLERANCE 2.0f     // Simplification for lagging receivers, in canvas pixels
+#define UDP_RESEND_WINDOW 256         // UDP stroke datagrams a room can still retransmit; power of two
+#define UDP_RESEND_INTERVAL_MS 40     // Minimum age of a datagram before it is resent
+#define UDP_RESEND_MAX 32             // Retransmits per ack, so one ack can't flood a receiver
+#define UDP_MAX_DATAGRAM 1200         // Fits common path MTUs, tunnels included, without fragmenting
+#define UDP_FEC_MAX_GROUP 16          // Stroke datagrams one parity datagram can cover
+#define UDP_LOSS_GAIN 0.03f           // Weight of each datagram in a receiver's loss estimate
 
 // Ports
 #define HTTP_PORT 8080
@@ -55,14 +72,23 @@ typedef enum {
     MSG_RECONNECT_SUCCESS,
     MSG_RECONNECT_FAIL,
     MSG_ERROR,
-    MSG_DISCONNECT
+    MSG_DISCONNECT,
+    MSG_CANVAS_SNAPSHOT,
+    MSG_ROOM_PATCH,   // Changed room-state fields, tagged with the room's patch seq
+    MSG_ROOM_RESYNC,  // Client asks for / server answers with a full room state
+    MSG_LEADERBOARD   // Client asks for / server answers with the all-time top players
 } MessageType;
 
 // UDP Message Types
 typedef enum {
-    UDP_STROKE = 100,
+    UDP_STROKE = 100,   // Over UDP: any number of strokes, see udp/udp_wire.h
     UDP_CLEAR_CANVAS,
-    UDP_UNDO
+    UDP_UNDO,
+    UDP_STROKE_PACKED,  // Strokes in the game/stroke_codec.h format, base64 in "strokes"
+    UDP_BIND,           // Client -> server: session token, ties the source endpoint to a player
+    UDP_BIND_ACK,       // Server -> client: player id, sent to the endpoint it recorded
+    UDP_ACK,            // Client -> server: header only, for receivers with nothing to send
+    UDP_FEC             // Server -> client: XOR parity over a group of stroke datagrams
 } UDPMessageType;
 
 // Player State
@@ -88,9 +114,56 @@ typedef struct {
     float x1, y1, x2, y2;
     uint32_t color;
     uint8_t thickness;
+    uint32_t group_id;  // Drawer's pen-down counter; one group per continuous stroke
     uint64_t timestamp;
 } Stroke;
 
+// Range of room->strokes drawn in one pen-down/pen-up run
+typedef struct {
+    uint32_t group_id;
+    int first_stroke;
+    int stroke_count;
+} StrokeGroup;
+
+// Drawer's not-yet-broadcast polyline (see game/stroke_simplify.h)
+typedef struct {
+    float xs[STROKE_PATH_MAX_POINTS];
+    float ys[STROKE_PATH_MAX_POINTS];
+    int count;
+    uint32_t color;
+    uint8_t thickness;
+    uint32_t group_id;
+    uint64_t started_at;
+} StrokePath;
+
+// Room's record of a sequenced UDP stroke datagram; the strokes themselves
+// are re-read from room->strokes, and only if they are still there
+typedef struct {
+    uint32_t seq;
+    uint32_t epoch;          // canvas_epoch when sent
+    int first_stroke;        // Position in room->strokes, -1 if the log was full
+    int stroke_count;
+    uint64_t first_timestamp;  // Match the strokes at both ends while they survive
+    uint64_t last_timestamp;
+    uint32_t sender_id;      // Never resent to the player who drew them
+    uint64_t sent_at;        // Last (re)transmission
+} UdpSentDatagram;
+
+// Open parity group over a room's stroke datagrams (see udp/udp_fec.h)
+typedef struct {
+    uint32_t first_seq;
+    int count;
+    int size;                // Datagrams in this group, chosen when it opens
+    uint32_t sender_id;
+    uint64_t opened_at;
+    uint16_t len_xor;        // XOR of the payload lengths
+    uint16_t max_len;
+    uint8_t parity[UDP_MAX_DATAGRAM];
+} UdpFecGroup;
+
+// Per-room raster snapshot (see game/canvas.h)
+typedef struct CanvasRaster CanvasRaster;
+
 // Player structure
 typedef struct {
     int fd;  // TCP socket
@@ -108,6 +181,31 @@ typedef struct {
     // TCP receive buffer for handling partial messages
     char recv_buffer[BUFFER_SIZE];
     int recv_buffer_len;
+    uint8_t websocket;  // WS_STATE_* (see tcp/websocket.h); 0 for length-prefixed TCP
+    // Stroke history catch-up after reconnect or late join
+    bool catchup_active;
+    uint32_t catchup_room_id;
+    uint32_t catchup_epoch;  // Room canvas_epoch the replay belongs to
+    int catchup_next;        // Next canvas tile to send
+    int catchup_stroke_mark; // room->stroke_count when the snapshot started
+    uint64_t catchup_last_sent;
+    bool stroke_path_pending;  // Room holds segments from this drawer awaiting flush
+    bool stroke_batch_pending; // Room holds strokes from this drawer awaiting fanout
+    // Slow receiver: live strokes are skipped and replayed from the room's
+    // log, coalesced and simplified, as its connection drains
+    bool stroke_lagging;
+    uint32_t stroke_lag_room_id;
+    uint32_t stroke_lag_epoch;     // Room canvas_epoch stroke_lag_next refers to
+    int stroke_lag_next;           // First room->strokes entry the receiver lacks
+    uint64_t stroke_lag_last_sent;
+    // UDP endpoint as observed by the server (see udp/udp_endpoints.h)
+    struct sockaddr_in udp_addr;
+    bool udp_bound;
+    // UDP receive state for one room, under that room's stroke_lock
+    uint32_t udp_room_id;
+    uint32_t udp_base_seq;  // Strokes up to here predate this receiver (canvas snapshot has them)
+    uint32_t udp_acked;     // Highest seq the receiver has acked
+    float udp_loss;         // Fraction of datagrams acks report missing, smoothed
 } Player;
 
 // Room structure
@@ -122,13 +220,37 @@ typedef struct {
     int round_number;
     int total_rounds;  // Total rounds for this game (equals player count at start)
     uint64_t round_start_time;
+    uint64_t round_deadline;       // get_monotonic_time_ms() when the round times out
     int time_remaining;
     Stroke strokes[MAX_STROKES];
     int stroke_count;
+    StrokeGroup stroke_groups[MAX_STROKE_GROUPS];
+    int group_count;
+    bool stroke_log_overflowed;  // A stroke reached the canvas but not the log; undo is off until a clear
+    uint32_t canvas_epoch;  // Bumped whenever the canvas is wiped
+    uint32_t strokes_version;  // Bumped whenever strokes/stroke_groups change
+    CanvasRaster* canvas;   // Raster of everything drawn this epoch
+    pthread_mutex_t stroke_lock;  // Guards strokes, stroke_groups, canvas and the udp_* send state; UDP workers draw too
+    StrokePath pending_path;
+    uint32_t state_version;        // Bumped by room_state_changed()
+    uint32_t patch_seq;            // Last MSG_ROOM_PATCH sent; full states carry it as "seq"
+    uint32_t state_json_version;   // state_version that state_json was built from
+    char* state_json;              // Cached json_create_room_state() output
+    Stroke stroke_batch[STROKE_BATCH_MAX];  // Stored but not yet fanned out
+    int stroke_batch_count;
+    int stroke_batch_first;        // Where stroke_batch[0] sits in strokes[], -1 if not stored
+    uint64_t stroke_batch_started_at;
+    uint32_t stroke_batch_epoch;   // canvas_epoch pending_path and stroke_batch were drawn on
     bool is_private;
     uint64_t created_at;
     uint64_t game_start_countdown;  // Timestamp when countdown started (0 = not started)
     bool countdown_active;           // Whether countdown is active
+    uint64_t countdown_deadline;     // get_monotonic_time_ms() when the game starts
+    uint64_t timer_resync_at;        // Next periodic deadline broadcast
+    uint64_t restored_until;         // Checkpoint-restored room held for reconnects until then
+    uint32_t udp_seq;                // Last sequence number given to a UDP stroke datagram
+    UdpSentDatagram udp_sent[UDP_RESEND_WINDOW];  // Indexed by seq % UDP_RESEND_WINDOW
+    UdpFecGroup fec;
 } Room;
 
 // TCP Message Header (4 bytes length + JSON payload)
@@ -137,20 +259,15 @@ typedef struct {
     char* json_data;
 } TCPMessage;
 
-// UDP Message Header
-typedef struct {
-    UDPMessageType type;
-    uint32_t room_id;
-    union {
-        Stroke stroke;
-    } data;
-} UDPMessage;
+// UDP datagrams use the packed format in udp/udp_wire.h. Clients piggyback
+// acks on everything they send; anything missing is resent from the room's
+// stroke log unless a clear or undo has superseded it. UDP_BIND carries the
+// session token and is sent after login or reconnect, and again whenever the
+// client's local port may have changed.
 
 // Function prototypes for message serialization
 int serialize_tcp_message(MessageType type, const char* json, char* buffer, int buffer_size);
 int deserialize_tcp_message(const char* buffer, int len, MessageType* type, char** json);
-int serialize_udp_stroke(const Stroke* stroke, uint32_t room_id, char* buffer, int buffer_size);
-int deserialize_udp_stroke(const char* buffer, int len, Stroke* stroke, uint32_t* room_id);
 
 // JSON parsing helpers
 int json_get_data_string(const char* json, const char* key, char* out, int out_size);
@@ -1,17 +1,33 @@
 #include "tcp_handler.h"
 #include "tcp_parser.h"
+#include "websocket.h"
+#include "tcp_server.h"
 #include "../utils/json.h"
 #include "../utils/logger.h"
 #include "../utils/timer.h"
 #include "../game/matchmaking.h"
 #include "../game/game_logic.h"
 #include "../game/reconnection.h"
+#include "../game/canvas.h"
+#include "../game/stroke_simplify.h"
+#include "../game/stroke_codec.h"
+#include "../game/stats.h"
+#include "../udp/udp_endpoints.h"
+#include "../udp/udp_server.h"
+#include "../utils/base64.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define CANVAS_CATCHUP_MAX_QUEUED (32 * 1024)  // Back off while this much is unsent
 
 static uint32_t next_player_id = 1;
+static bool stroke_simplification = false;
 
 void send_tcp_message(int fd, MessageType type, const char* json_data) {
     const char* type_names[] = {"PING", "PONG", "REGISTER", "REGISTER_ACK", "JOIN_ROOM", "CREATE_ROOM",
@@ -27,7 +43,9 @@ void send_tcp_message(int fd, MessageType type, const char* json_data) {
     printf("[TCP] send_tcp_message: type=%d (%s), fd=%d, json_msg=%s\n", type, type_name, fd, json_msg);
     
     char buffer[BUFFER_SIZE];
-    int len = serialize_tcp_message(type, json_msg, buffer, sizeof(buffer));
+    int len = websocket_is_client(fd)
+        ? websocket_frame(json_msg, strlen(json_msg), buffer, sizeof(buffer))
+        : serialize_tcp_message(type, json_msg, buffer, sizeof(buffer));
     
     if (len > 0) {
         send(fd, buffer, len, 0);
@@ -36,6 +54,20 @@ void send_tcp_message(int fd, MessageType type, const char* json_data) {
     free(json_msg);
 }
 
+// Bytes written to the socket but not yet acknowledged by the peer
+int tcp_send_queue_bytes(int fd) {
+    int queued = 0;
+#if defined(SO_NWRITE)
+    socklen_t len = sizeof(queued);
+    if (getsockopt(fd, SOL_SOCKET, SO_NWRITE, &queued, &len) < 0) return 0;
+#elif defined(TIOCOUTQ)
+    if (ioctl(fd, TIOCOUTQ, &queued) < 0) return 0;
+#else
+    (void)fd;
+#endif
+    return queued;
+}
+
 void broadcast_to_room(Room* room, MessageType type, const char* json_data, Player* exclude) {
     for (int i = 0; i < room->player_count; i++) {
         if (room->players[i] && room->players[i] != exclude) {
@@ -44,6 +76,15 @@ void broadcast_to_room(Room* room, MessageType type, const char* json_data, Play
     }
 }
 
+// Usernames are pasted into JSON unescaped everywhere (room state, chat,
+// the leaderboard), so a name that would need escaping gets the default
+static bool username_valid(const char* username) {
+    for (const unsigned char* c = (const unsigned char*)username; *c; c++) {
+        if (*c < 0x20 || *c == '"' || *c == '\\' || *c == 0x7f) return false;
+    }
+    return true;
+}
+
 void handle_register(Player* player, const char* json) {
     char username[MAX_USERNAME];
     printf("[TCP] handle_register: json=%s\n", json);
@@ -51,16 +92,20 @@ void handle_register(Player* player, const char* json) {
     if (json_get_data_string(json, "username", username, sizeof(username)) < 0) {
         strcpy(username, "Player");
         printf("[TCP] handle_register: Failed to get username, using default\n");
+    } else if (!username_valid(username)) {
+        strcpy(username, "Player");
+        printf("[TCP] handle_register: Username needs escaping, using default\n");
     }
     
-    player->player_id = next_player_id++;
+    uint32_t player_id = next_player_id++;
+    char session_token[64];
+    generate_session_token(session_token, player_id);
+    tcp_server_set_session(player, player_id, session_token);
     strncpy(player->username, username, MAX_USERNAME - 1);
     player->state = PLAYER_LOBBY;
     player->score = 0;
     player->last_seen = get_current_time_ms();
     
-    generate_session_token(player->session_token, player->player_id);
-    
     printf("[TCP] Registered player %u: %s (fd=%d)\n", player->player_id, username, player->fd);
     
     char response[512];
@@ -81,6 +126,17 @@ void handle_ping(Player* player) {
     send_tcp_message(player->fd, MSG_PONG, response);
 }
 
+static void broadcast_player_added(Room* room, Player* player) {
+    char* player_info = json_create_player_info(player);
+    if (!player_info) return;
+    
+    char fields[512];
+    snprintf(fields, sizeof(fields), "\"players\":[%s],\"player_count\":%d",
+             player_info, room->player_count);
+    broadcast_room_patch(room, fields, player);
+    free(player_info);
+}
+
 void handle_join_room(Player* player) {
     printf("[TCP] Player %u (%s) joining room\n", player->player_id, player->username);
     
@@ -89,13 +145,13 @@ void handle_join_room(Player* player) {
         printf("[TCP] Player %u joined room %u (now %d players)\n", 
                player->player_id, room ? room->room_id : 0, room ? room->player_count : 0);
         if (room) {
-            // Send full room state to ALL players (including new player and existing players)
+            // A patch adding the newcomer for everyone else, then a full state
+            // for the newcomer that already carries the patch's seq
+            broadcast_player_added(room, player);
             char* room_state = json_create_room_state(room);
             send_tcp_message(player->fd, MSG_ROOM_JOINED, room_state);
-            
-            // Send updated room state to existing players so they see the new player
-            broadcast_to_room(room, MSG_ROOM_JOINED, room_state, player);
             free(room_state);
+            send_room_timer(room, player);
             
             // Also send player join notification for chat message
             char player_info[256];
@@ -103,6 +159,8 @@ void handle_join_room(Player* player) {
                      "{\"player_id\":%u,\"username\":\"%s\"}",
                      player->player_id, player->username);
             broadcast_to_room(room, MSG_PLAYER_JOIN, player_info, player);
+            
+            start_canvas_catchup(player, room);
         }
     } else {
         send_tcp_message(player->fd, MSG_ERROR, "{\"error\":\"Failed to join room\"}");
@@ -153,12 +211,7 @@ void handle_chat(Player* player, const char* json) {
                      player->player_id, player->username, player->score);
             broadcast_to_room(room, MSG_GUESS_CORRECT, response, NULL);
             
-            // Send score update
-            char score_msg[256];
-            snprintf(score_msg, sizeof(score_msg),
-                     "{\"player_id\":%u,\"score\":%d}",
-                     player->player_id, player->score);
-            broadcast_to_room(room, MSG_SCORE_UPDATE, score_msg, NULL);
+            // process_guess already sent the score patch
             return;
         }
     }
@@ -180,10 +233,12 @@ void handle_reconnect(Player* player, const char* json) {
     
     Room* room = NULL;
     if (restore_player_state(player, session_token, &room) == 0) {
-        // Success
+        // Success: patch the others first so our full state includes its seq
+        broadcast_player_added(room, player);
         char* room_state = json_create_room_state(room);
         send_tcp_message(player->fd, MSG_RECONNECT_SUCCESS, room_state);
         free(room_state);
+        send_room_timer(room, player);
         
         // Notify other players
         char player_info[256];
@@ -192,18 +247,44 @@ void handle_reconnect(Player* player, const char* json) {
                  player->player_id, player->username);
         broadcast_to_room(room, MSG_PLAYER_JOIN, player_info, player);
         
-        // Resend all strokes to catch up
-        for (int i = 0; i < room->stroke_count; i++) {
-            // Note: Strokes are sent via UDP, but we can trigger resend here
-        }
+        // Send the canvas snapshot in paced chunks from the reactor loop
+        start_canvas_catchup(player, room);
     } else {
         send_tcp_message(player->fd, MSG_RECONNECT_FAIL, 
                         "{\"error\":\"Reconnection failed\"}");
     }
 }
 
+// Client saw a gap in patch seqs: send a fresh full state to rebase on
+void handle_resync(Player* player) {
+    Room* room = get_player_room(player);
+    if (!room) return;
+    
+    char* room_state = json_create_room_state(room);
+    if (room_state) {
+        send_tcp_message(player->fd, MSG_ROOM_RESYNC, room_state);
+        free(room_state);
+    }
+}
+
+// All-time leaderboard, served from the stats module's in-memory ranking
+void handle_leaderboard(Player* player) {
+    char leaderboard[BUFFER_SIZE - 64];
+    if (stats_leaderboard_json(leaderboard, sizeof(leaderboard), LEADERBOARD_SIZE) < 0) {
+        send_tcp_message(player->fd, MSG_ERROR, "{\"error\":\"Leaderboard unavailable\"}");
+        return;
+    }
+    send_tcp_message(player->fd, MSG_LEADERBOARD, leaderboard);
+}
+
 void handle_disconnect(Player* player) {
     Room* room = get_player_room(player);
+    
+    // Strokes the drawer sent just before going are stored; send them on
+    if (room && player->is_drawing) {
+        flush_pending_strokes(room, player);
+    }
+    
     if (room && room->state == ROOM_PLAYING) {
         // Save state for reconnection
         save_player_state(player, room);
@@ -235,85 +316,547 @@ void handle_clear_canvas(Player* player) {
     
     printf("[TCP] CLEAR: Broadcasting clear canvas from player %u to room %u\n", player->player_id, room->room_id);
     
+    clear_strokes(room);
+    
     // Broadcast clear to all other players
     broadcast_to_room(room, UDP_CLEAR_CANVAS, "{}", player);
 }
 
-void handle_stroke(Player* player, const char* json) {
+// Ids keep counting across a hot restart so new players never collide with live ones
+void tcp_handler_export(SerialWriter* w) {
+    serial_put_u32(w, next_player_id);
+}
+
+int tcp_handler_import(SerialReader* r) {
+    next_player_id = serial_get_u32(r);
+    return r->failed ? -1 : 0;
+}
+
+void tcp_set_stroke_simplification(bool enabled) {
+    stroke_simplification = enabled;
+}
+
+// How long the bytes already queued on the receiver's socket take to drain,
+// from the kernel's RTT and congestion window (which shrinks with loss).
+// Also keeps player->rtt current.
+static uint64_t send_backlog_ms(Player* player) {
+    int queued = tcp_send_queue_bytes(player->fd);
+    if (queued <= 0) return 0;
+    
+    // However fast the link, this much queued means the peer isn't reading
+    if (queued > CANVAS_CATCHUP_MAX_QUEUED) return STROKE_LAG_ENTER_MS;
+    
+#ifdef TCP_INFO
+    struct tcp_info info;
+    socklen_t len = sizeof(info);
+    if (getsockopt(player->fd, IPPROTO_TCP, TCP_INFO, &info, &len) == 0 && info.tcpi_rtt > 0) {
+        player->rtt = info.tcpi_rtt / 1000;
+        
+        // In retransmit backoff nothing drains at all
+        if (info.tcpi_retransmits > 0) return STROKE_LAG_ENTER_MS;
+        
+        uint64_t bytes_per_rtt = (uint64_t)info.tcpi_snd_cwnd * info.tcpi_snd_mss;
+        if (bytes_per_rtt > 0) {
+            return (uint64_t)queued * info.tcpi_rtt / bytes_per_rtt / 1000;
+        }
+    }
+#endif
+    return 0;
+}
+
+static int format_strokes(const Room* room, uint32_t drawer_id, const Stroke* strokes, int count,
+                          char* msg, size_t msg_size) {
+    uint8_t blob[STROKE_BATCH_MAX * STROKE_CODEC_MAX_SEGMENT_BYTES + 1];
+    int blob_len = stroke_codec_encode(strokes, count, room->round_start_time,
+                                       blob, sizeof(blob));
+    if (blob_len < 0 || (size_t)BASE64_ENCODED_LEN(blob_len) + 64 > msg_size) return -1;
+    
+    int len = snprintf(msg, msg_size, "{\"player_id\":%u,\"strokes\":\"", drawer_id);
+    len += base64_encode(blob, blob_len, msg + len);
+    len += snprintf(msg + len, msg_size - len, "\"}");
+    return len;
+}
+
+// Take a receiver off live fanout from log entry next onwards
+static void start_stroke_lag(Player* player, Room* room, int next) {
+    player->stroke_lagging = true;
+    player->stroke_lag_room_id = room->room_id;
+    player->stroke_lag_epoch = room->canvas_epoch;
+    player->stroke_lag_next = next;
+    player->stroke_lag_last_sent = get_current_time_ms();
+    
+    printf("[TCP] STROKE: Player %u is lagging (rtt %llu ms), coalescing its strokes\n",
+           player->player_id, (unsigned long long)player->rtt);
+}
+
+// Fan strokes out as UDP_STROKE_PACKED, split so each message fits a TCP frame
+// (STROKE_BATCH_MAX worst-case segments still fit BUFFER_SIZE as base64).
+// first_stroke is where strokes sit in room->strokes, or -1 if not stored.
+// A receiver whose backlog has grown too long is left to pump_stroke_lag().
+// Receivers with a UDP endpoint get the strokes as datagrams instead, which
+// are acked and resent on their own.
+void broadcast_strokes(Room* room, Player* drawer, const Stroke* strokes, int count,
+                       int first_stroke) {
+    bool udp = udp_server_running();
+    
+    for (int first = 0; first < count; first += STROKE_BATCH_MAX) {
+        int n = count - first;
+        if (n > STROKE_BATCH_MAX) n = STROKE_BATCH_MAX;
+        
+        char msg[BASE64_ENCODED_LEN(STROKE_BATCH_MAX * STROKE_CODEC_MAX_SEGMENT_BYTES + 1) + 64];
+        if (format_strokes(room, drawer->player_id, strokes + first, n, msg, sizeof(msg)) < 0) return;
+        
+        for (int i = 0; i < room->player_count; i++) {
+            Player* p = room->players[i];
+            if (!p || p == drawer) continue;
+            
+            struct sockaddr_in addr;
+            if (udp && udp_endpoint_get(p, &addr)) continue;
+            
+            if (p->stroke_lagging && p->stroke_lag_room_id == room->room_id) {
+                // Strokes the log doesn't hold are only on the canvas
+                if (first_stroke < 0) {
+                    p->stroke_lagging = false;
+                    start_canvas_catchup(p, room);
+                }
+                continue;
+            }
+            if (first_stroke >= 0 && send_backlog_ms(p) >= STROKE_LAG_ENTER_MS) {
+                start_stroke_lag(p, room, first_stroke + first);
+                continue;
+            }
+            send_tcp_message(p->fd, (MessageType)UDP_STROKE_PACKED, msg);
+        }
+    }
+    
+    // A player that binds in between gets these twice rather than not at all
+    if (udp) udp_server_broadcast_strokes(room, strokes, count, first_stroke, drawer);
+}
+
+void flush_stroke_batch(Room* room, Player* drawer) {
+    if (room->stroke_batch_count > 0) {
+        broadcast_strokes(room, drawer, room->stroke_batch, room->stroke_batch_count,
+                          room->stroke_batch_first);
+        room->stroke_batch_count = 0;
+    }
+    drawer->stroke_batch_pending = false;
+}
+
+// Forget the polyline and batch the drawer left pending if the canvas they
+// were drawn on has been cleared since; receivers are wiping anyway
+static void drop_cleared_strokes(Room* room, Player* drawer) {
+    pthread_mutex_lock(&room->stroke_lock);
+    uint32_t epoch = room->canvas_epoch;
+    pthread_mutex_unlock(&room->stroke_lock);
+    if (epoch == room->stroke_batch_epoch) return;
+    
+    room->stroke_batch_epoch = epoch;
+    stroke_path_reset(&room->pending_path);
+    room->stroke_batch_count = 0;
+    drawer->stroke_path_pending = false;
+    drawer->stroke_batch_pending = false;
+}
+
+// Hold stored strokes for the room's next fanout tick so a burst of
+// segments goes out as one message per receiver. strokes[0] was stored at
+// first_stroke, which is -1 if the log had no room for all of them.
+static void queue_strokes(Room* room, Player* drawer, const Stroke* strokes, int count,
+                          int first_stroke) {
+    for (int i = 0; i < count; i++) {
+        if (room->stroke_batch_count == STROKE_BATCH_MAX) {
+            flush_stroke_batch(room, drawer);
+        }
+        if (room->stroke_batch_count == 0) {
+            room->stroke_batch_started_at = get_current_time_ms();
+            room->stroke_batch_first = first_stroke >= 0 ? first_stroke + i : -1;
+        } else if (first_stroke < 0) {
+            room->stroke_batch_first = -1;  // The log filled up part way
+        }
+        room->stroke_batch[room->stroke_batch_count++] = strokes[i];
+    }
+    drawer->stroke_batch_pending = room->stroke_batch_count > 0;
+}
+
+// Rebuild polylines from room->strokes[*next, limit) and simplify them more
+// coarsely than live fanout does; stops before a polyline whose simplified
+// segments would not fit in out. Advances *next past what was written.
+static int coalesce_strokes(const Room* room, int* next, int limit, Stroke* out, int max_out) {
+    int written = 0;
+    int i = *next;
+    while (i < limit) {
+        StrokePath path;
+        stroke_path_reset(&path);
+        int end = i;
+        while (end < limit &&
+               (path.count == 0 || stroke_path_extends(&path, &room->strokes[end]))) {
+            bool has_room = stroke_path_append(&path, &room->strokes[end], room->strokes[end].timestamp);
+            end++;
+            if (!has_room) break;
+        }
+        Stroke simplified[STROKE_PATH_MAX_POINTS];
+        int n = stroke_path_simplify(&path, STROKE_LAG_TOLERANCE, simplified, STROKE_PATH_MAX_POINTS);
+        if (written + n > max_out) break;
+        
+        for (int k = 0; k < n; k++) {
+            out[written] = simplified[k];
+            out[written++].timestamp = room->strokes[end - 1].timestamp;
+        }
+        i = end;
+    }
+    *next = i;
+    return written;
+}
+
+static uint32_t room_drawer_id(const Room* room) {
+    for (int i = 0; i < room->player_count; i++) {
+        if (room->players[i] && room->players[i]->is_drawing) return room->players[i]->player_id;
+    }
+    return 0;
+}
+
+// Reactor: once a lagging receiver's backlog has drained, send everything
+// it missed as a few coalesced messages, and put it back on live fanout
+// when it has caught up. Returns whether it is still lagging.
+bool pump_stroke_lag(Player* player, uint64_t now) {
+    if (!player->stroke_lagging) return false;
+    
+    Room* room = get_player_room(player);
+    if (!room || room->room_id != player->stroke_lag_room_id || player->is_drawing) {
+        player->stroke_lagging = false;
+        return false;
+    }
+    if (now - player->stroke_lag_last_sent < STROKE_LAG_INTERVAL_MS) return true;
+    if (send_backlog_ms(player) >= STROKE_LAG_ENTER_MS) return true;
+    player->stroke_lag_last_sent = now;
+    
+    // A clear or a new round: the player got that event, and everything
+    // drawn since is in the log from the start
+    if (room->canvas_epoch != player->stroke_lag_epoch) {
+        player->stroke_lag_epoch = room->canvas_epoch;
+        player->stroke_lag_next = 0;
+    }
+    if (player->stroke_lag_next > room->stroke_count) {
+        player->stroke_lag_next = room->stroke_count;
+    }
+    
+    // Strokes waiting in the room's batch are in the log too, but the
+    // batch reaches this player live once it has caught up
+    int limit = room->stroke_count;
+    if (room->stroke_batch_count > 0 && room->stroke_batch_first >= 0) {
+        limit = room->stroke_batch_first;
+    }
+    
+    uint32_t drawer_id = room_drawer_id(room);
+    while (player->stroke_lag_next < limit) {
+        Stroke strokes[STROKE_BATCH_MAX];
+        pthread_mutex_lock(&room->stroke_lock);
+        int count = coalesce_strokes(room, &player->stroke_lag_next, limit,
+                                     strokes, STROKE_BATCH_MAX);
+        pthread_mutex_unlock(&room->stroke_lock);
+        if (count <= 0) break;
+        
+        char msg[BASE64_ENCODED_LEN(STROKE_BATCH_MAX * STROKE_CODEC_MAX_SEGMENT_BYTES + 1) + 64];
+        if (format_strokes(room, drawer_id, strokes, count, msg, sizeof(msg)) >= 0) {
+            send_tcp_message(player->fd, (MessageType)UDP_STROKE_PACKED, msg);
+        }
+        
+        // Leave the rest for the next tick if this filled the pipe again
+        if (send_backlog_ms(player) >= STROKE_LAG_ENTER_MS) return true;
+    }
+    
+    // Caught up; strokes drawn past a full log exist only on the canvas
+    player->stroke_lagging = false;
+    if (room->stroke_count >= MAX_STROKES) {
+        start_canvas_catchup(player, room);
+    }
+    printf("[TCP] STROKE: Player %u caught up\n", player->player_id);
+    return false;
+}
+
+// Simplify the room's pending polyline, then store and broadcast what is left
+void flush_stroke_path(Room* room, Player* drawer) {
+    Stroke segments[STROKE_PATH_MAX_POINTS];
+    int input_segments = room->pending_path.count - 1;
+    int count = stroke_path_simplify(&room->pending_path, STROKE_SIMPLIFY_TOLERANCE,
+                                     segments, STROKE_PATH_MAX_POINTS);
+    
+    uint64_t now = get_current_time_ms();
+    for (int i = 0; i < count; i++) {
+        segments[i].timestamp = now;
+    }
+    int first_stroke = add_strokes(room, segments, count);
+    queue_strokes(room, drawer, segments, count, first_stroke);
+    
+    printf("[TCP] STROKE: Flushed %d segments as %d for room %u\n",
+           input_segments, count, room->room_id);
+    
+    stroke_path_reset(&room->pending_path);
+    drawer->stroke_path_pending = false;
+}
+
+// Everything the drawer's pen left waiting goes out now
+void flush_pending_strokes(Room* room, Player* drawer) {
+    drop_cleared_strokes(room, drawer);
+    if (room->pending_path.count > 0) {
+        flush_stroke_path(room, drawer);
+    }
+    flush_stroke_batch(room, drawer);
+}
+
+// Called from the reactor loop: flush a paused pen's polyline and any batch
+// whose tick has come up
+void flush_due_strokes(Player* player, uint64_t now) {
+    Room* room = get_player_room(player);
+    if (!room) {
+        player->stroke_path_pending = false;
+        player->stroke_batch_pending = false;
+        return;
+    }
+    drop_cleared_strokes(room, player);
+    
+    // No longer drawing, without a clear having wiped the pending strokes:
+    // they are still this player's unless someone else holds the pen now
+    if (!player->is_drawing) {
+        if (room_drawer_id(room) == 0) {
+            flush_pending_strokes(room, player);
+        }
+        player->stroke_path_pending = false;
+        player->stroke_batch_pending = false;
+        return;
+    }
+    
+    if (room->pending_path.count == 0) {
+        player->stroke_path_pending = false;
+    } else if (now - room->pending_path.started_at >= STROKE_PATH_MAX_DELAY_MS) {
+        flush_stroke_path(room, player);
+    }
+    
+    if (room->stroke_batch_count == 0) {
+        player->stroke_batch_pending = false;
+    } else if (now - room->stroke_batch_started_at >= STROKE_BATCH_INTERVAL_MS) {
+        flush_stroke_batch(room, player);
+    }
+}
+
+void handle_undo(Player* player) {
+    Room* room = get_player_room(player);
+    if (!room || room->state != ROOM_PLAYING || !player->is_drawing) {
+        return;
+    }
+    
+    // Segments still waiting for simplification belong to the newest group,
+    // and viewers must have every queued stroke before they can remove it
+    flush_pending_strokes(room, player);
+    
+    StrokeGroup group;
+    if (undo_last_stroke_group(room, &group) < 0) {
+        printf("[TCP] UNDO: Nothing to undo in room %u\n", room->room_id);
+        // The drawer already took its last group off locally; give it back
+        if (room->stroke_count > 0) {
+            start_canvas_catchup(player, room);
+        }
+        return;
+    }
+    
+    printf("[TCP] UNDO: Removed group %u (%d strokes) in room %u\n",
+           group.group_id, group.stroke_count, room->room_id);
+    
+    char undo_msg[64];
+    snprintf(undo_msg, sizeof(undo_msg), "{\"group\":%u}", group.group_id);
+    
+    for (int i = 0; i < room->player_count; i++) {
+        Player* p = room->players[i];
+        if (!p) continue;
+        
+        // A lagging receiver will be replayed whatever refills the slots
+        if (p->stroke_lagging && group.first_stroke < p->stroke_lag_next) {
+            p->stroke_lag_next = group.first_stroke;
+        }
+        
+        if (p->catchup_epoch == room->canvas_epoch && group.first_stroke < p->catchup_stroke_mark) {
+            // The group is baked into the snapshot this player started from,
+            // so they cannot peel it off locally; send a fresh snapshot instead.
+            // A mark from before a clear or new round says nothing about this canvas.
+            start_canvas_catchup(p, room);
+        } else if (p != player) {
+            // The drawer already removed the group locally
+            send_tcp_message(p->fd, (MessageType)UDP_UNDO, undo_msg);
+        }
+    }
+}
+
+// Store strokes from the drawer and fan them out, or queue them for simplification
+static void accept_strokes(Room* room, Player* player, Stroke* strokes, int count) {
+    drop_cleared_strokes(room, player);
+    if (stroke_simplification) {
+        // Merge into the drawer's polyline; broadcast happens on flush
+        StrokePath* path = &room->pending_path;
+        for (int i = 0; i < count; i++) {
+            if (path->count > 0 && !stroke_path_extends(path, &strokes[i])) {
+                flush_stroke_path(room, player);
+            }
+            if (stroke_path_append(path, &strokes[i], strokes[i].timestamp)) {
+                player->stroke_path_pending = true;
+            } else {
+                flush_stroke_path(room, player);
+            }
+        }
+        return;
+    }
+    
+    int first_stroke = add_strokes(room, strokes, count);
+    queue_strokes(room, player, strokes, count, first_stroke);
+}
+
+static Room* get_drawing_room(Player* player) {
     Room* room = get_player_room(player);
     if (!room || room->state != ROOM_PLAYING) {
         printf("[TCP] STROKE: Player %u not in playing room (room=%p, state=%d)\n", 
                player->player_id, (void*)room, room ? room->state : -1);
-        return;
+        return NULL;
     }
     
     // Only allow drawing player to send strokes
     if (!player->is_drawing) {
         printf("[TCP] STROKE: Player %u tried to draw but is not the drawer\n", player->player_id);
+        return NULL;
+    }
+    return room;
+}
+
+// Legacy single-segment JSON stroke
+void handle_stroke(Player* player, const char* json) {
+    Room* room = get_drawing_room(player);
+    if (!room) return;
+    
+    const char* data = strstr(json, "\"data\":");
+    if (!data) {
+        printf("[TCP] STROKE: WARNING - No data field found in JSON\n");
+        return;
+    }
+    
+    Stroke stroke;
+    int color = 0, thickness = 0, group = 0;
+    memset(&stroke, 0, sizeof(stroke));
+    json_get_float(data, "x1", &stroke.x1);
+    json_get_float(data, "y1", &stroke.y1);
+    json_get_float(data, "x2", &stroke.x2);
+    json_get_float(data, "y2", &stroke.y2);
+    json_get_int(data, "color", &color);
+    json_get_int(data, "thickness", &thickness);
+    json_get_int(data, "group", &group);
+    stroke.color = (uint32_t)color;
+    stroke.thickness = (uint8_t)thickness;
+    stroke.group_id = (uint32_t)group;
+    stroke.timestamp = get_current_time_ms();
+    
+    accept_strokes(room, player, &stroke, 1);
+}
+
+// {"strokes":"<base64 stroke_codec blob>"}
+void handle_stroke_packed(Player* player, const char* json) {
+    Room* room = get_drawing_room(player);
+    if (!room) return;
+    
+    char encoded[BUFFER_SIZE];
+    if (json_get_string(json, "strokes", encoded, sizeof(encoded)) < 0) {
+        printf("[TCP] STROKE: WARNING - No strokes field from player %u\n", player->player_id);
         return;
     }
     
-    printf("[TCP] STROKE: Received from player %u in room %u\n", player->player_id, room->room_id);
-    printf("[TCP] STROKE: Raw JSON: %s\n", json);
+    uint8_t blob[BUFFER_SIZE];
+    size_t encoded_len = strlen(encoded);
+    int blob_len = encoded_len / 4 * 3 <= sizeof(blob) ?
+                   base64_decode(encoded, encoded_len, blob) : -1;
+    
+    Stroke strokes[STROKE_BATCH_MAX];
+    int count = blob_len > 0 ?
+                stroke_codec_decode(blob, blob_len, 0, strokes, STROKE_BATCH_MAX) : -1;
+    if (count < 0) {
+        printf("[TCP] STROKE: Malformed packed strokes from player %u\n", player->player_id);
+        return;
+    }
+    
+    // Client clocks are not trusted; stamp arrival time like the JSON path
+    uint64_t now = get_current_time_ms();
+    for (int i = 0; i < count; i++) {
+        strokes[i].timestamp = now;
+    }
+    
+    accept_strokes(room, player, strokes, count);
+}
+
+void start_canvas_catchup(Player* player, Room* room) {
+    player->catchup_active = true;  // Even a blank canvas sends one chunk so the client resets
+    player->catchup_room_id = room->room_id;
+    pthread_mutex_lock(&room->stroke_lock);
+    player->catchup_epoch = room->canvas_epoch;
+    player->catchup_stroke_mark = room->stroke_count;
+    pthread_mutex_unlock(&room->stroke_lock);
+    player->catchup_next = 0;
+    player->catchup_last_sent = get_current_time_ms();
+    
+    // First chunk goes out now so it precedes any live stroke; the rest is paced.
+    // Each tile is encoded when sent, so it already holds every stroke drawn
+    // before it left and anything later reaches the player live.
+    pump_canvas_catchup(player);
+}
+
+bool pump_canvas_catchup(Player* player) {
+    if (!player->catchup_active) return false;
+    
+    Room* room = find_room_by_id(player->catchup_room_id);
+    if (!room) {
+        player->catchup_active = false;
+        return false;
+    }
+    
+    // Slow receiver: leave the rest for a later pass instead of blocking
+    if (tcp_send_queue_bytes(player->fd) > CANVAS_CATCHUP_MAX_QUEUED) {
+        return true;
+    }
+    
+    // UDP workers draw into the raster while its tiles are encoded
+    pthread_mutex_lock(&room->stroke_lock);
+    if (room->canvas_epoch != player->catchup_epoch) {
+        // Canvas was wiped (clear or new round); the player already got that event
+        pthread_mutex_unlock(&room->stroke_lock);
+        player->catchup_active = false;
+        return false;
+    }
+    
+    char chunk[BUFFER_SIZE - 64];
+    int len = snprintf(chunk, sizeof(chunk), "{\"first\":%s,\"tile_size\":%d,\"tiles_x\":%d,\"tiles\":[",
+                       player->catchup_next == 0 ? "true" : "false",
+                       CANVAS_TILE_SIZE, CANVAS_TILES_X);
     
-    // Extract just the stroke data from {"type":100,"data":{stroke_data}}
-    const char* data_start = strstr(json, "\"data\":");
-    if (data_start) {
-        data_start += 7; // Skip "data":
-        // Skip whitespace
-        while (*data_start == ' ') data_start++;
+    int tiles_added = 0;
+    int tile = canvas_next_tile(room->canvas, player->catchup_next);
+    while (tile >= 0) {
+        int rle_len = 0;
+        const uint8_t* rle = canvas_tile_rle(room->canvas, tile, &rle_len);
+        if (!rle) break;
         
-        // The data_start now points to the stroke object {...}
-        // We need to extract it and add player_id
-        // Find the closing brace for the data object
-        int brace_count = 0;
-        const char* p = data_start;
-        const char* data_end = NULL;
+        // Room for this tile plus the closing fields?
+        int needed = BASE64_ENCODED_LEN(rle_len) + 16;
+        if (len + needed + 32 > (int)sizeof(chunk) && tiles_added > 0) break;
         
-        while (*p) {
-            if (*p == '{') brace_count++;
-            else if (*p == '}') {
-                brace_count--;
-                if (brace_count == 0) {
-                    data_end = p + 1;
-                    break;
-                }
-            }
-            p++;
-        }
+        len += snprintf(chunk + len, sizeof(chunk) - len, "%s[%d,\"", tiles_added > 0 ? "," : "", tile);
+        len += base64_encode(rle, rle_len, chunk + len);
+        len += snprintf(chunk + len, sizeof(chunk) - len, "\"]");
+        tiles_added++;
         
-        if (data_end) {
-            // Extract the stroke data
-            int stroke_len = data_end - data_start;
-            char stroke_data[BUFFER_SIZE];
-            snprintf(stroke_data, sizeof(stroke_data), "%.*s", stroke_len, data_start);
-            
-            // Remove the closing } and add player_id
-            stroke_data[stroke_len - 1] = '\0';  // Remove }
-            char stroke_with_id[BUFFER_SIZE];
-            snprintf(stroke_with_id, sizeof(stroke_with_id), 
-                     "%s,\"player_id\":%u}", stroke_data, player->player_id);
-            
-            printf("[TCP] STROKE: Broadcasting data: %s\n", stroke_with_id);
-            printf("[TCP] STROKE: Room has %d players, excluding sender (player_id=%u)\n", 
-                   room->player_count, player->player_id);
-            
-            // Log each recipient
-            for (int i = 0; i < room->player_count; i++) {
-                if (room->players[i] && room->players[i] != player) {
-                    printf("[TCP] STROKE: -> Sending to player %u (%s)\n",
-                           room->players[i]->player_id, room->players[i]->username);
-                }
-            }
-            
-            // Broadcast - send_tcp_message will wrap it as {"type":100,"data":...}
-            broadcast_to_room(room, UDP_STROKE, stroke_with_id, player);
-        } else {
-            printf("[TCP] STROKE: ERROR - Could not find data end\n");
-        }
-    } else {
-        printf("[TCP] STROKE: WARNING - No data field found in JSON\n");
+        tile = canvas_next_tile(room->canvas, tile + 1);
     }
+    pthread_mutex_unlock(&room->stroke_lock);
+    
+    player->catchup_next = tile >= 0 ? tile : CANVAS_TILE_COUNT;
+    player->catchup_active = tile >= 0;
+    snprintf(chunk + len, sizeof(chunk) - len, "],\"done\":%s}",
+             player->catchup_active ? "false" : "true");
+    
+    send_tcp_message(player->fd, MSG_CANVAS_SNAPSHOT, chunk);
+    return player->catchup_active;
 }
 
 void handle_tcp_message(Player* player, const char* buffer, int len) {
@@ -328,7 +871,8 @@ void handle_tcp_message(Player* player, const char* buffer, int len) {
     
     printf("[TCP] handle_tcp_message: player=%u, type=%d, json=%s\n", player->player_id, type, json);
     
-    switch (type) {
+    // UDP message types travel over TCP too, so switch on the plain value
+    switch ((int)type) {
         case MSG_REGISTER:
             handle_register(player, json);
             break;
@@ -350,12 +894,24 @@ void handle_tcp_message(Player* player, const char* buffer, int len) {
         case MSG_DISCONNECT:
             handle_disconnect(player);
             break;
+        case MSG_ROOM_RESYNC:
+            handle_resync(player);
+            break;
+        case MSG_LEADERBOARD:
+            handle_leaderboard(player);
+            break;
         case UDP_STROKE:
             handle_stroke(player, json);
             break;
         case UDP_CLEAR_CANVAS:
             handle_clear_canvas(player);
             break;
+        case UDP_UNDO:
+            handle_undo(player);
+            break;
+        case UDP_STROKE_PACKED:
+            handle_stroke_packed(player, json);
+            break;
         default:
             printf("[TCP] Unknown message type %d from player %u\n", type, player->player_id);
             break;
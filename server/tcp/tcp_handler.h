@@ -2,10 +2,24 @@
 #define TCP_HANDLER_H
 
 #include "../protocol.h"
+#include "../utils/serial.h"
 
 void send_tcp_message(int fd, MessageType type, const char* json_data);
 void broadcast_to_room(Room* room, MessageType type, const char* json_data, Player* exclude);
 void handle_tcp_message(Player* player, const char* buffer, int len);
 void handle_disconnect(Player* player);
+int tcp_send_queue_bytes(int fd);
+void start_canvas_catchup(Player* player, Room* room);
+bool pump_canvas_catchup(Player* player);
+void tcp_set_stroke_simplification(bool enabled);
+void broadcast_strokes(Room* room, Player* drawer, const Stroke* strokes, int count,
+                       int first_stroke);
+bool pump_stroke_lag(Player* player, uint64_t now);
+void flush_stroke_path(Room* room, Player* drawer);
+void flush_stroke_batch(Room* room, Player* drawer);
+void flush_pending_strokes(Room* room, Player* drawer);
+void flush_due_strokes(Player* player, uint64_t now);
+void tcp_handler_export(SerialWriter* w);
+int tcp_handler_import(SerialReader* r);
 
 #endif // TCP_HANDLER_H
@@ -1,6 +1,11 @@
 #include "tcp_server.h"
 #include "tcp_handler.h"
+#include "websocket.h"
+#include "../game/checkpoint.h"
+#include "../udp/udp_endpoints.h"
+#include "../udp/udp_server.h"
 #include "../utils/logger.h"
+#include "../utils/timer.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,14 +15,66 @@
 #include <arpa/inet.h>
 #include <sys/select.h>
 #include <errno.h>
+#include <fcntl.h>
 
 #define MAX_CLIENTS 100
+#define CANVAS_CATCHUP_INTERVAL_MS 10  // Minimum gap between snapshot chunks
+#define STROKE_FLUSH_POLL_MS 4         // Wakeup granularity for the stroke fanout tick
 
 static int tcp_server_fd = -1;
+static int websocket_fd = -1;  // Optional listener for browsers (see websocket.h)
 static Player players[MAX_CLIENTS];
 static int player_count = 0;
+static pthread_mutex_t players_mutex = PTHREAD_MUTEX_INITIALIZER;  // Slot rewrites vs. UDP binds
 static pthread_t tcp_thread;
 static volatile bool tcp_running = false;
+static int wake_pipe[2] = {-1, -1};  // Interrupts select() on detach
+
+// Free a slot in place. Rooms and the UDP endpoint table point into
+// players[], so the remaining players must never move
+static void release_player(int i) {
+    pthread_mutex_lock(&players_mutex);
+    udp_endpoint_unbind(&players[i]);
+    websocket_set_client(players[i].fd, false);
+    memset(&players[i], 0, sizeof(Player));
+    while (player_count > 0 && players[player_count - 1].fd <= 0) {
+        player_count--;
+    }
+    pthread_mutex_unlock(&players_mutex);
+}
+
+static void accept_player(int listen_fd, bool websocket) {
+    struct sockaddr_in client_addr;
+    socklen_t client_len = sizeof(client_addr);
+    
+    int client_fd = accept(listen_fd, (struct sockaddr*)&client_addr, &client_len);
+    if (client_fd < 0) {
+        perror("accept failed");
+        return;
+    }
+    
+    // Add new player in the first free slot
+    int slot = 0;
+    while (slot < player_count && players[slot].fd > 0) slot++;
+    
+    if (slot < MAX_CLIENTS) {
+        Player* player = &players[slot];
+        pthread_mutex_lock(&players_mutex);
+        memset(player, 0, sizeof(Player));
+        player->fd = client_fd;
+        player->recv_buffer_len = 0;
+        player->websocket = websocket ? WS_STATE_HANDSHAKE : WS_STATE_NONE;
+        websocket_set_client(client_fd, websocket);
+        inet_ntop(AF_INET, &client_addr.sin_addr, player->ip, INET_ADDRSTRLEN);
+        if (slot == player_count) player_count++;
+        pthread_mutex_unlock(&players_mutex);
+        
+        printf("[%s] New connection from %s (fd=%d)\n", websocket ? "WS" : "TCP", player->ip, client_fd);
+    } else {
+        printf("[TCP] Max clients reached, rejecting connection\n");
+        close(client_fd);
+    }
+}
 
 void* tcp_server_thread(void* arg) {
     (void)arg;
@@ -28,21 +85,56 @@ void* tcp_server_thread(void* arg) {
     while (tcp_running) {
         FD_ZERO(&read_fds);
         FD_SET(tcp_server_fd, &read_fds);
+        FD_SET(wake_pipe[0], &read_fds);
         
-        int max_fd = tcp_server_fd;
+        int max_fd = tcp_server_fd > wake_pipe[0] ? tcp_server_fd : wake_pipe[0];
+        if (websocket_fd >= 0) {
+            FD_SET(websocket_fd, &read_fds);
+            if (websocket_fd > max_fd) max_fd = websocket_fd;
+        }
+        bool catchup_pending = false;
+        bool strokes_pending = false;
+        bool lag_pending = false;
         
         // Add all player sockets
         for (int i = 0; i < player_count; i++) {
             if (players[i].fd > 0) {
                 FD_SET(players[i].fd, &read_fds);
+                if (players[i].catchup_active) {
+                    catchup_pending = true;
+                }
+                if (players[i].stroke_path_pending || players[i].stroke_batch_pending) {
+                    strokes_pending = true;
+                }
+                if (players[i].stroke_lagging) {
+                    lag_pending = true;
+                }
                 if (players[i].fd > max_fd) {
                     max_fd = players[i].fd;
                 }
             }
         }
         
+        // Pace catch-up chunks and stroke fanout instead of sleeping a full second
         timeout.tv_sec = 1;
         timeout.tv_usec = 0;
+        if (strokes_pending) {
+            timeout.tv_sec = 0;
+            timeout.tv_usec = STROKE_FLUSH_POLL_MS * 1000;
+        } else if (catchup_pending) {
+            timeout.tv_sec = 0;
+            timeout.tv_usec = CANVAS_CATCHUP_INTERVAL_MS * 1000;
+        } else if (lag_pending) {
+            timeout.tv_sec = 0;
+            timeout.tv_usec = STROKE_LAG_INTERVAL_MS * 1000;
+        }
+        
+        // Parity for UDP groups the stroke fanout left open
+        int parity_ms = udp_server_expire_parity();
+        if (parity_ms >= 0 && parity_ms * 1000L < timeout.tv_sec * 1000000L + timeout.tv_usec) {
+            timeout.tv_sec = 0;
+            timeout.tv_usec = parity_ms * 1000;
+        }
         
         int activity = select(max_fd + 1, &read_fds, NULL, NULL, &timeout);
         
@@ -51,31 +143,14 @@ void* tcp_server_thread(void* arg) {
             continue;
         }
         
+        if (!tcp_running) break;
+        
         // Check for new connections
         if (FD_ISSET(tcp_server_fd, &read_fds)) {
-            struct sockaddr_in client_addr;
-            socklen_t client_len = sizeof(client_addr);
-            
-            int client_fd = accept(tcp_server_fd, (struct sockaddr*)&client_addr, &client_len);
-            if (client_fd < 0) {
-                perror("accept failed");
-                continue;
-            }
-            
-            // Add new player
-            if (player_count < MAX_CLIENTS) {
-                Player* player = &players[player_count];
-                memset(player, 0, sizeof(Player));
-                player->fd = client_fd;
-                player->recv_buffer_len = 0;
-                inet_ntop(AF_INET, &client_addr.sin_addr, player->ip, INET_ADDRSTRLEN);
-                player_count++;
-                
-                printf("[TCP] New connection from %s (fd=%d)\n", player->ip, client_fd);
-            } else {
-                printf("[TCP] Max clients reached, rejecting connection\n");
-                close(client_fd);
-            }
+            accept_player(tcp_server_fd, false);
+        }
+        if (websocket_fd >= 0 && FD_ISSET(websocket_fd, &read_fds)) {
+            accept_player(websocket_fd, true);
         }
         
         // Check for data from players
@@ -87,11 +162,7 @@ void* tcp_server_thread(void* arg) {
                     printf("[TCP] Buffer overflow for player %u, disconnecting\n", players[i].player_id);
                     handle_disconnect(&players[i]);
                     close(players[i].fd);
-                    for (int j = i; j < player_count - 1; j++) {
-                        players[j] = players[j + 1];
-                    }
-                    player_count--;
-                    i--;
+                    release_player(i);
                     continue;
                 }
                 
@@ -104,13 +175,15 @@ void* tcp_server_thread(void* arg) {
                     printf("[TCP] Client %u disconnected (fd=%d)\n", players[i].player_id, players[i].fd);
                     handle_disconnect(&players[i]);
                     close(players[i].fd);
-                    
-                    // Remove from array
-                    for (int j = i; j < player_count - 1; j++) {
-                        players[j] = players[j + 1];
+                    release_player(i);
+                } else if (players[i].websocket) {
+                    players[i].recv_buffer_len += bytes_read;
+                    if (websocket_process(&players[i]) < 0) {
+                        printf("[WS] Client %u disconnected (fd=%d)\n", players[i].player_id, players[i].fd);
+                        handle_disconnect(&players[i]);
+                        close(players[i].fd);
+                        release_player(i);
                     }
-                    player_count--;
-                    i--;
                 } else {
                     players[i].recv_buffer_len += bytes_read;
                     
@@ -149,20 +222,57 @@ void* tcp_server_thread(void* arg) {
                 }
             }
         }
+        
+        // Drawers with a paused polyline or a stroke batch whose tick is up
+        if (strokes_pending) {
+            uint64_t now = get_current_time_ms();
+            for (int i = 0; i < player_count; i++) {
+                if (players[i].fd > 0 &&
+                    (players[i].stroke_path_pending || players[i].stroke_batch_pending)) {
+                    flush_due_strokes(&players[i], now);
+                }
+            }
+        }
+        
+        // At most one snapshot chunk per player per interval keeps replay
+        // from starving the rest of the loop
+        if (catchup_pending) {
+            uint64_t now = get_current_time_ms();
+            for (int i = 0; i < player_count; i++) {
+                if (players[i].fd > 0 && players[i].catchup_active &&
+                    now - players[i].catchup_last_sent >= CANVAS_CATCHUP_INTERVAL_MS) {
+                    players[i].catchup_last_sent = now;
+                    pump_canvas_catchup(&players[i]);
+                }
+            }
+        }
+        
+        // Slow receivers get what they missed once their backlog drains
+        if (lag_pending) {
+            uint64_t now = get_current_time_ms();
+            for (int i = 0; i < player_count; i++) {
+                if (players[i].fd > 0 && players[i].stroke_lagging) {
+                    pump_stroke_lag(&players[i], now);
+                }
+            }
+        }
+        
+        // Snapshot between messages, where room state is consistent
+        checkpoint_capture_if_due(get_current_time_ms());
     }
     
     return NULL;
 }
 
 int tcp_server_start(int port) {
-    tcp_server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (tcp_server_fd < 0) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
         perror("Failed to create TCP socket");
         return -1;
     }
     
     int opt = 1;
-    setsockopt(tcp_server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
     
     struct sockaddr_in addr;
     memset(&addr, 0, sizeof(addr));
@@ -170,34 +280,106 @@ int tcp_server_start(int port) {
     addr.sin_addr.s_addr = INADDR_ANY;
     addr.sin_port = htons(port);
     
-    if (bind(tcp_server_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
         perror("Failed to bind TCP socket");
-        close(tcp_server_fd);
+        close(fd);
         return -1;
     }
     
-    if (listen(tcp_server_fd, 10) < 0) {
+    if (listen(fd, 10) < 0) {
         perror("Failed to listen on TCP socket");
-        close(tcp_server_fd);
+        close(fd);
         return -1;
     }
     
     memset(players, 0, sizeof(players));
     player_count = 0;
+    udp_endpoints_init();
+    
+    if (tcp_server_adopt(fd) < 0) {
+        close(fd);
+        return -1;
+    }
+    
+    printf("[TCP] Server started on port %d\n", port);
+    return 0;
+}
+
+// Also accept browsers speaking WebSocket on port. Call before
+// tcp_server_start(); after a takeover the listener comes with the handoff.
+int tcp_server_listen_websocket(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("Failed to create WebSocket socket");
+        return -1;
+    }
+    
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(port);
+    
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("Failed to bind WebSocket socket");
+        close(fd);
+        return -1;
+    }
+    
+    if (listen(fd, 10) < 0) {
+        perror("Failed to listen on WebSocket socket");
+        close(fd);
+        return -1;
+    }
+    
+    websocket_fd = fd;
+    printf("[WS] Listening on port %d\n", port);
+    return 0;
+}
+
+// Serve an already-listening socket and whatever players[] holds
+int tcp_server_adopt(int listen_fd) {
+    if (wake_pipe[0] < 0) {
+        if (pipe(wake_pipe) < 0) {
+            perror("Failed to create TCP wake pipe");
+            return -1;
+        }
+        fcntl(wake_pipe[0], F_SETFL, O_NONBLOCK);
+    }
+    
+    tcp_server_fd = listen_fd;
     tcp_running = true;
     
     if (pthread_create(&tcp_thread, NULL, tcp_server_thread, NULL) != 0) {
         perror("Failed to create TCP server thread");
-        close(tcp_server_fd);
+        tcp_running = false;
+        tcp_server_fd = -1;
         return -1;
     }
-    
-    printf("[TCP] Server started on port %d\n", port);
     return 0;
 }
 
-void tcp_server_stop() {
+// Stop the reactor but leave every socket open; returns the listener
+int tcp_server_detach() {
+    if (!tcp_running) return tcp_server_fd;
+    
     tcp_running = false;
+    if (write(wake_pipe[1], "x", 1) < 0) {
+        perror("TCP wake pipe");
+    }
+    pthread_join(tcp_thread, NULL);
+    
+    char drain[16];
+    while (read(wake_pipe[0], drain, sizeof(drain)) > 0) {}
+    
+    return tcp_server_fd;
+}
+
+void tcp_server_stop() {
+    tcp_server_detach();
     
     // Close all client connections
     for (int i = 0; i < player_count; i++) {
@@ -205,16 +387,190 @@ void tcp_server_stop() {
             close(players[i].fd);
         }
     }
+    player_count = 0;
     
     if (tcp_server_fd >= 0) {
         close(tcp_server_fd);
         tcp_server_fd = -1;
     }
+    if (websocket_fd >= 0) {
+        close(websocket_fd);
+        websocket_fd = -1;
+    }
     
-    pthread_join(tcp_thread, NULL);
     printf("[TCP] Server stopped\n");
 }
 
+int tcp_server_player_index(const Player* player) {
+    if (!player || player < players || player >= players + player_count) return -1;
+    return (int)(player - players);
+}
+
+Player* tcp_server_player_at(int index) {
+    if (index < 0 || index >= player_count || players[index].fd <= 0) return NULL;
+    return &players[index];
+}
+
+// Give a connected player its identity. Done under the slot lock because
+// UDP workers match session tokens while binding.
+void tcp_server_set_session(Player* player, uint32_t player_id, const char* session_token) {
+    pthread_mutex_lock(&players_mutex);
+    player->player_id = player_id;
+    snprintf(player->session_token, sizeof(player->session_token), "%s", session_token);
+    pthread_mutex_unlock(&players_mutex);
+}
+
+// Bind from to the connected player holding this session token (UDP bind
+// handshake); returns its player id, or 0 when there is no such player.
+// The slot lock is held throughout so the slot can't be released or
+// reused between the match and the bind.
+uint32_t tcp_server_bind_udp(const char* session_token, const struct sockaddr_in* from) {
+    if (session_token[0] == '\0') return 0;
+    
+    uint32_t player_id = 0;
+    pthread_mutex_lock(&players_mutex);
+    for (int i = 0; i < player_count; i++) {
+        if (players[i].fd > 0 && strcmp(players[i].session_token, session_token) == 0) {
+            if (udp_endpoint_bind(&players[i], from) == 0) player_id = players[i].player_id;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&players_mutex);
+    return player_id;
+}
+
+// Player slots in order, free ones included so indices survive the
+// handoff; each socket, and the WebSocket listener, is appended to fds
+int tcp_server_export(SerialWriter* w, int* fds, int* nfds, int max_fds) {
+    if (*nfds + player_count + 1 > max_fds) return -1;
+    
+    serial_put_i32(w, websocket_fd >= 0 ? *nfds : -1);
+    if (websocket_fd >= 0) fds[(*nfds)++] = websocket_fd;
+    
+    serial_put_u32(w, (uint32_t)player_count);
+    for (int i = 0; i < player_count; i++) {
+        const Player* p = &players[i];
+        
+        serial_put_u8(w, p->fd > 0);
+        if (p->fd <= 0) continue;
+        
+        serial_put_i32(w, *nfds);
+        fds[(*nfds)++] = p->fd;
+        
+        serial_put_str(w, p->username);
+        serial_put_str(w, p->ip);
+        serial_put_u32(w, p->player_id);
+        serial_put_i32(w, p->score);
+        serial_put_u32(w, p->state);
+        serial_put_u64(w, p->rtt);
+        serial_put_str(w, p->session_token);
+        serial_put_u64(w, p->last_seen);
+        serial_put_u8(w, p->is_drawing);
+        serial_put_u8(w, p->has_guessed);
+        serial_put_u8(w, p->has_drawn);
+        
+        // Half-received messages carry over with the socket
+        serial_put_u32(w, (uint32_t)p->recv_buffer_len);
+        serial_put_bytes(w, p->recv_buffer, p->recv_buffer_len);
+        serial_put_u8(w, p->websocket);
+        
+        serial_put_u8(w, p->catchup_active);
+        serial_put_u32(w, p->catchup_room_id);
+        serial_put_u32(w, p->catchup_epoch);
+        serial_put_i32(w, p->catchup_next);
+        serial_put_i32(w, p->catchup_stroke_mark);
+        serial_put_u64(w, p->catchup_last_sent);
+        serial_put_u8(w, p->stroke_path_pending);
+        serial_put_u8(w, p->stroke_batch_pending);
+        serial_put_u8(w, p->stroke_lagging);
+        serial_put_u32(w, p->stroke_lag_room_id);
+        serial_put_u32(w, p->stroke_lag_epoch);
+        serial_put_i32(w, p->stroke_lag_next);
+        serial_put_u64(w, p->stroke_lag_last_sent);
+        
+        // The UDP socket moves too, so bound endpoints stay valid
+        serial_put_u8(w, p->udp_bound);
+        serial_put_u32(w, p->udp_addr.sin_addr.s_addr);
+        serial_put_u32(w, p->udp_addr.sin_port);
+        // Ack state, so acks after the handoff line up with the resend window
+        serial_put_u32(w, p->udp_room_id);
+        serial_put_u32(w, p->udp_base_seq);
+        serial_put_u32(w, p->udp_acked);
+        serial_put_float(w, p->udp_loss);
+    }
+    return 0;
+}
+
+int tcp_server_import(SerialReader* r, const int* fds, int nfds) {
+    int websocket_index = serial_get_i32(r);
+    if (websocket_index >= nfds) return -1;
+    websocket_fd = websocket_index >= 0 ? fds[websocket_index] : -1;
+    
+    uint32_t count = serial_get_u32(r);
+    if (r->failed || count > MAX_CLIENTS) return -1;
+    
+    memset(players, 0, sizeof(players));
+    player_count = 0;
+    udp_endpoints_init();
+    
+    for (uint32_t i = 0; i < count; i++) {
+        Player* p = &players[i];
+        player_count++;
+        if (!serial_get_u8(r)) continue;
+        
+        int fd_index = serial_get_i32(r);
+        if (fd_index < 0 || fd_index >= nfds) return -1;
+        p->fd = fds[fd_index];
+        
+        serial_get_str(r, p->username, sizeof(p->username));
+        serial_get_str(r, p->ip, sizeof(p->ip));
+        p->player_id = serial_get_u32(r);
+        p->score = serial_get_i32(r);
+        p->state = (PlayerState)serial_get_u32(r);
+        p->rtt = serial_get_u64(r);
+        serial_get_str(r, p->session_token, sizeof(p->session_token));
+        p->last_seen = serial_get_u64(r);
+        p->is_drawing = serial_get_u8(r);
+        p->has_guessed = serial_get_u8(r);
+        p->has_drawn = serial_get_u8(r);
+        
+        uint32_t buffered = serial_get_u32(r);
+        if (buffered > BUFFER_SIZE) return -1;
+        serial_get_bytes(r, p->recv_buffer, buffered);
+        p->recv_buffer_len = (int)buffered;
+        p->websocket = serial_get_u8(r);
+        websocket_set_client(p->fd, p->websocket != WS_STATE_NONE);
+        
+        p->catchup_active = serial_get_u8(r);
+        p->catchup_room_id = serial_get_u32(r);
+        p->catchup_epoch = serial_get_u32(r);
+        p->catchup_next = serial_get_i32(r);
+        p->catchup_stroke_mark = serial_get_i32(r);
+        p->catchup_last_sent = serial_get_u64(r);
+        p->stroke_path_pending = serial_get_u8(r);
+        p->stroke_batch_pending = serial_get_u8(r);
+        p->stroke_lagging = serial_get_u8(r);
+        p->stroke_lag_room_id = serial_get_u32(r);
+        p->stroke_lag_epoch = serial_get_u32(r);
+        p->stroke_lag_next = serial_get_i32(r);
+        p->stroke_lag_last_sent = serial_get_u64(r);
+        
+        bool udp_bound = serial_get_u8(r);
+        struct sockaddr_in udp_addr;
+        memset(&udp_addr, 0, sizeof(udp_addr));
+        udp_addr.sin_family = AF_INET;
+        udp_addr.sin_addr.s_addr = serial_get_u32(r);
+        udp_addr.sin_port = (in_port_t)serial_get_u32(r);
+        p->udp_room_id = serial_get_u32(r);
+        p->udp_base_seq = serial_get_u32(r);
+        p->udp_acked = serial_get_u32(r);
+        p->udp_loss = serial_get_float(r);
+        if (r->failed) return -1;
+        if (udp_bound) udp_endpoint_bind(p, &udp_addr);
+    }
+    return r->failed ? -1 : 0;
+}
+
 void tcp_send_timer_updates(Room* room) {
     char timer_msg[128];
     snprintf(timer_msg, sizeof(timer_msg), 
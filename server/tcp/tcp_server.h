@@ -2,11 +2,21 @@
 #define TCP_SERVER_H
 
 #include "../protocol.h"
+#include "../utils/serial.h"
 #include <pthread.h>
 #include <stdbool.h>
 
+int tcp_server_listen_websocket(int port);
 int tcp_server_start(int port);
 void tcp_server_stop();
+int tcp_server_adopt(int listen_fd);
+int tcp_server_detach();
+int tcp_server_player_index(const Player* player);
+Player* tcp_server_player_at(int index);
+void tcp_server_set_session(Player* player, uint32_t player_id, const char* session_token);
+uint32_t tcp_server_bind_udp(const char* session_token, const struct sockaddr_in* from);
+int tcp_server_export(SerialWriter* w, int* fds, int* nfds, int max_fds);
+int tcp_server_import(SerialReader* r, const int* fds, int nfds);
 void tcp_send_timer_updates(Room* room);
 
 #endif // TCP_SERVER_H
@@ -0,0 +1,220 @@
+#include "websocket.h"
+#include "tcp_handler.h"
+#include "../http/http_parser.h"
+#include "../utils/base64.h"
+#include "../utils/sha1.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <arpa/inet.h>
+
+#define WS_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+#define WS_OP_CONTINUATION 0x0
+#define WS_OP_TEXT 0x1
+#define WS_OP_BINARY 0x2
+#define WS_OP_CLOSE 0x8
+#define WS_OP_PING 0x9
+#define WS_OP_PONG 0xA
+
+#define WS_CLOSE_PROTOCOL_ERROR 1002
+#define WS_CLOSE_UNSUPPORTED 1003
+#define WS_CLOSE_TOO_BIG 1009
+
+// send_tcp_message() only has the socket, so WebSocket clients are marked
+// by fd. The reactor is select()-based, so every fd is below FD_SETSIZE.
+static bool websocket_fds[FD_SETSIZE];
+
+void websocket_set_client(int fd, bool websocket) {
+    if (fd >= 0 && fd < FD_SETSIZE) websocket_fds[fd] = websocket;
+}
+
+bool websocket_is_client(int fd) {
+    return fd >= 0 && fd < FD_SETSIZE && websocket_fds[fd];
+}
+
+// Frame header plus payload, server to client (never masked); returns the
+// frame length, or -1 if it doesn't fit
+static int encode_frame(int opcode, const char* payload, int payload_len, char* buffer, int buffer_size) {
+    int header_len = payload_len < 126 ? 2 : payload_len < 65536 ? 4 : 10;
+    if (header_len + payload_len > buffer_size) return -1;
+
+    unsigned char* h = (unsigned char*)buffer;
+    h[0] = 0x80 | opcode;  // FIN
+    if (header_len == 2) {
+        h[1] = (unsigned char)payload_len;
+    } else if (header_len == 4) {
+        h[1] = 126;
+        h[2] = (unsigned char)(payload_len >> 8);
+        h[3] = (unsigned char)payload_len;
+    } else {
+        h[1] = 127;
+        for (int i = 0; i < 8; i++) {
+            h[2 + i] = (unsigned char)((uint64_t)payload_len >> (56 - 8 * i));
+        }
+    }
+    memmove(buffer + header_len, payload, payload_len);
+    return header_len + payload_len;
+}
+
+// A text frame holding one JSON message
+int websocket_frame(const char* payload, int payload_len, char* buffer, int buffer_size) {
+    return encode_frame(WS_OP_TEXT, payload, payload_len, buffer, buffer_size);
+}
+
+static void send_control(int fd, int opcode, const char* payload, int payload_len) {
+    char frame[2 + 125];
+    int len = encode_frame(opcode, payload, payload_len, frame, sizeof(frame));
+    if (len > 0) send(fd, frame, len, MSG_NOSIGNAL);
+}
+
+static void send_close(int fd, int code) {
+    char payload[2] = { (char)(code >> 8), (char)code };
+    send_control(fd, WS_OP_CLOSE, payload, sizeof(payload));
+}
+
+static int reject_handshake(Player* player, const char* status) {
+    char response[128];
+    int len = snprintf(response, sizeof(response),
+                       "HTTP/1.1 %s\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", status);
+    send(player->fd, response, len, MSG_NOSIGNAL);
+    printf("[WS] Rejected handshake from %s (%s)\n", player->ip, status);
+    return -1;
+}
+
+// Answer the upgrade request at the front of the receive buffer; returns
+// the bytes it took, 0 while it is incomplete, -1 to drop the connection
+static int handshake(Player* player) {
+    HttpRequest request;
+    int consumed = http_parse_request(player->recv_buffer, player->recv_buffer_len, &request);
+    if (consumed == 0) return 0;
+    if (consumed < 0) return reject_handshake(player, "400 Bad Request");
+
+    char key[64];
+    char version[8];
+    if (strcmp(request.method, "GET") != 0 ||
+        !http_header_has_token(&request, "Upgrade", "websocket") ||
+        !http_header_has_token(&request, "Connection", "Upgrade") ||
+        !http_header_value(&request, "Sec-WebSocket-Key", key, sizeof(key)) ||
+        strlen(key) != 24) {
+        return reject_handshake(player, "400 Bad Request");
+    }
+    if (!http_header_value(&request, "Sec-WebSocket-Version", version, sizeof(version)) ||
+        strcmp(version, "13") != 0) {
+        return reject_handshake(player, "426 Upgrade Required\r\nSec-WebSocket-Version: 13");
+    }
+
+    char concat[64 + sizeof(WS_GUID)];
+    int concat_len = snprintf(concat, sizeof(concat), "%s%s", key, WS_GUID);
+    uint8_t digest[SHA1_DIGEST_SIZE];
+    sha1_compute(concat, concat_len, digest);
+    char accept[BASE64_ENCODED_LEN(SHA1_DIGEST_SIZE) + 1];
+    base64_encode(digest, sizeof(digest), accept);
+
+    char response[256];
+    int len = snprintf(response, sizeof(response),
+                       "HTTP/1.1 101 Switching Protocols\r\n"
+                       "Upgrade: websocket\r\n"
+                       "Connection: Upgrade\r\n"
+                       "Sec-WebSocket-Accept: %s\r\n"
+                       "\r\n", accept);
+    if (send(player->fd, response, len, MSG_NOSIGNAL) != len) return -1;
+
+    player->websocket = WS_STATE_OPEN;
+    printf("[WS] Upgraded connection from %s (fd=%d)\n", player->ip, player->fd);
+    return consumed;
+}
+
+// Handle every complete frame in the receive buffer. Data frames are
+// unmasked in place and rewritten as length-prefixed messages for
+// handle_tcp_message(). Returns -1 when the connection should be dropped.
+int websocket_process(Player* player) {
+    int processed = 0;
+
+    if (player->websocket == WS_STATE_HANDSHAKE) {
+        processed = handshake(player);
+        if (processed <= 0) return processed;
+    }
+
+    while (player->recv_buffer_len - processed >= 2) {
+        unsigned char* frame = (unsigned char*)player->recv_buffer + processed;
+        int available = player->recv_buffer_len - processed;
+
+        bool fin = frame[0] & 0x80;
+        int opcode = frame[0] & 0x0F;
+        bool masked = frame[1] & 0x80;
+        uint64_t payload_len = frame[1] & 0x7F;
+        int header_len = 2;
+
+        // Clients must mask, and no extension that would set RSV bits was agreed
+        if (!masked || (frame[0] & 0x70)) {
+            send_close(player->fd, WS_CLOSE_PROTOCOL_ERROR);
+            return -1;
+        }
+
+        if (payload_len == 126) {
+            if (available < 4) break;
+            payload_len = (uint64_t)frame[2] << 8 | frame[3];
+            header_len = 4;
+        } else if (payload_len == 127) {
+            if (available < 10) break;
+            payload_len = 0;
+            for (int i = 0; i < 8; i++) payload_len = payload_len << 8 | frame[2 + i];
+            header_len = 10;
+        }
+        header_len += 4;  // Masking key
+
+        // A message must fit the receive buffer, like a TCP one
+        if (payload_len > (uint64_t)(BUFFER_SIZE - header_len)) {
+            printf("[WS] Frame of %llu bytes from player %u is too large\n",
+                   (unsigned long long)payload_len, player->player_id);
+            send_close(player->fd, WS_CLOSE_TOO_BIG);
+            return -1;
+        }
+        if (available < header_len + (int)payload_len) break;
+
+        const unsigned char* mask = frame + header_len - 4;
+        char* payload = (char*)frame + header_len;
+        for (uint64_t i = 0; i < payload_len; i++) {
+            payload[i] ^= mask[i & 3];
+        }
+        processed += header_len + (int)payload_len;
+
+        switch (opcode) {
+            case WS_OP_TEXT:
+            case WS_OP_BINARY: {
+                if (!fin) {
+                    send_close(player->fd, WS_CLOSE_UNSUPPORTED);
+                    return -1;
+                }
+                // The header is at least 6 bytes, so the length prefix fits in front
+                uint32_t len_network = htonl((uint32_t)payload_len);
+                memcpy(payload - 4, &len_network, 4);
+                handle_tcp_message(player, payload - 4, 4 + (int)payload_len);
+                break;
+            }
+            case WS_OP_PING:
+                if (payload_len > 125) return -1;
+                send_control(player->fd, WS_OP_PONG, payload, (int)payload_len);
+                break;
+            case WS_OP_PONG:
+                break;
+            case WS_OP_CLOSE:
+                // Echo the status code, then drop the connection
+                send_control(player->fd, WS_OP_CLOSE, payload, payload_len >= 2 ? 2 : 0);
+                return -1;
+            case WS_OP_CONTINUATION:
+            default:
+                send_close(player->fd, WS_CLOSE_PROTOCOL_ERROR);
+                return -1;
+        }
+    }
+
+    int remaining = player->recv_buffer_len - processed;
+    if (processed > 0 && remaining > 0) {
+        memmove(player->recv_buffer, player->recv_buffer + processed, remaining);
+    }
+    player->recv_buffer_len = remaining;
+    return 0;
+}
@@ -0,0 +1,24 @@
+#ifndef WEBSOCKET_H
+#define WEBSOCKET_H
+
+#include "../protocol.h"
+
+// Browsers can connect straight to the server over WebSocket (RFC 6455)
+// instead of through client_proxy. Such players live in the TCP reactor
+// like any other: each text frame carries one JSON message, exactly what a
+// length-prefixed TCP message carries, and goes to the same handlers.
+// Fragmented messages are not accepted; browsers send each message whole.
+
+#define WS_STATE_NONE 0        // Plain length-prefixed TCP client
+#define WS_STATE_HANDSHAKE 1   // Waiting for the HTTP upgrade request
+#define WS_STATE_OPEN 2
+
+#define WS_MAX_FRAME_HEADER 10  // Server frames are unmasked
+
+void websocket_set_client(int fd, bool websocket);
+bool websocket_is_client(int fd);
+
+int websocket_process(Player* player);
+int websocket_frame(const char* payload, int payload_len, char* buffer, int buffer_size);
+
+#endif // WEBSOCKET_H
@@ -1,72 +1,214 @@
 #include "udp_broadcast.h"
+#include "udp_endpoints.h"
+#include "udp_reliability.h"
+#include "udp_fec.h"
 #include "../game/matchmaking.h"
 #include "../game/game_logic.h"
-#include "../utils/logger.h"
-#include "../utils/endian_compat.h"
+#include "../game/stroke_codec.h"
+#include <stdio.h>
 #include <string.h>
-#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/udp.h>
 
-int serialize_udp_stroke(const Stroke* stroke, uint32_t room_id, char* buffer, int buffer_size) {
-    if (buffer_size < sizeof(UDPMessage)) return -1;
-    
-    UDPMessage* msg = (UDPMessage*)buffer;
-    msg->type = UDP_STROKE;
-    msg->room_id = htonl(room_id);
-    msg->data.stroke = *stroke;
+// UDP_SEGMENT arrived in Linux 4.18; older kernels reject the option
+bool udp_gso_supported(int fd) {
+#ifdef UDP_SEGMENT
+    int segment_size = 0;
+    socklen_t len = sizeof(segment_size);
+    return getsockopt(fd, SOL_UDP, UDP_SEGMENT, &segment_size, &len) == 0;
+#else
+    (void)fd;
+    return false;
+#endif
+}
+
+void udp_batch_init(UdpSendBatch* batch, int fd) {
+    batch->fd = fd;
+    batch->gso = udp_gso_supported(fd);
+    batch->count = 0;
+    batch->pool_used = 0;
+}
+
+// Copy a payload into the batch, flushing first if it or its recipients
+// would not fit; queue it with udp_batch_queue() at most recipients times
+const void* udp_batch_store(UdpSendBatch* batch, const void* data, size_t len, int recipients) {
+    if (len > sizeof(batch->pool) || recipients > UDP_SEND_BATCH) return NULL;
     
-    // Convert to network byte order
-    msg->data.stroke.stroke_id = htonl(stroke->stroke_id);
-    msg->data.stroke.color = htonl(stroke->color);
-    msg->data.stroke.timestamp = htobe64(stroke->timestamp);
+    if (batch->pool_used + len > sizeof(batch->pool) ||
+        batch->count + recipients > UDP_SEND_BATCH) {
+        udp_batch_flush(batch);
+    }
     
-    return sizeof(UDPMessage);
+    char* payload = batch->pool + batch->pool_used;
+    memcpy(payload, data, len);
+    batch->pool_used += len;
+    return payload;
 }
 
-int deserialize_udp_stroke(const char* buffer, int len, Stroke* stroke, uint32_t* room_id) {
-    if (len < sizeof(UDPMessage)) return -1;
+void udp_batch_queue(UdpSendBatch* batch, const void* payload, size_t len,
+                     const struct sockaddr_in* addr) {
+    if (batch->count == UDP_SEND_BATCH) return;  // udp_batch_store() reserved room
     
-    UDPMessage* msg = (UDPMessage*)buffer;
+    int i = batch->count++;
+    batch->addrs[i] = *addr;
+    batch->iovs[i].iov_base = (void*)payload;
+    batch->iovs[i].iov_len = len;
+}
+
+static bool same_endpoint(const struct sockaddr_in* a, const struct sockaddr_in* b) {
+    return a->sin_addr.s_addr == b->sin_addr.s_addr && a->sin_port == b->sin_port;
+}
+
+// Group the queue into messages. Datagrams to one destination keep their
+// order; a run ends at the first one longer than the run's segment size,
+// since only the last segment may be shorter. Returns the message count.
+static int build_messages(UdpSendBatch* batch) {
+    bool taken[UDP_SEND_BATCH] = { false };
+    int max_segments = batch->gso ? UDP_GSO_MAX_SEGMENTS : 1;
+    int msg_count = 0;
+    int iov_used = 0;
     
-    if (msg->type != UDP_STROKE) return -1;
+    for (int i = 0; i < batch->count; i++) {
+        if (taken[i]) continue;
+        
+        struct iovec* run = &batch->send_iovs[iov_used];
+        size_t segment_size = batch->iovs[i].iov_len;
+        size_t total = segment_size;
+        int segments = 1;
+        run[0] = batch->iovs[i];
+        taken[i] = true;
+        
+        for (int j = i + 1; j < batch->count && segments < max_segments; j++) {
+            if (taken[j] || !same_endpoint(&batch->addrs[j], &batch->addrs[i])) continue;
+            
+            size_t len = batch->iovs[j].iov_len;
+            if (len > segment_size || total + len > UDP_GSO_MAX_BYTES) break;
+            run[segments++] = batch->iovs[j];
+            taken[j] = true;
+            total += len;
+            if (len < segment_size) break;
+        }
+        iov_used += segments;
+        
+        struct msghdr* hdr = &batch->msgs[msg_count].msg_hdr;
+        memset(hdr, 0, sizeof(*hdr));
+        hdr->msg_name = &batch->addrs[i];
+        hdr->msg_namelen = sizeof(batch->addrs[i]);
+        hdr->msg_iov = run;
+        hdr->msg_iovlen = segments;
+        
+#ifdef UDP_SEGMENT
+        if (segments > 1) {
+            hdr->msg_control = batch->control[msg_count].buf;
+            hdr->msg_controllen = sizeof(batch->control[msg_count].buf);
+            struct cmsghdr* cmsg = CMSG_FIRSTHDR(hdr);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            uint16_t gso_size = (uint16_t)segment_size;
+            memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(gso_size));
+        }
+#endif
+        batch->segments[msg_count++] = segments;
+    }
     
-    *room_id = ntohl(msg->room_id);
-    *stroke = msg->data.stroke;
+    return msg_count;
+}
+
+// A segmented send the kernel or device refused: send the pieces one by
+// one, and stop segmenting on this socket
+static void send_segments_separately(UdpSendBatch* batch, const struct msghdr* hdr) {
+    if (batch->gso) {
+        perror("[UDP] Segmentation offload failed, falling back to single sends");
+        batch->gso = false;
+    }
+    for (size_t k = 0; k < hdr->msg_iovlen; k++) {
+        sendto(batch->fd, hdr->msg_iov[k].iov_base, hdr->msg_iov[k].iov_len, 0,
+               hdr->msg_name, hdr->msg_namelen);
+    }
+}
+
+void udp_batch_flush(UdpSendBatch* batch) {
+    int msg_count = build_messages(batch);
     
-    // Convert from network byte order
-    stroke->stroke_id = ntohl(stroke->stroke_id);
-    stroke->color = ntohl(stroke->color);
-    stroke->timestamp = be64toh(stroke->timestamp);
+    int sent = 0;
+    while (sent < msg_count) {
+        int n = sendmmsg(batch->fd, batch->msgs + sent, msg_count - sent, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (batch->segments[sent] > 1 &&
+                (errno == EIO || errno == EINVAL || errno == EOPNOTSUPP || errno == ENOPROTOOPT)) {
+                send_segments_separately(batch, &batch->msgs[sent].msg_hdr);
+                sent++;
+                continue;
+            }
+            // Unreachable peers and full buffers cost only their own message
+            perror("UDP sendmmsg failed");
+            sent++;
+            continue;
+        }
+        sent += n;
+    }
     
-    return 0;
+    batch->count = 0;
+    batch->pool_used = 0;
 }
 
-void broadcast_stroke_to_room(int udp_fd, Room* room, const Stroke* stroke, 
-                               struct sockaddr_in* exclude_addr) {
-    char buffer[BUFFER_SIZE];
-    int len = serialize_udp_stroke(stroke, room->room_id, buffer, sizeof(buffer));
+// One UDP_STROKE datagram; -1 if the strokes don't fit in one
+int udp_encode_strokes(const Room* room, uint32_t seq, const Stroke* strokes, int count,
+                       uint8_t* out, size_t out_size) {
+    // Leave room for the parity header, so a parity datagram is never
+    // larger than the largest datagram it covers
+    uint8_t payload[UDP_MAX_PAYLOAD - UDP_FEC_HEADER_SIZE];
+    int payload_len = stroke_codec_encode(strokes, count, room->round_start_time,
+                                          payload, sizeof(payload));
+    if (payload_len < 0) return -1;
     
-    if (len < 0) return;
-    
-    // Send to all players in room
-    for (int i = 0; i < room->player_count; i++) {
-        if (room->players[i] && room->players[i]->fd > 0) {
-            // Get player's UDP address (we'll use TCP fd as reference)
-            // In real implementation, we'd track UDP addresses separately
-            struct sockaddr_in player_addr;
-            memset(&player_addr, 0, sizeof(player_addr));
-            player_addr.sin_family = AF_INET;
-            inet_pton(AF_INET, room->players[i]->ip, &player_addr.sin_addr);
-            player_addr.sin_port = htons(UDP_PORT + 1);  // Client UDP port
+    UdpHeader header = { UDP_STROKE, room->room_id, seq, 0, 0 };
+    return udp_wire_encode(&header, payload, payload_len, out, out_size);
+}
+
+// first_stroke is where strokes sit in room->strokes (-1 if they weren't
+// stored), which is where a retransmit will read them back from. Takes
+// room->stroke_lock; returns whether the room has a parity group open.
+bool broadcast_strokes_to_room(UdpSendBatch* batch, Room* room, const Stroke* strokes,
+                               int count, int first_stroke, const Player* exclude) {
+    pthread_mutex_lock(&room->stroke_lock);
+    int done = 0;
+    while (done < count) {
+        // Re-encoding against the round start can come out a little larger
+        // than what the drawer sent; split rather than exceed the MTU
+        uint8_t datagram[UDP_MAX_DATAGRAM];
+        uint32_t seq = room->udp_seq + 1;
+        int n = count - done;
+        int len;
+        while ((len = udp_encode_strokes(room, seq, strokes + done, n,
+                                         datagram, sizeof(datagram))) < 0 && n > 1) {
+            n = (n + 1) / 2;
+        }
+        if (len < 0) break;
+        
+        udp_reliable_record(room, strokes + done, n, first_stroke >= 0 ? first_stroke + done : -1,
+                            exclude);
+        done += n;
+        
+        const void* payload = udp_batch_store(batch, datagram, len, room->player_count);
+        
+        // Queue for every player in the room that has bound a UDP endpoint
+        for (int i = 0; payload && i < room->player_count; i++) {
+            Player* player = room->players[i];
+            if (!player || player->fd <= 0 || player == exclude) continue;
             
-            // Skip sender
-            if (exclude_addr && 
-                player_addr.sin_addr.s_addr == exclude_addr->sin_addr.s_addr &&
-                player_addr.sin_port == exclude_addr->sin_port) {
-                continue;
-            }
+            struct sockaddr_in player_addr;
+            if (!udp_endpoint_get(player, &player_addr)) continue;
             
-            sendto(udp_fd, buffer, len, 0, 
-                   (struct sockaddr*)&player_addr, sizeof(player_addr));
+            udp_reliable_track(room, player, seq);
+            udp_batch_queue(batch, payload, len, &player_addr);
         }
+        
+        udp_fec_add(batch, room, seq, datagram + UDP_HEADER_SIZE, len - UDP_HEADER_SIZE, exclude);
     }
+    bool parity_open = room->fec.count > 0;
+    pthread_mutex_unlock(&room->stroke_lock);
+    return parity_open;
 }
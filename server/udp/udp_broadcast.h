@@ -2,12 +2,50 @@
 #define UDP_BROADCAST_H
 
 #include "../protocol.h"
+#include "udp_wire.h"
 #include <sys/socket.h>
 #include <netinet/in.h>
 
-int serialize_udp_stroke(const Stroke* stroke, uint32_t room_id, char* buffer, int buffer_size);
-int deserialize_udp_stroke(const char* buffer, int len, Stroke* stroke, uint32_t* room_id);
-void broadcast_stroke_to_room(int udp_fd, Room* room, const Stroke* stroke, 
-                               struct sockaddr_in* exclude_addr);
+#define UDP_SEND_BATCH 256                    // Datagrams per sendmmsg()
+#define UDP_SEND_POOL (64 * UDP_MAX_DATAGRAM)  // Distinct payloads per sendmmsg()
+#define UDP_GSO_MAX_SEGMENTS 64                // Kernel limit on segments per send
+#define UDP_GSO_MAX_BYTES 65000                // Segments plus headers must fit one IP datagram
+
+// Outgoing datagrams collected over one pass of the UDP loop and sent with
+// a single sendmmsg(). Payloads are copied into the pool once and shared by
+// every recipient's iovec. Where the kernel has UDP_SEGMENT, consecutive
+// equal-sized datagrams for one destination are handed over as a single
+// message and split by the kernel (or the NIC).
+typedef struct {
+    int fd;
+    bool gso;
+    int count;
+    size_t pool_used;
+    struct iovec iovs[UDP_SEND_BATCH];
+    struct sockaddr_in addrs[UDP_SEND_BATCH];
+    
+    // Built by udp_batch_flush(): one message per destination run
+    struct mmsghdr msgs[UDP_SEND_BATCH];
+    struct iovec send_iovs[UDP_SEND_BATCH];
+    int segments[UDP_SEND_BATCH];
+    union {
+        char buf[CMSG_SPACE(sizeof(uint16_t))];
+        struct cmsghdr align;
+    } control[UDP_SEND_BATCH];
+    
+    char pool[UDP_SEND_POOL];
+} UdpSendBatch;
+
+bool udp_gso_supported(int fd);
+void udp_batch_init(UdpSendBatch* batch, int fd);
+const void* udp_batch_store(UdpSendBatch* batch, const void* data, size_t len, int recipients);
+void udp_batch_queue(UdpSendBatch* batch, const void* payload, size_t len,
+                     const struct sockaddr_in* addr);
+void udp_batch_flush(UdpSendBatch* batch);
+
+int udp_encode_strokes(const Room* room, uint32_t seq, const Stroke* strokes, int count,
+                       uint8_t* out, size_t out_size);
+bool broadcast_strokes_to_room(UdpSendBatch* batch, Room* room, const Stroke* strokes,
+                               int count, int first_stroke, const Player* exclude);
 
 #endif // UDP_BROADCAST_H
@@ -0,0 +1,184 @@
+#include "udp_endpoints.h"
+#include "../tcp/tcp_server.h"
+#include "../game/matchmaking.h"
+#include <string.h>
+
+// Open addressing with linear probing; deletions shift the run back so
+// there are no tombstones to skip
+typedef struct {
+    bool used;
+    uint32_t addr;       // Network byte order, as received
+    uint16_t port;       // Network byte order
+    int player_index;    // Slot in tcp_server's players[]
+    uint32_t player_id;  // Guards against the slot being reused
+    Room* room;          // Last room seen, revalidated on every lookup
+    uint32_t room_id;
+} EndpointEntry;
+
+static EndpointEntry table[UDP_ENDPOINT_BUCKETS];
+static int entry_count = 0;
+static pthread_mutex_t endpoint_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static uint32_t hash_endpoint(uint32_t addr, uint16_t port) {
+    uint64_t key = ((uint64_t)addr << 16) | port;
+    key *= 0x9E3779B97F4A7C15ULL;  // Fibonacci hashing
+    return (uint32_t)(key >> 32);
+}
+
+static int find_slot(uint32_t addr, uint16_t port) {
+    uint32_t idx = hash_endpoint(addr, port) & (UDP_ENDPOINT_BUCKETS - 1);
+    while (table[idx].used) {
+        if (table[idx].addr == addr && table[idx].port == port) {
+            return (int)idx;
+        }
+        idx = (idx + 1) & (UDP_ENDPOINT_BUCKETS - 1);
+    }
+    return -1;
+}
+
+static void remove_slot(int slot) {
+    uint32_t hole = (uint32_t)slot;
+    uint32_t idx = hole;
+    table[hole].used = false;
+    entry_count--;
+
+    // Pull later members of the probe run back into the hole, unless that
+    // would move them before their home bucket
+    for (;;) {
+        idx = (idx + 1) & (UDP_ENDPOINT_BUCKETS - 1);
+        if (!table[idx].used) break;
+
+        uint32_t home = hash_endpoint(table[idx].addr, table[idx].port) & (UDP_ENDPOINT_BUCKETS - 1);
+        uint32_t dist_hole = (hole - home) & (UDP_ENDPOINT_BUCKETS - 1);
+        uint32_t dist_idx = (idx - home) & (UDP_ENDPOINT_BUCKETS - 1);
+        if (dist_hole < dist_idx) {
+            table[hole] = table[idx];
+            table[idx].used = false;
+            hole = idx;
+        }
+    }
+}
+
+// The entry's player, or NULL once that player has left its slot
+static Player* entry_player(const EndpointEntry* entry) {
+    Player* player = tcp_server_player_at(entry->player_index);
+    if (!player || player->player_id != entry->player_id || !player->udp_bound) {
+        return NULL;
+    }
+    return player;
+}
+
+static bool room_has_player(const Room* room, const Player* player) {
+    for (int i = 0; i < room->player_count; i++) {
+        if (room->players[i] == player) return true;
+    }
+    return false;
+}
+
+void udp_endpoints_init() {
+    pthread_mutex_lock(&endpoint_mutex);
+    memset(table, 0, sizeof(table));
+    entry_count = 0;
+    pthread_mutex_unlock(&endpoint_mutex);
+}
+
+// Record addr as the player's endpoint, replacing any earlier one (NAT
+// rebinding) and taking it over from any player that had it before
+int udp_endpoint_bind(Player* player, const struct sockaddr_in* addr) {
+    int player_index = tcp_server_player_index(player);
+    if (player_index < 0) return -1;
+
+    uint32_t key_addr = addr->sin_addr.s_addr;
+    uint16_t key_port = addr->sin_port;
+
+    pthread_mutex_lock(&endpoint_mutex);
+
+    if (player->udp_bound) {
+        int old = find_slot(player->udp_addr.sin_addr.s_addr, player->udp_addr.sin_port);
+        if (old >= 0) remove_slot(old);
+        player->udp_bound = false;
+    }
+
+    int slot = find_slot(key_addr, key_port);
+    if (slot >= 0) {
+        Player* previous = entry_player(&table[slot]);
+        if (previous) previous->udp_bound = false;
+        remove_slot(slot);
+    }
+
+    // Keep at least one empty bucket so probes terminate
+    if (entry_count >= UDP_ENDPOINT_BUCKETS - 1) {
+        pthread_mutex_unlock(&endpoint_mutex);
+        return -1;
+    }
+
+    uint32_t idx = hash_endpoint(key_addr, key_port) & (UDP_ENDPOINT_BUCKETS - 1);
+    while (table[idx].used) {
+        idx = (idx + 1) & (UDP_ENDPOINT_BUCKETS - 1);
+    }
+
+    EndpointEntry* entry = &table[idx];
+    memset(entry, 0, sizeof(*entry));
+    entry->used = true;
+    entry->addr = key_addr;
+    entry->port = key_port;
+    entry->player_index = player_index;
+    entry->player_id = player->player_id;
+    entry_count++;
+
+    player->udp_addr = *addr;
+    player->udp_bound = true;
+
+    pthread_mutex_unlock(&endpoint_mutex);
+    return 0;
+}
+
+void udp_endpoint_unbind(Player* player) {
+    pthread_mutex_lock(&endpoint_mutex);
+    if (player->udp_bound) {
+        int slot = find_slot(player->udp_addr.sin_addr.s_addr, player->udp_addr.sin_port);
+        if (slot >= 0) remove_slot(slot);
+        player->udp_bound = false;
+    }
+    pthread_mutex_unlock(&endpoint_mutex);
+}
+
+// Player bound to addr, and the room it is in (NULL when in none)
+Player* udp_endpoint_lookup(const struct sockaddr_in* addr, Room** out_room) {
+    *out_room = NULL;
+
+    pthread_mutex_lock(&endpoint_mutex);
+
+    int slot = find_slot(addr->sin_addr.s_addr, addr->sin_port);
+    if (slot < 0) {
+        pthread_mutex_unlock(&endpoint_mutex);
+        return NULL;
+    }
+
+    EndpointEntry* entry = &table[slot];
+    Player* player = entry_player(entry);
+    if (!player) {
+        remove_slot(slot);
+        pthread_mutex_unlock(&endpoint_mutex);
+        return NULL;
+    }
+
+    // Only a join or leave sends us back to the room scan
+    if (!entry->room || entry->room->room_id != entry->room_id ||
+        !room_has_player(entry->room, player)) {
+        entry->room = get_player_room(player);
+        entry->room_id = entry->room ? entry->room->room_id : 0;
+    }
+    *out_room = entry->room;
+
+    pthread_mutex_unlock(&endpoint_mutex);
+    return player;
+}
+
+bool udp_endpoint_get(const Player* player, struct sockaddr_in* out) {
+    pthread_mutex_lock(&endpoint_mutex);
+    bool bound = player->udp_bound;
+    if (bound) *out = player->udp_addr;
+    pthread_mutex_unlock(&endpoint_mutex);
+    return bound;
+}
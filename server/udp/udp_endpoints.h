@@ -0,0 +1,20 @@
+#ifndef UDP_ENDPOINTS_H
+#define UDP_ENDPOINTS_H
+
+#include "../protocol.h"
+#include <pthread.h>
+
+// Observed UDP source endpoint -> player. A client binds by sending
+// UDP_BIND with its session token; whatever address and port the server
+// sees (after any NAT) becomes that player's endpoint, both for accepting
+// its strokes and for sending it everyone else's.
+
+#define UDP_ENDPOINT_BUCKETS 256  // Power of two, comfortably above MAX_CLIENTS
+
+void udp_endpoints_init();
+int udp_endpoint_bind(Player* player, const struct sockaddr_in* addr);
+void udp_endpoint_unbind(Player* player);
+Player* udp_endpoint_lookup(const struct sockaddr_in* addr, Room** out_room);
+bool udp_endpoint_get(const Player* player, struct sockaddr_in* out);
+
+#endif // UDP_ENDPOINTS_H
@@ -0,0 +1,115 @@
+#include "udp_fec.h"
+#include "udp_endpoints.h"
+#include "../utils/timer.h"
+#include <string.h>
+
+static bool fec_enabled = false;
+
+void udp_fec_set_enabled(bool enabled) {
+    fec_enabled = enabled;
+}
+
+static bool wants_parity(const Room* room, const Player* player, uint32_t sender_id) {
+    return player && player->fd > 0 && player->player_id != sender_id &&
+           player->udp_room_id == room->room_id && player->udp_loss >= UDP_FEC_MIN_LOSS;
+}
+
+// One parity datagram per this many stroke datagrams, for the lossiest
+// receiver in the room; 0 when nobody needs it. XOR parity repairs one
+// loss per group, so the group has to shrink as losses get denser.
+static int group_size(const Room* room, uint32_t sender_id) {
+    float worst = 0;
+    for (int i = 0; i < room->player_count; i++) {
+        const Player* p = room->players[i];
+        if (wants_parity(room, p, sender_id) && p->udp_loss > worst) worst = p->udp_loss;
+    }
+    
+    if (worst >= 0.12f) return 2;
+    if (worst >= 0.05f) return 4;
+    if (worst >= 0.025f) return 8;
+    if (worst >= UDP_FEC_MIN_LOSS) return UDP_FEC_MAX_GROUP;
+    return 0;
+}
+
+static void close_group(UdpSendBatch* batch, Room* room) {
+    UdpFecGroup* group = &room->fec;
+    if (group->count == 0) return;
+    
+    uint8_t payload[UDP_FEC_HEADER_SIZE + UDP_MAX_PAYLOAD];
+    payload[0] = (uint8_t)group->count;
+    payload[1] = 0;
+    payload[2] = (uint8_t)(group->len_xor >> 8);
+    payload[3] = (uint8_t)group->len_xor;
+    memcpy(payload + UDP_FEC_HEADER_SIZE, group->parity, group->max_len);
+    
+    UdpHeader header = { UDP_FEC, room->room_id, group->first_seq, 0, 0 };
+    uint8_t datagram[UDP_MAX_DATAGRAM];
+    int len = udp_wire_encode(&header, payload, UDP_FEC_HEADER_SIZE + group->max_len,
+                              datagram, sizeof(datagram));
+    const void* stored = len > 0 ? udp_batch_store(batch, datagram, len, room->player_count) : NULL;
+    
+    for (int i = 0; stored && i < room->player_count; i++) {
+        Player* p = room->players[i];
+        if (!wants_parity(room, p, group->sender_id)) continue;
+        
+        struct sockaddr_in addr;
+        if (udp_endpoint_get(p, &addr)) udp_batch_queue(batch, stored, len, &addr);
+    }
+    
+    group->count = 0;
+}
+
+// Fold a stroke datagram's payload into the room's open group, sending
+// the parity once the group is full. Caller holds room->stroke_lock.
+void udp_fec_add(UdpSendBatch* batch, Room* room, uint32_t seq, const uint8_t* payload,
+                 size_t len, const Player* sender) {
+    if (!fec_enabled) return;
+    
+    UdpFecGroup* group = &room->fec;
+    uint32_t sender_id = sender ? sender->player_id : 0;
+    uint64_t now = get_current_time_ms();
+    
+    // A pause in drawing, another drawer, or a gap (shouldn't happen) ends
+    // the group early; the parity still covers what it has
+    if (group->count > 0 &&
+        (now - group->opened_at > UDP_FEC_MAX_SPAN_MS || group->sender_id != sender_id ||
+         seq != group->first_seq + (uint32_t)group->count)) {
+        close_group(batch, room);
+    }
+    
+    if (group->count == 0) {
+        group->size = group_size(room, sender_id);
+        if (group->size == 0 || len > UDP_MAX_PAYLOAD - UDP_FEC_HEADER_SIZE) return;
+        
+        group->first_seq = seq;
+        group->sender_id = sender_id;
+        group->opened_at = now;
+        group->len_xor = 0;
+        group->max_len = 0;
+        memset(group->parity, 0, sizeof(group->parity));
+    }
+    
+    for (size_t i = 0; i < len; i++) {
+        group->parity[i] ^= payload[i];
+    }
+    group->len_xor ^= (uint16_t)len;
+    if (len > group->max_len) group->max_len = (uint16_t)len;
+    group->count++;
+    
+    if (group->count >= group->size) {
+        close_group(batch, room);
+    }
+}
+
+// Send the parity of a group that has been open too long; returns when the
+// room's open group has to be closed by, 0 if none is left open
+uint64_t udp_fec_expire(UdpSendBatch* batch, Room* room, uint64_t now) {
+    pthread_mutex_lock(&room->stroke_lock);
+    UdpFecGroup* group = &room->fec;
+    if (group->count > 0 && now - group->opened_at >= UDP_FEC_MAX_SPAN_MS) {
+        close_group(batch, room);
+    }
+    uint64_t deadline = group->count > 0 ? group->opened_at + UDP_FEC_MAX_SPAN_MS : 0;
+    pthread_mutex_unlock(&room->stroke_lock);
+    return deadline;
+}
@@ -0,0 +1,34 @@
+#ifndef UDP_FEC_H
+#define UDP_FEC_H
+
+#include "udp_broadcast.h"
+
+// Optional forward error correction for stroke datagrams. A room's stroke
+// datagrams are grouped by seq, and after each group the server sends
+// UDP_FEC: the XOR of the group's payloads, each zero-padded to the longest.
+//
+//   header  seq = first seq in the group, ack and ack_bits 0
+//   payload count:u8 reserved:u8 len_xor:u16 parity[longest payload]
+//
+// A receiver missing exactly one seq of the group XORs the parity with the
+// payloads it has to get the missing payload, whose length is len_xor XORed
+// with theirs. Its header is known: UDP_STROKE, the room, that seq, ack and
+// ack_bits 0. It should then ack it like any other datagram.
+//
+// Parity only goes to receivers whose measured loss (player->udp_loss)
+// warrants it, and the group size shrinks as the worst of them gets
+// lossier. Anything FEC can't recover is still retransmitted from acks.
+// A group that doesn't fill within UDP_FEC_MAX_SPAN_MS is closed short by
+// the thread that opened it, so a pause in drawing doesn't hold its parity.
+// The group lives in the room, under stroke_lock.
+
+#define UDP_FEC_HEADER_SIZE 4
+#define UDP_FEC_MIN_LOSS 0.01f   // Below this, a receiver gets no parity
+#define UDP_FEC_MAX_SPAN_MS 50   // A group still open this long is closed short
+
+void udp_fec_set_enabled(bool enabled);
+void udp_fec_add(UdpSendBatch* batch, Room* room, uint32_t seq, const uint8_t* payload,
+                 size_t len, const Player* sender);
+uint64_t udp_fec_expire(UdpSendBatch* batch, Room* room, uint64_t now);
+
+#endif // UDP_FEC_H
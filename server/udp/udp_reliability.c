@@ -0,0 +1,137 @@
+#include "udp_reliability.h"
+#include "udp_endpoints.h"
+#include "../utils/timer.h"
+#include <string.h>
+
+// Sequence comparison that survives wraparound
+static bool seq_after(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) > 0;
+}
+
+// Did the receiver report seq as received in this ack?
+static bool acked_in(uint32_t seq, uint32_t ack, uint32_t ack_bits) {
+    if (seq == ack) return true;
+    if (seq_after(seq, ack)) return false;
+
+    uint32_t behind = ack - seq;
+    return behind <= 32 && (ack_bits & (1u << (behind - 1)));
+}
+
+// Remember what the next seq carries; returns that seq.
+// Caller holds room->stroke_lock.
+uint32_t udp_reliable_record(Room* room, const Stroke* strokes, int count, int first_stroke,
+                             const Player* sender) {
+    uint32_t seq = ++room->udp_seq;
+
+    UdpSentDatagram* sent = &room->udp_sent[seq & (UDP_RESEND_WINDOW - 1)];
+    sent->seq = seq;
+    sent->epoch = room->canvas_epoch;
+    sent->first_stroke = first_stroke;
+    sent->stroke_count = count;
+    sent->first_timestamp = strokes[0].timestamp;
+    sent->last_timestamp = strokes[count - 1].timestamp;
+    sent->sender_id = sender ? sender->player_id : 0;
+    sent->sent_at = get_current_time_ms();
+    return seq;
+}
+
+// First datagram a receiver gets in a room starts its window; anything
+// earlier reached it through the canvas snapshot on join.
+// Caller holds room->stroke_lock.
+void udp_reliable_track(Room* room, Player* receiver, uint32_t seq) {
+    if (receiver->udp_room_id == room->room_id) return;
+
+    receiver->udp_room_id = room->room_id;
+    receiver->udp_base_seq = seq - 1;
+    receiver->udp_acked = seq - 1;
+}
+
+// Queue seq again if the strokes it carried are still on the canvas.
+// Caller holds room->stroke_lock.
+static bool resend(UdpSendBatch* batch, Room* room, const Player* receiver,
+                   const struct sockaddr_in* addr, uint32_t seq, uint64_t now) {
+    UdpSentDatagram* sent = &room->udp_sent[seq & (UDP_RESEND_WINDOW - 1)];
+    if (sent->seq != seq || sent->sender_id == receiver->player_id) return false;
+
+    // Still in flight; the ack just hasn't caught up
+    if (now - sent->sent_at < UDP_RESEND_INTERVAL_MS) return false;
+
+    // A clear wiped them, or an undo truncated them (and maybe reused the slots)
+    int first = sent->first_stroke;
+    int last = first + sent->stroke_count - 1;
+    if (sent->epoch != room->canvas_epoch || first < 0 || last >= room->stroke_count ||
+        room->strokes[first].timestamp != sent->first_timestamp ||
+        room->strokes[last].timestamp != sent->last_timestamp) {
+        return false;
+    }
+
+    uint8_t datagram[UDP_MAX_DATAGRAM];
+    int len = udp_encode_strokes(room, seq, &room->strokes[first], sent->stroke_count,
+                                 datagram, sizeof(datagram));
+    if (len < 0) return false;
+
+    const void* payload = udp_batch_store(batch, datagram, len, 1);
+    if (!payload) return false;
+    udp_batch_queue(batch, payload, len, addr);
+    sent->sent_at = now;  // Give this copy a round trip before trying again
+    return true;
+}
+
+// Fold the datagrams this ack newly reports on into the receiver's loss
+// estimate; the drawer's own strokes never reach it, so they don't count
+static void update_loss(const Room* room, Player* receiver, uint32_t previous,
+                        uint32_t ack, uint32_t ack_bits) {
+    uint32_t from = previous;
+    if (seq_after(ack - 33, from)) from = ack - 33;
+    
+    for (uint32_t seq = from + 1; !seq_after(seq, ack); seq++) {
+        const UdpSentDatagram* sent = &room->udp_sent[seq & (UDP_RESEND_WINDOW - 1)];
+        if (sent->seq != seq || sent->sender_id == receiver->player_id) continue;
+        
+        float lost = acked_in(seq, ack, ack_bits) ? 0.0f : 1.0f;
+        receiver->udp_loss += (lost - receiver->udp_loss) * UDP_LOSS_GAIN;
+    }
+}
+
+void udp_reliable_on_ack(UdpSendBatch* batch, Room* room, Player* receiver,
+                         uint32_t ack, uint32_t ack_bits) {
+    // The reactor sends strokes that arrived over TCP through the same
+    // window, and undoes and clears the log it resends from
+    pthread_mutex_lock(&room->stroke_lock);
+    
+    // Acks from before the receiver's first datagram here, or for seqs
+    // the room never sent, tell us nothing
+    if (receiver->udp_room_id != room->room_id || seq_after(ack, room->udp_seq)) {
+        pthread_mutex_unlock(&room->stroke_lock);
+        return;
+    }
+
+    // A reordered, older ack's bitfield would make newer datagrams look lost
+    if (seq_after(receiver->udp_acked, ack)) {
+        pthread_mutex_unlock(&room->stroke_lock);
+        return;
+    }
+    update_loss(room, receiver, receiver->udp_acked, ack, ack_bits);
+    receiver->udp_acked = ack;
+
+    struct sockaddr_in addr;
+    if (!udp_endpoint_get(receiver, &addr)) {
+        pthread_mutex_unlock(&room->stroke_lock);
+        return;
+    }
+
+    // Older than the bitfield reaches means the receiver stopped asking;
+    // older than the window means the record is gone
+    uint32_t floor = receiver->udp_base_seq;
+    if (seq_after(receiver->udp_acked - 33, floor)) floor = receiver->udp_acked - 33;
+    if (seq_after(room->udp_seq - UDP_RESEND_WINDOW, floor)) floor = room->udp_seq - UDP_RESEND_WINDOW;
+    receiver->udp_base_seq = floor;
+
+    uint64_t now = get_current_time_ms();
+    int resent = 0;
+    for (uint32_t seq = floor + 1; !seq_after(seq, room->udp_seq) && resent < UDP_RESEND_MAX; seq++) {
+        if (acked_in(seq, ack, ack_bits)) continue;
+        if (resend(batch, room, receiver, &addr, seq, now)) resent++;
+    }
+    pthread_mutex_unlock(&room->stroke_lock);
+}
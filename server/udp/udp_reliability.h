@@ -0,0 +1,19 @@
+#ifndef UDP_RELIABILITY_H
+#define UDP_RELIABILITY_H
+
+#include "udp_broadcast.h"
+
+// Sequenced stroke datagrams with selective retransmission. Each room
+// numbers its UDP stroke datagrams; receivers ack with a bitfield and anything they
+// report missing is resent from room->strokes, as long as no clear or undo
+// has superseded it. Strokes that arrive over TCP go out the same way, so
+// the send window and each receiver's ack state are shared by the reactor
+// and the room's UDP worker, under stroke_lock like the log itself.
+
+uint32_t udp_reliable_record(Room* room, const Stroke* strokes, int count, int first_stroke,
+                             const Player* sender);
+void udp_reliable_track(Room* room, Player* receiver, uint32_t seq);
+void udp_reliable_on_ack(UdpSendBatch* batch, Room* room, Player* receiver,
+                         uint32_t ack, uint32_t ack_bits);
+
+#endif // UDP_RELIABILITY_H
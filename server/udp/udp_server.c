@@ -1,8 +1,15 @@
 #include "udp_server.h"
 #include "udp_broadcast.h"
+#include "udp_endpoints.h"
+#include "udp_fec.h"
+#include "udp_reliability.h"
+#include "udp_wire.h"
+#include "../tcp/tcp_server.h"
 #include "../game/matchmaking.h"
 #include "../game/game_logic.h"
+#include "../game/stroke_codec.h"
 #include "../utils/logger.h"
+#include "../utils/timer.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -11,58 +18,268 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <linux/filter.h>
 
-static int udp_server_fd = -1;
-static pthread_t udp_thread;
+#define UDP_RECV_BATCH 32  // Datagrams per recvmmsg()
+
+// One socket per worker, all bound to the same port with SO_REUSEPORT.
+// Everything but the endpoint table is private to the worker's thread.
+typedef struct {
+    int fd;
+    pthread_t thread;
+    uint8_t recv_buffers[UDP_RECV_BATCH][UDP_MAX_DATAGRAM];  // Longer datagrams arrive truncated and fail to decode
+    UdpSendBatch send_batch;
+    // Rooms whose parity group this worker opened; room_id catches reuse
+    struct {
+        Room* room;
+        uint32_t room_id;
+    } fec_rooms[MAX_ROOMS];
+    int fec_room_count;
+} UdpWorker;
+
+static UdpWorker workers[UDP_MAX_WORKERS];
+static int worker_count = 0;
+static UdpWorker tcp_fanout;  // The reactor's sender: only fd, send_batch and fec_rooms are used
 static volatile bool udp_running = false;
+static int wake_pipe[2] = {-1, -1};  // Interrupts every worker's poll() on detach
+
+static void track_fec_room(UdpWorker* worker, Room* room) {
+    for (int i = 0; i < worker->fec_room_count; i++) {
+        if (worker->fec_rooms[i].room == room) {
+            worker->fec_rooms[i].room_id = room->room_id;
+            return;
+        }
+    }
+    if (worker->fec_room_count < MAX_ROOMS) {
+        worker->fec_rooms[worker->fec_room_count].room = room;
+        worker->fec_rooms[worker->fec_room_count].room_id = room->room_id;
+        worker->fec_room_count++;
+    }
+}
+
+// Close parity groups that have been open too long; returns the poll()
+// timeout until the next one is due, -1 when none is open
+static int expire_fec_groups(UdpWorker* worker) {
+    if (worker->fec_room_count == 0) return -1;
+    
+    uint64_t now = get_current_time_ms();
+    uint64_t next = 0;
+    int kept = 0;
+    for (int i = 0; i < worker->fec_room_count; i++) {
+        Room* room = worker->fec_rooms[i].room;
+        if (room->room_id != worker->fec_rooms[i].room_id) continue;
+        
+        uint64_t deadline = udp_fec_expire(&worker->send_batch, room, now);
+        if (deadline == 0) continue;
+        if (next == 0 || deadline < next) next = deadline;
+        worker->fec_rooms[kept++] = worker->fec_rooms[i];
+    }
+    worker->fec_room_count = kept;
+    
+    if (next == 0) return -1;
+    return next > now ? (int)(next - now) : 0;
+}
+
+// Tie the datagram's source endpoint to the player owning the token. The
+// ack goes back to that endpoint, which also opens any NAT on the way
+static void handle_bind(UdpWorker* worker, const uint8_t* token, size_t token_len,
+                        const struct sockaddr_in* from) {
+    char session_token[64];
+    if (token_len == 0 || token_len >= sizeof(session_token)) return;
+    memcpy(session_token, token, token_len);
+    session_token[token_len] = '\0';
+    
+    uint32_t id = tcp_server_bind_udp(session_token, from);
+    if (id == 0) {
+        char addr_str[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &from->sin_addr, addr_str, sizeof(addr_str));
+        printf("[UDP] Rejected bind from %s:%d\n", addr_str, ntohs(from->sin_port));
+        return;
+    }
+    
+    uint8_t player_id[4] = {
+        (uint8_t)(id >> 24), (uint8_t)(id >> 16), (uint8_t)(id >> 8), (uint8_t)id
+    };
+    UdpHeader header = { UDP_BIND_ACK, 0, 0, 0, 0 };
+    uint8_t datagram[UDP_HEADER_SIZE + sizeof(player_id)];
+    int len = udp_wire_encode(&header, player_id, sizeof(player_id), datagram, sizeof(datagram));
+    
+    const void* payload = udp_batch_store(&worker->send_batch, datagram, len, 1);
+    if (payload) udp_batch_queue(&worker->send_batch, payload, len, from);
+}
+
+static void handle_datagram(UdpWorker* worker, const uint8_t* buffer, int len,
+                            const struct sockaddr_in* from) {
+    UdpHeader header;
+    const uint8_t* payload;
+    size_t payload_len;
+    if (udp_wire_decode(buffer, len, &header, &payload, &payload_len) < 0) return;
+    
+    if (header.type == UDP_BIND) {
+        handle_bind(worker, payload, payload_len, from);
+        return;
+    }
+    if (header.type != UDP_STROKE && header.type != UDP_ACK) return;
+    
+    // The room comes from the endpoint; the packet's room_id must agree
+    Room* room;
+    Player* player = udp_endpoint_lookup(from, &room);
+    if (!player || !room || room->room_id != header.room_id) return;
+    
+    // Every client datagram carries an ack
+    udp_reliable_on_ack(&worker->send_batch, room, player, header.ack, header.ack_bits);
+    if (header.type != UDP_STROKE) return;
+    
+    // Only the drawer of a running round may draw
+    if (room->state != ROOM_PLAYING || !player->is_drawing) return;
+    
+    Stroke strokes[UDP_MAX_STROKES];
+    int count = stroke_codec_decode(payload, payload_len, 0, strokes, UDP_MAX_STROKES);
+    if (count <= 0) return;
+    
+    // Client clocks are not trusted; stamp arrival time like the TCP path
+    uint64_t now = get_current_time_ms();
+    for (int i = 0; i < count; i++) {
+        strokes[i].timestamp = now;
+    }
+    
+    // Retransmits read the strokes back from where they were stored; if the
+    // log filled up part way, they go out without that
+    int first_stroke = add_strokes(room, strokes, count);
+    if (broadcast_strokes_to_room(&worker->send_batch, room, strokes, count, first_stroke, player)) {
+        track_fec_room(worker, room);
+    }
+}
 
 void* udp_server_thread(void* arg) {
-    (void)arg;
+    UdpWorker* worker = (UdpWorker*)arg;
+    
+    struct mmsghdr msgs[UDP_RECV_BATCH];
+    struct iovec iovs[UDP_RECV_BATCH];
+    struct sockaddr_in addrs[UDP_RECV_BATCH];
     
-    char buffer[BUFFER_SIZE];
-    struct sockaddr_in client_addr;
-    socklen_t client_len = sizeof(client_addr);
+    udp_batch_init(&worker->send_batch, worker->fd);
     
     while (udp_running) {
-        int bytes_read = recvfrom(udp_server_fd, buffer, sizeof(buffer), 0,
-                                  (struct sockaddr*)&client_addr, &client_len);
+        // Parity for groups a pause in drawing left open
+        int timeout = expire_fec_groups(worker);
+        udp_batch_flush(&worker->send_batch);
         
-        if (bytes_read < 0) {
-            if (errno == EINTR || errno == EAGAIN) continue;
-            perror("UDP recvfrom failed");
+        struct pollfd fds[2] = {
+            { .fd = worker->fd, .events = POLLIN },
+            { .fd = wake_pipe[0], .events = POLLIN }
+        };
+        if (poll(fds, 2, timeout) < 0) {
+            if (errno == EINTR) continue;
+            perror("UDP poll failed");
             continue;
         }
+        if (!udp_running) break;
+        if (!(fds[0].revents & POLLIN)) continue;
         
-        Stroke stroke;
-        uint32_t room_id;
+        // recvmmsg() overwrites the lengths, so rebuild the headers each time
+        for (int i = 0; i < UDP_RECV_BATCH; i++) {
+            iovs[i].iov_base = worker->recv_buffers[i];
+            iovs[i].iov_len = sizeof(worker->recv_buffers[i]);
+            memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+            msgs[i].msg_hdr.msg_name = &addrs[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
         
-        if (deserialize_udp_stroke(buffer, bytes_read, &stroke, &room_id) == 0) {
-            Room* room = find_room_by_id(room_id);
-            if (room) {
-                // Add stroke to room
-                add_stroke(room, &stroke);
-                
-                // Broadcast to all players except sender
-                broadcast_stroke_to_room(udp_server_fd, room, &stroke, &client_addr);
-                
-                // Log stroke
-                log_stroke(room_id, stroke.stroke_id, &stroke);
-            }
+        int received = recvmmsg(worker->fd, msgs, UDP_RECV_BATCH, MSG_DONTWAIT, NULL);
+        if (received < 0) {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            perror("UDP recvmmsg failed");
+            continue;
         }
+        
+        for (int i = 0; i < received; i++) {
+            handle_datagram(worker, worker->recv_buffers[i], (int)msgs[i].msg_len, &addrs[i]);
+        }
+        
+        // Everything the batch produced, for every room, in one syscall
+        udp_batch_flush(&worker->send_batch);
     }
     
     return NULL;
 }
 
-int udp_server_start(int port) {
-    udp_server_fd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (udp_server_fd < 0) {
+// Whether UDP-bound players can be sent to; while not (between a handoff's
+// adopts), the reactor sends them strokes over TCP like everyone else
+bool udp_server_running() {
+    return udp_running && worker_count > 0;
+}
+
+// Strokes that arrived over TCP, to the room's UDP-bound players, from the
+// socket of the worker the room steers to. Reactor thread only.
+void udp_server_broadcast_strokes(Room* room, const Stroke* strokes, int count,
+                                  int first_stroke, const Player* exclude) {
+    if (!udp_server_running()) return;
+    
+    int fd = workers[room->room_id % worker_count].fd;
+    if (tcp_fanout.fd != fd) {
+        udp_batch_flush(&tcp_fanout.send_batch);
+        tcp_fanout.fd = fd;
+        udp_batch_init(&tcp_fanout.send_batch, fd);
+    }
+    
+    if (broadcast_strokes_to_room(&tcp_fanout.send_batch, room, strokes, count, first_stroke, exclude)) {
+        track_fec_room(&tcp_fanout, room);
+    }
+    udp_batch_flush(&tcp_fanout.send_batch);
+}
+
+// Parity for groups the reactor opened; returns the reactor's select()
+// timeout in ms until the next one is due, -1 when none is open
+int udp_server_expire_parity() {
+    if (tcp_fanout.fec_room_count == 0) return -1;
+    
+    int timeout = expire_fec_groups(&tcp_fanout);
+    udp_batch_flush(&tcp_fanout.send_batch);
+    return timeout;
+}
+
+// Steer each stroke datagram to worker room_id % count, so one room's
+// strokes are always handled by one thread, in order. The program sees the
+// UDP payload; BPF_ABS loads are big-endian, like the wire format.
+// Binds and short packets land wherever, which is fine: they carry no room.
+static void attach_room_steering(int fd, int count) {
+#ifdef SO_ATTACH_REUSEPORT_CBPF
+    struct sock_filter code[] = {
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, UDP_ROOM_ID_OFFSET),
+        BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, (uint32_t)count),
+        BPF_STMT(BPF_RET | BPF_A, 0),
+    };
+    struct sock_fprog prog = { .len = sizeof(code) / sizeof(code[0]), .filter = code };
+    
+    if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) < 0) {
+        // The kernel's 4-tuple hash still keeps each drawer on one worker
+        perror("[UDP] Room steering unavailable, using the kernel's flow hash");
+    }
+#else
+    (void)fd;
+    (void)count;
+#endif
+}
+
+static int open_worker_socket(int port) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
         perror("Failed to create UDP socket");
         return -1;
     }
     
     int opt = 1;
-    setsockopt(udp_server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        perror("Failed to set SO_REUSEPORT");
+        close(fd);
+        return -1;
+    }
     
     struct sockaddr_in addr;
     memset(&addr, 0, sizeof(addr));
@@ -70,30 +287,111 @@ int udp_server_start(int port) {
     addr.sin_addr.s_addr = INADDR_ANY;
     addr.sin_port = htons(port);
     
-    if (bind(udp_server_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
         perror("Failed to bind UDP socket");
-        close(udp_server_fd);
+        close(fd);
         return -1;
     }
+    return fd;
+}
+
+// workers == 0 means one per online CPU; either way at most UDP_MAX_WORKERS
+int udp_server_start(int port, int workers) {
+    long count_wanted = workers > 0 ? workers : sysconf(_SC_NPROCESSORS_ONLN);
+    int count = count_wanted < 1 ? 1 :
+                (count_wanted > UDP_MAX_WORKERS ? UDP_MAX_WORKERS : (int)count_wanted);
     
-    udp_running = true;
+    // The reuseport group indexes sockets in bind order, which is the
+    // order the steering program's room_id % count refers to
+    int fds[UDP_MAX_WORKERS];
+    for (int i = 0; i < count; i++) {
+        fds[i] = open_worker_socket(port);
+        if (fds[i] < 0) {
+            while (i-- > 0) close(fds[i]);
+            return -1;
+        }
+    }
+    attach_room_steering(fds[0], count);
     
-    if (pthread_create(&udp_thread, NULL, udp_server_thread, NULL) != 0) {
-        perror("Failed to create UDP server thread");
-        close(udp_server_fd);
+    if (udp_server_adopt(fds, count) < 0) {
+        for (int i = 0; i < count; i++) close(fds[i]);
         return -1;
     }
     
-    printf("[UDP] Server started on port %d\n", port);
+    printf("[UDP] Server started on port %d with %d workers%s\n", port, count,
+           udp_gso_supported(fds[0]) ? ", segmentation offload on" : "");
     return 0;
 }
 
+static void adopt_fec_room(Room* room) {
+    if (room->fec.count > 0) track_fec_room(&workers[room->room_id % worker_count], room);
+}
+
+// Serve already-bound sockets, in reuseport group order
+int udp_server_adopt(const int* fds, int count) {
+    if (count < 1 || count > UDP_MAX_WORKERS) return -1;
+    
+    if (wake_pipe[0] < 0) {
+        if (pipe(wake_pipe) < 0) {
+            perror("Failed to create UDP wake pipe");
+            return -1;
+        }
+        fcntl(wake_pipe[0], F_SETFL, O_NONBLOCK);
+    }
+    
+    worker_count = count;
+    udp_running = true;
+    
+    // Groups carried over a handoff go to the worker their room steers to
+    for (int i = 0; i < count; i++) {
+        workers[i].fec_room_count = 0;
+    }
+    iterate_active_rooms(adopt_fec_room);
+    
+    for (int i = 0; i < count; i++) {
+        workers[i].fd = fds[i];
+        if (pthread_create(&workers[i].thread, NULL, udp_server_thread, &workers[i]) != 0) {
+            perror("Failed to create UDP server thread");
+            worker_count = i;
+            udp_server_detach(NULL, 0);
+            worker_count = 0;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Stop every worker but keep the sockets open; copies them into fds (in
+// group order) and returns how many there are
+int udp_server_detach(int* fds, int max_fds) {
+    if (udp_running) {
+        udp_running = false;
+        if (write(wake_pipe[1], "x", 1) < 0) {
+            perror("UDP wake pipe");
+        }
+        for (int i = 0; i < worker_count; i++) {
+            pthread_join(workers[i].thread, NULL);
+        }
+        
+        char drain[16];
+        while (read(wake_pipe[0], drain, sizeof(drain)) > 0) {}
+    }
+    
+    int count = worker_count < max_fds ? worker_count : max_fds;
+    for (int i = 0; i < count; i++) {
+        fds[i] = workers[i].fd;
+    }
+    return worker_count;
+}
+
 void udp_server_stop() {
-    udp_running = false;
-    if (udp_server_fd >= 0) {
-        close(udp_server_fd);
-        udp_server_fd = -1;
+    udp_server_detach(NULL, 0);
+    for (int i = 0; i < worker_count; i++) {
+        if (workers[i].fd >= 0) {
+            close(workers[i].fd);
+            workers[i].fd = -1;
+        }
     }
-    pthread_join(udp_thread, NULL);
+    worker_count = 0;
     printf("[UDP] Server stopped\n");
 }
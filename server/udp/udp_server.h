@@ -1,10 +1,19 @@
 #ifndef UDP_SERVER_H
 #define UDP_SERVER_H
 
+#include "../protocol.h"
 #include <pthread.h>
 #include <stdbool.h>
 
-int udp_server_start(int port);
+#define UDP_MAX_WORKERS 8  // SO_REUSEPORT sockets, one receive thread each
+
+int udp_server_start(int port, int workers);
 void udp_server_stop();
+int udp_server_adopt(const int* fds, int count);
+int udp_server_detach(int* fds, int max_fds);
+bool udp_server_running();
+void udp_server_broadcast_strokes(Room* room, const Stroke* strokes, int count,
+                                  int first_stroke, const Player* exclude);
+int udp_server_expire_parity();
 
 #endif // UDP_SERVER_H
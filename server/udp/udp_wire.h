@@ -0,0 +1,44 @@
+#ifndef UDP_WIRE_H
+#define UDP_WIRE_H
+
+#include "../protocol.h"
+#include <stddef.h>
+
+// UDP datagram format. Every field is written byte by byte in network
+// order, so the layout doesn't depend on the compiler or ABI:
+//
+//   0  version:u8      UDP_WIRE_VERSION
+//   1  type:u8         UDPMessageType
+//   2  payload_len:u16
+//   4  room_id:u32     0 when not room-scoped; read here by the reuseport steering program
+//   8  seq:u32         Server -> client: the room's datagram sequence, from 1
+//  12  ack:u32         Client -> server: highest seq received
+//  16  ack_bits:u32    Bit i set: seq ack - 1 - i was received too
+//  20  crc:u32         CRC-32 of the header (crc zeroed) and the payload
+//  24  payload
+//
+// Payloads: UDP_STROKE carries any number of strokes as a stroke_codec blob
+// (relative to the round start); UDP_BIND the session token; UDP_BIND_ACK
+// the player id as a u32; UDP_ACK nothing; UDP_FEC parity (see udp_fec.h).
+// Datagrams are at most UDP_MAX_DATAGRAM (protocol.h) bytes.
+
+#define UDP_WIRE_VERSION 2      // 1 was the raw UDPMessage struct
+#define UDP_HEADER_SIZE 24
+#define UDP_ROOM_ID_OFFSET 4
+#define UDP_MAX_PAYLOAD (UDP_MAX_DATAGRAM - UDP_HEADER_SIZE)
+#define UDP_MAX_STROKES 512     // Segments one datagram can decode to (>= 2 bytes each)
+
+typedef struct {
+    UDPMessageType type;
+    uint32_t room_id;
+    uint32_t seq;
+    uint32_t ack;
+    uint32_t ack_bits;
+} UdpHeader;
+
+int udp_wire_encode(const UdpHeader* header, const void* payload, size_t payload_len,
+                    uint8_t* out, size_t out_size);
+int udp_wire_decode(const uint8_t* in, size_t len, UdpHeader* header,
+                    const uint8_t** payload, size_t* payload_len);
+
+#endif // UDP_WIRE_H
@@ -0,0 +1,69 @@
+#include "base64.h"
+
+static const char base64_table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+int base64_encode(const unsigned char* input, size_t length, char* output) {
+    int j = 0;
+    size_t i = 0;
+    
+    for (; i + 2 < length; i += 3) {
+        output[j++] = base64_table[input[i] >> 2];
+        output[j++] = base64_table[((input[i] & 0x03) << 4) | (input[i + 1] >> 4)];
+        output[j++] = base64_table[((input[i + 1] & 0x0f) << 2) | (input[i + 2] >> 6)];
+        output[j++] = base64_table[input[i + 2] & 0x3f];
+    }
+    
+    if (i < length) {
+        output[j++] = base64_table[input[i] >> 2];
+        if (i + 1 < length) {
+            output[j++] = base64_table[((input[i] & 0x03) << 4) | (input[i + 1] >> 4)];
+            output[j++] = base64_table[(input[i + 1] & 0x0f) << 2];
+        } else {
+            output[j++] = base64_table[(input[i] & 0x03) << 4];
+            output[j++] = '=';
+        }
+        output[j++] = '=';
+    }
+    
+    output[j] = '\0';
+    return j;
+}
+
+static int base64_value(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+int base64_decode(const char* input, size_t length, unsigned char* output) {
+    if (length % 4 != 0) return -1;
+    
+    int j = 0;
+    for (size_t i = 0; i < length; i += 4) {
+        int a = base64_value(input[i]);
+        int b = base64_value(input[i + 1]);
+        if (a < 0 || b < 0) return -1;
+        output[j++] = (unsigned char)((a << 2) | (b >> 4));
+        
+        if (input[i + 2] == '=') {
+            if (input[i + 3] != '=' || i + 4 != length) return -1;
+            break;
+        }
+        int c = base64_value(input[i + 2]);
+        if (c < 0) return -1;
+        output[j++] = (unsigned char)(((b & 0x0f) << 4) | (c >> 2));
+        
+        if (input[i + 3] == '=') {
+            if (i + 4 != length) return -1;
+            break;
+        }
+        int d = base64_value(input[i + 3]);
+        if (d < 0) return -1;
+        output[j++] = (unsigned char)(((c & 0x03) << 6) | d);
+    }
+    
+    return j;
+}
@@ -0,0 +1,14 @@
+#ifndef BASE64_H
+#define BASE64_H
+
+#include <stddef.h>
+
+#define BASE64_ENCODED_LEN(n) ((((n) + 2) / 3) * 4)
+
+// Writes BASE64_ENCODED_LEN(length) chars plus a terminating NUL; returns the char count
+int base64_encode(const unsigned char* input, size_t length, char* output);
+
+// Output needs room for length / 4 * 3 bytes; returns the byte count, or -1 on bad input
+int base64_decode(const char* input, size_t length, unsigned char* output);
+
+#endif // BASE64_H
@@ -0,0 +1,31 @@
+#include "crc32.h"
+#include <pthread.h>
+
+static uint32_t crc_table[256];
+static pthread_once_t crc_table_once = PTHREAD_ONCE_INIT;
+
+static void build_table() {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        crc_table[i] = c;
+    }
+}
+
+// Continue a running CRC; start with crc = 0
+uint32_t crc32_update(uint32_t crc, const void* data, size_t length) {
+    pthread_once(&crc_table_once, build_table);
+    
+    const uint8_t* p = data;
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc = crc_table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+uint32_t crc32_compute(const void* data, size_t length) {
+    return crc32_update(0, data, length);
+}
@@ -0,0 +1,11 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// CRC-32 (IEEE 802.3, reflected, as used by zlib/PNG)
+uint32_t crc32_compute(const void* data, size_t length);
+uint32_t crc32_update(uint32_t crc, const void* data, size_t length);
+
+#endif // CRC32_H
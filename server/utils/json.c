@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 // Simple JSON builder - not a full parser, just for creating messages
 char* json_create_message(MessageType type, const char* data) {
@@ -44,25 +45,12 @@ char* json_create_player_info(const Player* player) {
     return buffer;
 }
 
-char* json_create_room_state(const Room* room) {
-    char* buffer = malloc(BUFFER_SIZE * 2);
-    if (!buffer) return NULL;
-    
-    char players_json[BUFFER_SIZE] = "[";
-    int added_count = 0;
-    for (int i = 0; i < room->player_count; i++) {
-        if (room->players[i]) {
-            char* player_str = json_create_player_info(room->players[i]);
-            if (player_str) {
-                if (added_count > 0) strcat(players_json, ",");
-                strcat(players_json, player_str);
-                free(player_str);
-                added_count++;
-            }
-        }
-    }
-    strcat(players_json, "]");
-    
+#define ROOM_STATE_JSON_SIZE (BUFFER_SIZE * 2)
+
+// Cache rebuilds can come from the TCP and timer threads at once
+static pthread_mutex_t room_state_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void build_room_state(const Room* room, char* buffer) {
     // Word mask (hide some letters)
     char word_mask[MAX_WORD_LEN];
     int word_len = strlen(room->current_word);
@@ -77,15 +65,56 @@ char* json_create_room_state(const Room* room) {
     }
     word_mask[word_len] = '\0';
     
-    snprintf(buffer, BUFFER_SIZE * 2,
-             "{\"room_id\":%u,\"room_code\":\"%s\",\"player_count\":%d,\"state\":%d,"
+    int len = snprintf(buffer, ROOM_STATE_JSON_SIZE,
+             "{\"seq\":%u,\"room_id\":%u,\"room_code\":\"%s\",\"player_count\":%d,\"state\":%d,"
              "\"current_drawer\":%d,\"word_mask\":\"%s\",\"round\":%d,\"total_rounds\":%d,\"time_remaining\":%d,"
-             "\"players\":%s}",
-             room->room_id, room->room_code, room->player_count, room->state,
-             room->current_drawer_idx, word_mask, room->round_number, room->total_rounds, room->time_remaining,
-             players_json);
+             "\"players\":[",
+             room->patch_seq, room->room_id, room->room_code, room->player_count, room->state,
+             room->current_drawer_idx, word_mask, room->round_number, room->total_rounds, room->time_remaining);
     
-    return buffer;
+    // Players are appended in place rather than built and concatenated one by one
+    int added_count = 0;
+    for (int i = 0; i < room->player_count && len < ROOM_STATE_JSON_SIZE; i++) {
+        const Player* player = room->players[i];
+        if (!player) continue;
+        
+        bool is_online = (player->state != PLAYER_DISCONNECTED);
+        len += snprintf(buffer + len, ROOM_STATE_JSON_SIZE - len,
+                        "%s{\"player_id\":%u,\"username\":\"%s\",\"score\":%d,\"is_drawing\":%s,\"online\":%s}",
+                        added_count > 0 ? "," : "",
+                        player->player_id, player->username, player->score,
+                        player->is_drawing ? "true" : "false",
+                        is_online ? "true" : "false");
+        added_count++;
+    }
+    
+    if (len < ROOM_STATE_JSON_SIZE) {
+        snprintf(buffer + len, ROOM_STATE_JSON_SIZE - len, "]}");
+    }
+}
+
+// Returns a copy of the room's cached state, rebuilt only when the room's
+// state_version has moved on since the last call. Caller frees.
+char* json_create_room_state(Room* room) {
+    pthread_mutex_lock(&room_state_mutex);
+    
+    if (!room->state_json) {
+        room->state_json = malloc(ROOM_STATE_JSON_SIZE);
+        if (!room->state_json) {
+            pthread_mutex_unlock(&room_state_mutex);
+            return NULL;
+        }
+        build_room_state(room, room->state_json);
+        room->state_json_version = room->state_version;
+    } else if (room->state_json_version != room->state_version) {
+        build_room_state(room, room->state_json);
+        room->state_json_version = room->state_version;
+    }
+    
+    char* copy = strdup(room->state_json);
+    
+    pthread_mutex_unlock(&room_state_mutex);
+    return copy;
 }
 
 // Simple JSON value extraction (not a full parser)
@@ -122,6 +151,19 @@ int json_get_int(const char* json, const char* key, int* out) {
     return 0;
 }
 
+int json_get_float(const char* json, const char* key, float* out) {
+    char search[128];
+    snprintf(search, sizeof(search), "\"%s\":", key);
+    
+    const char* start = strstr(json, search);
+    if (!start) return -1;
+    
+    start += strlen(search);
+    *out = strtof(start, NULL);
+    
+    return 0;
+}
+
 int json_get_type(const char* json, MessageType* type) {
     int t;
     if (json_get_int(json, "type", &t) == 0) {
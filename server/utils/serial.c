@@ -0,0 +1,120 @@
+#include "serial.h"
+#include <stdlib.h>
+#include <string.h>
+
+void serial_writer_init(SerialWriter* w) {
+    memset(w, 0, sizeof(*w));
+}
+
+void serial_writer_free(SerialWriter* w) {
+    free(w->data);
+    memset(w, 0, sizeof(*w));
+}
+
+void serial_put_bytes(SerialWriter* w, const void* data, size_t len) {
+    if (w->failed) return;
+
+    if (w->len + len > w->cap) {
+        size_t cap = w->cap ? w->cap : 4096;
+        while (cap < w->len + len) cap *= 2;
+        uint8_t* grown = realloc(w->data, cap);
+        if (!grown) {
+            w->failed = true;
+            return;
+        }
+        w->data = grown;
+        w->cap = cap;
+    }
+
+    memcpy(w->data + w->len, data, len);
+    w->len += len;
+}
+
+void serial_put_u8(SerialWriter* w, uint8_t value) {
+    serial_put_bytes(w, &value, sizeof(value));
+}
+
+void serial_put_u32(SerialWriter* w, uint32_t value) {
+    serial_put_bytes(w, &value, sizeof(value));
+}
+
+void serial_put_i32(SerialWriter* w, int32_t value) {
+    serial_put_bytes(w, &value, sizeof(value));
+}
+
+void serial_put_u64(SerialWriter* w, uint64_t value) {
+    serial_put_bytes(w, &value, sizeof(value));
+}
+
+void serial_put_float(SerialWriter* w, float value) {
+    serial_put_bytes(w, &value, sizeof(value));
+}
+
+// Length-prefixed, so either side can change its buffer sizes
+void serial_put_str(SerialWriter* w, const char* str) {
+    uint32_t len = (uint32_t)strlen(str);
+    serial_put_u32(w, len);
+    serial_put_bytes(w, str, len);
+}
+
+void serial_reader_init(SerialReader* r, const void* data, size_t len) {
+    r->data = data;
+    r->len = len;
+    r->pos = 0;
+    r->failed = false;
+}
+
+void serial_get_bytes(SerialReader* r, void* out, size_t len) {
+    if (r->failed || r->len - r->pos < len) {
+        r->failed = true;
+        memset(out, 0, len);
+        return;
+    }
+    memcpy(out, r->data + r->pos, len);
+    r->pos += len;
+}
+
+uint8_t serial_get_u8(SerialReader* r) {
+    uint8_t value;
+    serial_get_bytes(r, &value, sizeof(value));
+    return value;
+}
+
+uint32_t serial_get_u32(SerialReader* r) {
+    uint32_t value;
+    serial_get_bytes(r, &value, sizeof(value));
+    return value;
+}
+
+int32_t serial_get_i32(SerialReader* r) {
+    int32_t value;
+    serial_get_bytes(r, &value, sizeof(value));
+    return value;
+}
+
+uint64_t serial_get_u64(SerialReader* r) {
+    uint64_t value;
+    serial_get_bytes(r, &value, sizeof(value));
+    return value;
+}
+
+float serial_get_float(SerialReader* r) {
+    float value;
+    serial_get_bytes(r, &value, sizeof(value));
+    return value;
+}
+
+// Truncates to out_size - 1 and always NUL-terminates
+void serial_get_str(SerialReader* r, char* out, size_t out_size) {
+    uint32_t len = serial_get_u32(r);
+    if (r->failed || r->len - r->pos < len) {
+        r->failed = true;
+        out[0] = '\0';
+        return;
+    }
+
+    size_t copy = len < out_size - 1 ? len : out_size - 1;
+    memcpy(out, r->data + r->pos, copy);
+    out[copy] = '\0';
+    r->pos += len;
+}
@@ -0,0 +1,45 @@
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Growable byte buffer for state snapshots (see handoff.h). Values are in
+// host byte order: a snapshot only ever travels between processes on the
+// same machine. Errors are sticky, so callers check failed once at the end.
+
+typedef struct {
+    uint8_t* data;
+    size_t len;
+    size_t cap;
+    bool failed;
+} SerialWriter;
+
+typedef struct {
+    const uint8_t* data;
+    size_t len;
+    size_t pos;
+    bool failed;
+} SerialReader;
+
+void serial_writer_init(SerialWriter* w);
+void serial_writer_free(SerialWriter* w);
+void serial_put_bytes(SerialWriter* w, const void* data, size_t len);
+void serial_put_u8(SerialWriter* w, uint8_t value);
+void serial_put_u32(SerialWriter* w, uint32_t value);
+void serial_put_i32(SerialWriter* w, int32_t value);
+void serial_put_u64(SerialWriter* w, uint64_t value);
+void serial_put_float(SerialWriter* w, float value);
+void serial_put_str(SerialWriter* w, const char* str);
+
+void serial_reader_init(SerialReader* r, const void* data, size_t len);
+void serial_get_bytes(SerialReader* r, void* out, size_t len);
+uint8_t serial_get_u8(SerialReader* r);
+uint32_t serial_get_u32(SerialReader* r);
+int32_t serial_get_i32(SerialReader* r);
+uint64_t serial_get_u64(SerialReader* r);
+float serial_get_float(SerialReader* r);
+void serial_get_str(SerialReader* r, char* out, size_t out_size);
+
+#endif // SERIAL_H
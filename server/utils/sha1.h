@@ -0,0 +1,13 @@
+#ifndef SHA1_H
+#define SHA1_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SHA1_DIGEST_SIZE 20
+
+// SHA-1 (FIPS 180-4). Only for protocol handshakes that require it
+// (WebSocket's Sec-WebSocket-Accept), never for anything security-sensitive
+void sha1_compute(const void* data, size_t length, uint8_t digest[SHA1_DIGEST_SIZE]);
+
+#endif // SHA1_H
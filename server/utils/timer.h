@@ -5,6 +5,7 @@
 #include <time.h>
 
 uint64_t get_current_time_ms();
+uint64_t get_monotonic_time_ms();
 void sleep_ms(int milliseconds);
 
 #endif // TIMER_H
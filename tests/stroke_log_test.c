@@ -0,0 +1,65 @@
+// Undo against a full stroke log (server/game/game_logic.c): once a stroke
+// has reached the canvas but not the log, undo is refused until a clear,
+// since the raster it rebuilds from the log would lose that stroke.
+#include "../server/game/game_logic.h"
+#include "../server/game/matchmaking.h"
+#include <stdio.h>
+#include <string.h>
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        printf("[FAIL] %s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        failures++; \
+    } \
+} while (0)
+
+static void draw_group(Room* room, uint32_t group_id, int count) {
+    for (int i = 0; i < count; i++) {
+        Stroke stroke = { 0, (float)(i % 700), (float)group_id, (float)(i % 700) + 1, (float)group_id + 1,
+                          1, 3, group_id, (uint64_t)i };
+        add_strokes(room, &stroke, 1);
+    }
+}
+
+int main() {
+    init_matchmaking();
+    Room* room = create_private_room();
+    StrokeGroup group;
+    
+    // Undo works while the log has room
+    draw_group(room, 1, MAX_STROKES - 20);
+    draw_group(room, 2, 10);
+    CHECK(undo_last_stroke_group(room, &group) == 0 && group.group_id == 2,
+          "undo before the log filled was refused");
+    CHECK(!room->stroke_log_overflowed, "overflowed with %d strokes", room->stroke_count);
+    
+    // Exactly full is not overflowed
+    draw_group(room, 3, 20);
+    CHECK(room->stroke_count == MAX_STROKES && !room->stroke_log_overflowed,
+          "full log: %d strokes, overflowed %d", room->stroke_count, room->stroke_log_overflowed);
+    
+    // The next group reaches only the canvas; undoing the last stored
+    // group would now rebuild the raster without it
+    draw_group(room, 4, 5);
+    CHECK(room->stroke_log_overflowed, "log overflowed without the flag");
+    CHECK(undo_last_stroke_group(room, &group) < 0, "undo allowed after the log overflowed");
+    CHECK(room->stroke_count == MAX_STROKES, "refused undo truncated the log to %d", room->stroke_count);
+    
+    // A clear starts a canvas undo works on again
+    clear_strokes(room);
+    CHECK(!room->stroke_log_overflowed, "clear left the log overflowed");
+    draw_group(room, 5, 10);
+    CHECK(undo_last_stroke_group(room, &group) == 0 && group.group_id == 5,
+          "undo after a clear was refused");
+    
+    if (failures > 0) {
+        printf("[TEST] stroke_log: %d failed\n", failures);
+        return 1;
+    }
+    printf("[TEST] stroke_log: ok\n");
+    return 0;
+}
@@ -0,0 +1,134 @@
+// Batched UDP sends (server/udp/udp_broadcast.h): whatever a batch queues
+// reaches each destination whole, in order and at its own length, across
+// the flushes a full batch forces and whether or not runs of equal-sized
+// datagrams go out as one segmented send.
+#include "../server/udp/udp_broadcast.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#define RECEIVERS 2
+#define MAX_EXPECTED 128
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        printf("[FAIL] %s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        failures++; \
+    } \
+} while (0)
+
+typedef struct {
+    int fd;
+    struct sockaddr_in addr;
+    size_t lens[MAX_EXPECTED];  // What was queued for it, in order
+    int count;
+} Receiver;
+
+static Receiver receivers[RECEIVERS];
+
+static int open_receiver(Receiver* r) {
+    r->fd = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&r->addr, 0, sizeof(r->addr));
+    r->addr.sin_family = AF_INET;
+    r->addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(r->addr);
+    r->count = 0;
+    return r->fd < 0 || bind(r->fd, (struct sockaddr*)&r->addr, sizeof(r->addr)) < 0 ||
+           getsockname(r->fd, (struct sockaddr*)&r->addr, &len) < 0 ? -1 : 0;
+}
+
+// Datagram i to r: len bytes, each one (i & 0xff), the first two holding i
+static void queue(UdpSendBatch* batch, Receiver* r, int i, size_t len) {
+    uint8_t data[UDP_MAX_DATAGRAM];
+    memset(data, i & 0xff, len);
+    data[0] = (uint8_t)(i >> 8);
+    data[1] = (uint8_t)i;
+    
+    const void* payload = udp_batch_store(batch, data, len, 1);
+    CHECK(payload != NULL, "datagram %d not stored", i);
+    if (payload) udp_batch_queue(batch, payload, len, &r->addr);
+    r->lens[r->count++] = len;
+}
+
+// Every receiver got exactly what was queued for it; resets them
+static void expect_received(const char* what) {
+    usleep(20000);
+    for (int k = 0; k < RECEIVERS; k++) {
+        Receiver* r = &receivers[k];
+        uint8_t buffer[UDP_GSO_MAX_BYTES];
+        int got = 0;
+        int prev = -1;
+        int len;
+        while ((len = recv(r->fd, buffer, sizeof(buffer), MSG_DONTWAIT)) >= 0) {
+            int i = (buffer[0] << 8) | buffer[1];
+            if (got < r->count) {
+                CHECK((size_t)len == r->lens[got], "%s: receiver %d datagram %d is %d bytes, expected %zu",
+                      what, k, got, len, r->lens[got]);
+            }
+            CHECK(i > prev, "%s: receiver %d got datagram %d after %d", what, k, i, prev);
+            CHECK(len < 3 || buffer[len - 1] == (uint8_t)(i & 0xff),
+                  "%s: receiver %d datagram %d has the wrong tail", what, k, i);
+            prev = i;
+            got++;
+        }
+        CHECK(got == r->count, "%s: receiver %d got %d datagrams, expected %d", what, k, got, r->count);
+        r->count = 0;
+    }
+}
+
+int main() {
+    for (int k = 0; k < RECEIVERS; k++) {
+        if (open_receiver(&receivers[k]) < 0) {
+            perror("receiver socket");
+            return 1;
+        }
+    }
+    
+    UdpSendBatch batch;
+    udp_batch_init(&batch, socket(AF_INET, SOCK_DGRAM, 0));
+    printf("[TEST] segmentation offload %s\n", batch.gso ? "on" : "off");
+    
+    // Runs for one destination: equal sizes share a send, a shorter
+    // datagram ends its run, a longer one starts the next
+    size_t sizes[] = { 500, 500, 500, 200, 500, 500, 1200, 37, 37, 37, 37, 36, 2 };
+    int n = sizeof(sizes) / sizeof(sizes[0]);
+    for (int i = 0; i < n; i++) {
+        queue(&batch, &receivers[0], i, sizes[i]);
+    }
+    udp_batch_flush(&batch);
+    expect_received("one destination");
+    
+    // Interleaved destinations keep each one's order
+    for (int i = 0; i < 40; i++) {
+        queue(&batch, &receivers[i % 3 == 0 ? 1 : 0], i, i < 20 ? 300 : 120 + (i % 4));
+    }
+    udp_batch_flush(&batch);
+    expect_received("interleaved");
+    
+    // More than the pool holds: udp_batch_store() flushes part way
+    for (int i = 0; i < 100; i++) {
+        queue(&batch, &receivers[i % 2], i, 1000);
+    }
+    udp_batch_flush(&batch);
+    expect_received("over the pool");
+    
+    // And with segmentation off, the same datagrams one message each
+    batch.gso = false;
+    for (int i = 0; i < n; i++) {
+        queue(&batch, &receivers[1], i, sizes[i]);
+    }
+    udp_batch_flush(&batch);
+    expect_received("without offload");
+    
+    if (failures > 0) {
+        printf("[TEST] udp_batch: %d failed\n", failures);
+        return 1;
+    }
+    printf("[TEST] udp_batch: ok\n");
+    return 0;
+}
@@ -0,0 +1,189 @@
+// Parity (server/udp/udp_fec.h) against the proxy's decoder
+// (client_proxy/utils/udp_recovery.h): with one stroke datagram of every
+// group dropped, the parity the server sends rebuilds it byte for byte,
+// for full groups and for one a pause closed short.
+#include "../server/udp/udp_broadcast.h"
+#include "../server/udp/udp_fec.h"
+#include "../server/game/matchmaking.h"
+#include "../server/utils/timer.h"
+#include "../client_proxy/utils/udp_recovery.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#define DATAGRAMS 32
+#define UDP_LOSS 0.03f  // Receiver's loss estimate
+#define GROUP_SIZE 8    // Group size udp_fec.c picks for that loss
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        printf("[FAIL] %s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        failures++; \
+    } \
+} while (0)
+
+typedef struct {
+    UdpHeader header;
+    uint8_t payload[UDP_MAX_PAYLOAD];
+    size_t len;
+} Datagram;
+
+static int receiver_fd;
+static Datagram received[DATAGRAMS * 2];
+static int received_count;
+
+static void receive_all() {
+    usleep(20000);
+    uint8_t buffer[UDP_MAX_DATAGRAM];
+    int len;
+    while ((len = recv(receiver_fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+        const uint8_t* payload;
+        Datagram* d = &received[received_count];
+        if (received_count == DATAGRAMS * 2 ||
+            udp_wire_decode(buffer, len, &d->header, &payload, &d->len) < 0) {
+            continue;
+        }
+        memcpy(d->payload, payload, d->len);
+        received_count++;
+    }
+}
+
+static const Datagram* find_stroke(uint32_t seq) {
+    for (int i = 0; i < received_count; i++) {
+        if (received[i].header.type == UDP_STROKE && received[i].header.seq == seq) return &received[i];
+    }
+    return NULL;
+}
+
+// Feed what arrived, minus the stroke datagrams in dropped, to a fresh
+// decoder; returns how many of them the parity rebuilt exactly
+static int recover(const uint32_t* dropped, int dropped_count, const char* what) {
+    UdpRecovery rec;
+    memset(&rec, 0, sizeof(rec));
+    int rebuilt_count = 0;
+    
+    for (int i = 0; i < received_count; i++) {
+        const Datagram* d = &received[i];
+        if (d->header.type == UDP_STROKE) {
+            bool drop = false;
+            for (int k = 0; k < dropped_count; k++) {
+                if (dropped[k] == d->header.seq) drop = true;
+            }
+            if (!drop) udp_recovery_store(&rec, d->header.room_id, d->header.seq, d->payload, d->len);
+            continue;
+        }
+        if (d->header.type != UDP_FEC) continue;
+        
+        uint8_t rebuilt[UDP_MAX_PAYLOAD];
+        uint32_t seq = 0;
+        int len = udp_recovery_rebuild(&rec, d->header.room_id, d->header.seq, d->payload, d->len,
+                                       &seq, rebuilt, sizeof(rebuilt));
+        if (len < 0) continue;
+        
+        const Datagram* original = find_stroke(seq);
+        CHECK(original != NULL, "%s: rebuilt seq %u was never sent", what, seq);
+        if (!original) continue;
+        CHECK((size_t)len == original->len && memcmp(rebuilt, original->payload, len) == 0,
+              "%s: seq %u rebuilt as %d bytes, sent as %zu", what, seq, len, original->len);
+        udp_recovery_store(&rec, d->header.room_id, seq, rebuilt, len);
+        rebuilt_count++;
+    }
+    return rebuilt_count;
+}
+
+int main() {
+    receiver_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in receiver_addr;
+    memset(&receiver_addr, 0, sizeof(receiver_addr));
+    receiver_addr.sin_family = AF_INET;
+    receiver_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(receiver_addr);
+    if (receiver_fd < 0 || bind(receiver_fd, (struct sockaddr*)&receiver_addr, sizeof(receiver_addr)) < 0 ||
+        getsockname(receiver_fd, (struct sockaddr*)&receiver_addr, &addr_len) < 0) {
+        perror("receiver socket");
+        return 1;
+    }
+    
+    UdpSendBatch batch;
+    udp_batch_init(&batch, socket(AF_INET, SOCK_DGRAM, 0));
+    
+    init_matchmaking();
+    udp_fec_set_enabled(true);
+    Room* room = create_private_room();
+    
+    Player drawer, receiver;
+    memset(&drawer, 0, sizeof(drawer));
+    memset(&receiver, 0, sizeof(receiver));
+    drawer.player_id = 1;
+    drawer.fd = receiver_fd;
+    receiver.player_id = 2;
+    receiver.fd = receiver_fd;
+    receiver.udp_bound = true;
+    receiver.udp_addr = receiver_addr;
+    receiver.udp_loss = UDP_LOSS;
+    room->players[0] = &drawer;
+    room->players[1] = &receiver;
+    room->player_count = 2;
+    
+    // Payloads of different lengths, so the parity has padding to undo
+    for (int i = 0; i < DATAGRAMS; i++) {
+        Stroke strokes[8];
+        int count = 1 + (i * 5) % 8;
+        for (int k = 0; k < count; k++) {
+            Stroke stroke = { 0, 10.0f * k + i, 20.0f + k, 11.0f * k, 300.0f - i, (uint32_t)(k % 4),
+                              (uint8_t)(2 + k), (uint32_t)i, 0 };
+            strokes[k] = stroke;
+        }
+        broadcast_strokes_to_room(&batch, room, strokes, count, -1, &drawer);
+    }
+    udp_batch_flush(&batch);
+    receive_all();
+    
+    int parity_count = 0;
+    for (int i = 0; i < received_count; i++) {
+        if (received[i].header.type == UDP_FEC) parity_count++;
+    }
+    CHECK(received_count == DATAGRAMS + DATAGRAMS / GROUP_SIZE,
+          "sent %d datagrams with %d parity, expected %d and %d",
+          received_count, parity_count, DATAGRAMS + DATAGRAMS / GROUP_SIZE, DATAGRAMS / GROUP_SIZE);
+    
+    // One lost per group, at a different place in each
+    uint32_t dropped[DATAGRAMS / GROUP_SIZE];
+    for (int g = 0; g < DATAGRAMS / GROUP_SIZE; g++) {
+        dropped[g] = (uint32_t)(g * GROUP_SIZE + (g * 3) % GROUP_SIZE + 1);
+    }
+    int rebuilt = recover(dropped, DATAGRAMS / GROUP_SIZE, "one per group");
+    CHECK(rebuilt == DATAGRAMS / GROUP_SIZE, "one per group: rebuilt %d of %d", rebuilt, DATAGRAMS / GROUP_SIZE);
+    
+    // Two lost in a group is beyond XOR parity
+    uint32_t two[] = { 2, 5 };
+    CHECK(recover(two, 2, "two in a group") == 0, "two in a group: rebuilt something");
+    
+    // Nothing lost, nothing to rebuild
+    CHECK(recover(NULL, 0, "none lost") == 0, "none lost: rebuilt something");
+    
+    // A group a pause closes short
+    received_count = 0;
+    for (int i = 0; i < 3; i++) {
+        Stroke stroke = { 0, 1.0f + i, 2.0f, 3.0f, 4.0f * i, 1, 3, (uint32_t)(100 + i), 0 };
+        broadcast_strokes_to_room(&batch, room, &stroke, 1, -1, &drawer);
+    }
+    usleep((UDP_FEC_MAX_SPAN_MS + 10) * 1000);
+    CHECK(udp_fec_expire(&batch, room, get_current_time_ms()) == 0, "short group: still open");
+    udp_batch_flush(&batch);
+    receive_all();
+    uint32_t middle[] = { DATAGRAMS + 2 };
+    CHECK(recover(middle, 1, "short group") == 1, "short group: not rebuilt");
+    
+    if (failures > 0) {
+        printf("[TEST] udp_fec: %d failed\n", failures);
+        return 1;
+    }
+    printf("[TEST] udp_fec: ok\n");
+    return 0;
+}
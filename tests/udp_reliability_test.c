@@ -0,0 +1,165 @@
+// Seq/ack and selective resend (server/udp/udp_reliability.h): a receiver
+// acks with gaps and gets back exactly the datagrams it is missing, minus
+// whatever an undo or clear has superseded, before and after the room's
+// send window goes through a handoff snapshot.
+#include "../server/udp/udp_broadcast.h"
+#include "../server/udp/udp_reliability.h"
+#include "../server/game/matchmaking.h"
+#include "../server/utils/serial.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#define STROKE_COUNT 10
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        printf("[FAIL] %s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        failures++; \
+    } \
+} while (0)
+
+static int receiver_fd;
+static struct sockaddr_in receiver_addr;
+
+// Seqs of the stroke datagrams waiting on the receiver's socket, in order
+static int receive_seqs(uint32_t* seqs, int max) {
+    int count = 0;
+    uint8_t buffer[UDP_MAX_DATAGRAM];
+    usleep(20000);
+    int len;
+    while ((len = recv(receiver_fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+        UdpHeader header;
+        const uint8_t* payload;
+        size_t payload_len;
+        if (udp_wire_decode(buffer, len, &header, &payload, &payload_len) < 0) continue;
+        if (header.type == UDP_STROKE && count < max) seqs[count++] = header.seq;
+    }
+    return count;
+}
+
+static uint32_t bits_except(uint32_t ack, const uint32_t* missing, int missing_count) {
+    uint32_t bits = 0;
+    for (uint32_t seq = 1; seq < ack; seq++) {
+        bool lost = false;
+        for (int i = 0; i < missing_count; i++) {
+            if (missing[i] == seq) lost = true;
+        }
+        if (!lost) bits |= 1u << (ack - seq - 1);
+    }
+    return bits;
+}
+
+static void expect_resent(UdpSendBatch* batch, Room* room, Player* receiver, uint32_t ack,
+                          uint32_t ack_bits, const uint32_t* expected, int expected_count,
+                          const char* what) {
+    udp_reliable_on_ack(batch, room, receiver, ack, ack_bits);
+    udp_batch_flush(batch);
+    
+    uint32_t seqs[STROKE_COUNT * 2];
+    int count = receive_seqs(seqs, STROKE_COUNT * 2);
+    CHECK(count == expected_count, "%s: resent %d datagrams, expected %d", what, count, expected_count);
+    for (int i = 0; i < count && i < expected_count; i++) {
+        CHECK(seqs[i] == expected[i], "%s: resent seq %u, expected %u", what, seqs[i], expected[i]);
+    }
+}
+
+int main() {
+    receiver_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&receiver_addr, 0, sizeof(receiver_addr));
+    receiver_addr.sin_family = AF_INET;
+    receiver_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(receiver_addr);
+    if (receiver_fd < 0 || bind(receiver_fd, (struct sockaddr*)&receiver_addr, sizeof(receiver_addr)) < 0 ||
+        getsockname(receiver_fd, (struct sockaddr*)&receiver_addr, &addr_len) < 0) {
+        perror("receiver socket");
+        return 1;
+    }
+    
+    UdpSendBatch batch;
+    udp_batch_init(&batch, socket(AF_INET, SOCK_DGRAM, 0));
+    
+    init_matchmaking();
+    Room* room = create_private_room();
+    
+    Player drawer, receiver;
+    memset(&drawer, 0, sizeof(drawer));
+    memset(&receiver, 0, sizeof(receiver));
+    drawer.player_id = 1;
+    drawer.fd = receiver_fd;
+    receiver.player_id = 2;
+    receiver.fd = receiver_fd;
+    receiver.udp_bound = true;
+    receiver.udp_addr = receiver_addr;
+    room->players[0] = &drawer;
+    room->players[1] = &receiver;
+    room->player_count = 2;
+    
+    // One stroke per datagram, stored in the log like add_strokes() does
+    for (int i = 0; i < STROKE_COUNT; i++) {
+        Stroke stroke = { 0, 10.0f + i, 20.0f, 11.0f + i, 21.0f, 1, 3, (uint32_t)i, 1000 + i };
+        room->strokes[room->stroke_count++] = stroke;
+        broadcast_strokes_to_room(&batch, room, &stroke, 1, i, &drawer);
+    }
+    udp_batch_flush(&batch);
+    
+    uint32_t seqs[STROKE_COUNT];
+    int count = receive_seqs(seqs, STROKE_COUNT);
+    CHECK(count == STROKE_COUNT, "first send: got %d datagrams", count);
+    for (int i = 0; i < count; i++) {
+        CHECK(seqs[i] == (uint32_t)i + 1, "first send: datagram %d has seq %u", i, seqs[i]);
+    }
+    
+    // Seqs 3, 5 and 8 lost; too young to resend yet
+    uint32_t missing[] = { 3, 5, 8 };
+    uint32_t ack_bits = bits_except(STROKE_COUNT, missing, 3);
+    expect_resent(&batch, room, &receiver, STROKE_COUNT, ack_bits, NULL, 0, "in flight");
+    
+    usleep((UDP_RESEND_INTERVAL_MS + 10) * 1000);
+    expect_resent(&batch, room, &receiver, STROKE_COUNT, ack_bits, missing, 3, "gaps");
+    
+    // Each copy gets a round trip before the next
+    expect_resent(&batch, room, &receiver, STROKE_COUNT, ack_bits, NULL, 0, "just resent");
+    
+    // What a handoff carries has to resend the same way in the new process
+    SerialWriter w;
+    serial_writer_init(&w);
+    matchmaking_export(&w);
+    init_matchmaking();
+    SerialReader r;
+    serial_reader_init(&r, w.data, w.len);
+    CHECK(matchmaking_import(&r) == 0 && !r.failed, "handoff: import failed");
+    serial_writer_free(&w);
+    room->players[0] = &drawer;
+    room->players[1] = &receiver;
+    
+    usleep((UDP_RESEND_INTERVAL_MS + 10) * 1000);
+    expect_resent(&batch, room, &receiver, STROKE_COUNT, ack_bits, missing, 3, "after handoff");
+    
+    // An undo removed the strokes seq 8 carried
+    usleep((UDP_RESEND_INTERVAL_MS + 10) * 1000);
+    room->stroke_count = 7;
+    expect_resent(&batch, room, &receiver, STROKE_COUNT, ack_bits, missing, 2, "after undo");
+    
+    // A clear wipes everything still missing
+    usleep((UDP_RESEND_INTERVAL_MS + 10) * 1000);
+    room->canvas_epoch++;
+    expect_resent(&batch, room, &receiver, STROKE_COUNT, ack_bits, NULL, 0, "after clear");
+    
+    // An older, reordered ack is ignored rather than read as new losses
+    room->canvas_epoch--;
+    usleep((UDP_RESEND_INTERVAL_MS + 10) * 1000);
+    expect_resent(&batch, room, &receiver, 4, 0, NULL, 0, "stale ack");
+    
+    if (failures > 0) {
+        printf("[TEST] udp_reliability: %d failed\n", failures);
+        return 1;
+    }
+    printf("[TEST] udp_reliability: ok\n");
+    return 0;
+}
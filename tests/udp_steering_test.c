@@ -0,0 +1,91 @@
+// Room steering (server/udp/udp_server.c): the program attached to the
+// first worker's socket steers every datagram the reuseport group gets to
+// socket room_id % workers, whichever client port it comes from.
+#include "../server/udp/udp_server.h"
+#include "../server/udp/udp_wire.h"
+#include "../server/game/matchmaking.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#define TEST_PORT 39091
+#define SENDERS 8
+#define ROOMS 48
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        printf("[FAIL] %s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        failures++; \
+    } \
+} while (0)
+
+static void check_steering(int workers, int port) {
+    if (udp_server_start(port, workers) < 0) {
+        CHECK(false, "%d workers: server did not start", workers);
+        return;
+    }
+    
+    // Stop the workers but keep the sockets, so the datagrams stay queued
+    // on whichever one the kernel picked
+    int fds[UDP_MAX_WORKERS];
+    int count = udp_server_detach(fds, UDP_MAX_WORKERS);
+    CHECK(count == workers, "%d workers: detached %d sockets", workers, count);
+    
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    server_addr.sin_port = htons(port);
+    
+    // Every sender (a port of its own, so a flow hash would spread them)
+    // sends for every room
+    for (int s = 0; s < SENDERS; s++) {
+        int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        for (uint32_t room_id = 1; room_id <= ROOMS; room_id++) {
+            UdpHeader header = { UDP_ACK, room_id, 0, 0, 0 };
+            uint8_t datagram[UDP_HEADER_SIZE];
+            int len = udp_wire_encode(&header, NULL, 0, datagram, sizeof(datagram));
+            sendto(fd, datagram, len, 0, (struct sockaddr*)&server_addr, sizeof(server_addr));
+        }
+        close(fd);
+    }
+    usleep(20000);
+    
+    int total = 0;
+    for (int i = 0; i < count; i++) {
+        uint8_t buffer[UDP_MAX_DATAGRAM];
+        int len;
+        while ((len = recv(fds[i], buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+            UdpHeader header;
+            const uint8_t* payload;
+            size_t payload_len;
+            CHECK(udp_wire_decode(buffer, len, &header, &payload, &payload_len) == 0,
+                  "%d workers: undecodable datagram", workers);
+            CHECK(header.room_id % (uint32_t)workers == (uint32_t)i,
+                  "%d workers: room %u landed on socket %d", workers, header.room_id, i);
+            total++;
+        }
+    }
+    CHECK(total == SENDERS * ROOMS, "%d workers: received %d of %d", workers, total, SENDERS * ROOMS);
+    
+    udp_server_stop();
+}
+
+int main() {
+    init_matchmaking();
+    
+    check_steering(2, TEST_PORT);
+    check_steering(3, TEST_PORT + 1);
+    
+    if (failures > 0) {
+        printf("[TEST] udp_steering: %d failed\n", failures);
+        return 1;
+    }
+    printf("[TEST] udp_steering: ok\n");
+    return 0;
+}
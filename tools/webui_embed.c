@@ -0,0 +1,287 @@
+// Build step: compiles webui/ into a C source file holding every file as a
+// byte array, plus a gzip copy and ETag, for server/http/webui_assets.h.
+//
+//   webui_embed <webui_dir> <output.c>
+//
+// Non-HTML files are also listed under a name carrying a hash of their
+// contents (style.css -> style.5e1f03aa.css). References to them in the HTML
+// pages are rewritten to those names before the pages are hashed.
+
+#include "http/mime.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#define MAX_FILES 128
+#define MAX_NAME 256
+
+typedef struct {
+    char name[MAX_NAME];
+    char fingerprinted[MAX_NAME + 16];  // Empty for HTML pages
+    unsigned char* data;
+    size_t len;
+    uint64_t hash;
+    unsigned char* gzip;
+    size_t gzip_len;
+} EmbedFile;
+
+static EmbedFile files[MAX_FILES];
+static int file_count = 0;
+
+static uint64_t hash_contents(const unsigned char* data, size_t len) {
+    uint64_t hash = 0xcbf29ce484222325ULL;  // FNV-1a, as the server's static cache
+    for (size_t i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static bool is_html(const char* name) {
+    const char* ext = strrchr(name, '.');
+    return ext && strcmp(ext, ".html") == 0;
+}
+
+static bool is_compressible(const char* mime_type) {
+    return strncmp(mime_type, "text/", 5) == 0 ||
+           strcmp(mime_type, "application/javascript") == 0 ||
+           strcmp(mime_type, "application/json") == 0 ||
+           strcmp(mime_type, "image/svg+xml") == 0;
+}
+
+static int load_file(const char* dir, const char* name) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+
+    EmbedFile* file = &files[file_count];
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    file->data = malloc(len > 0 ? len : 1);
+    if (!file->data || fread(file->data, 1, len, f) != (size_t)len) {
+        fprintf(stderr, "Failed to read %s\n", path);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+
+    snprintf(file->name, sizeof(file->name), "%s", name);
+    file->len = (size_t)len;
+    file_count++;
+    return 0;
+}
+
+static void fingerprint(EmbedFile* file) {
+    file->hash = hash_contents(file->data, file->len);
+
+    const char* ext = strrchr(file->name, '.');
+    size_t stem = ext ? (size_t)(ext - file->name) : strlen(file->name);
+    snprintf(file->fingerprinted, sizeof(file->fingerprinted), "%.*s.%08x%s",
+             (int)stem, file->name, (unsigned)(file->hash >> 32), ext ? ext : "");
+}
+
+static const EmbedFile* find_asset(const char* value, size_t len) {
+    for (int i = 0; i < file_count; i++) {
+        if (files[i].fingerprinted[0] && strlen(files[i].name) == len &&
+            memcmp(files[i].name, value, len) == 0) {
+            return &files[i];
+        }
+    }
+    return NULL;
+}
+
+// Point quoted references ("main.js", "/main.js", "./main.js") at the
+// fingerprinted names
+static void rewrite_references(EmbedFile* page) {
+    size_t cap = page->len + (size_t)file_count * 64 + 1;
+    unsigned char* out = malloc(cap);
+    size_t out_len = 0;
+
+    for (size_t i = 0; i < page->len; ) {
+        unsigned char c = page->data[i];
+        if (c != '"' && c != '\'') {
+            out[out_len++] = c;
+            i++;
+            continue;
+        }
+
+        size_t end = i + 1;
+        while (end < page->len && end - i < MAX_NAME &&
+               page->data[end] != c && page->data[end] != '\n') {
+            end++;
+        }
+
+        const EmbedFile* asset = NULL;
+        size_t prefix = 0;
+        if (end < page->len && page->data[end] == c) {
+            const char* value = (const char*)page->data + i + 1;
+            size_t len = end - i - 1;
+            if (len > 2 && value[0] == '.' && value[1] == '/') prefix = 2;
+            else if (len > 1 && value[0] == '/') prefix = 1;
+            asset = find_asset(value + prefix, len - prefix);
+        }
+
+        if (!asset) {
+            out[out_len++] = c;
+            i++;
+            continue;
+        }
+
+        size_t fp_len = strlen(asset->fingerprinted);
+        if (out_len + fp_len + prefix + 2 > cap) {
+            cap = (out_len + fp_len + prefix + 2) * 2;
+            out = realloc(out, cap);
+        }
+        out[out_len++] = c;
+        memcpy(out + out_len, page->data + i + 1, prefix);
+        out_len += prefix;
+        memcpy(out + out_len, asset->fingerprinted, fp_len);
+        out_len += fp_len;
+        out[out_len++] = c;
+        i = end + 1;
+    }
+
+    free(page->data);
+    page->data = out;
+    page->len = out_len;
+}
+
+// gzip once, at the highest level; kept only if it saves 10%
+static void compress_file(EmbedFile* file) {
+    if (!is_compressible(get_mime_type(file->name))) return;
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return;
+    }
+    size_t bound = deflateBound(&zs, file->len);
+    unsigned char* out = malloc(bound);
+    zs.next_in = file->data;
+    zs.avail_in = file->len;
+    zs.next_out = out;
+    zs.avail_out = bound;
+    int rc = deflate(&zs, Z_FINISH);
+    size_t len = zs.total_out;
+    deflateEnd(&zs);
+
+    if (rc != Z_STREAM_END || len >= file->len - file->len / 10) {
+        free(out);
+        return;
+    }
+    file->gzip = out;
+    file->gzip_len = len;
+}
+
+static void write_array(FILE* out, const char* name, const unsigned char* data, size_t len) {
+    fprintf(out, "static const unsigned char %s[] = {", name);
+    if (len == 0) fprintf(out, "0");
+    for (size_t i = 0; i < len; i++) {
+        fprintf(out, "%s0x%02x,", i % 16 == 0 ? "\n    " : " ", data[i]);
+    }
+    fprintf(out, "\n};\n\n");
+}
+
+static void write_entry(FILE* out, int index, const char* path, bool immutable) {
+    const EmbedFile* file = &files[index];
+    fprintf(out, "    {\"/%s\", asset_%d, %zu, ", path, index, file->len);
+    if (file->gzip) {
+        fprintf(out, "asset_%d_gz, %zu, ", index, file->gzip_len);
+    } else {
+        fprintf(out, "NULL, 0, ");
+    }
+    fprintf(out, "\"\\\"%016llx\\\"\", \"\\\"%016llx-gz\\\"\", %s},\n",
+            (unsigned long long)file->hash, (unsigned long long)file->hash,
+            immutable ? "true" : "false");
+}
+
+static int select_file(const struct dirent* entry) {
+    return entry->d_name[0] != '.';
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <webui_dir> <output.c>\n", argv[0]);
+        return 1;
+    }
+    const char* dir = argv[1];
+
+    // Sorted, so the output only changes when the files do
+    struct dirent** entries;
+    int n = scandir(dir, &entries, select_file, alphasort);
+    if (n < 0) {
+        perror(dir);
+        return 1;
+    }
+    for (int i = 0; i < n; i++) {
+        char path[1024];
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", dir, entries[i]->d_name);
+        if (stat(path, &st) == 0 && S_ISREG(st.st_mode) && file_count < MAX_FILES) {
+            if (load_file(dir, entries[i]->d_name) < 0) return 1;
+        }
+        free(entries[i]);
+    }
+    free(entries);
+
+    // Assets first, so the pages can refer to their final names
+    for (int i = 0; i < file_count; i++) {
+        if (!is_html(files[i].name)) fingerprint(&files[i]);
+    }
+    for (int i = 0; i < file_count; i++) {
+        if (is_html(files[i].name)) {
+            rewrite_references(&files[i]);
+            files[i].hash = hash_contents(files[i].data, files[i].len);
+        }
+        compress_file(&files[i]);
+    }
+
+    FILE* out = fopen(argv[2], "w");
+    if (!out) {
+        perror(argv[2]);
+        return 1;
+    }
+
+    fprintf(out, "// Generated from %s/ by tools/webui_embed; do not edit\n\n", dir);
+    fprintf(out, "#include \"http/webui_assets.h\"\n\n");
+    for (int i = 0; i < file_count; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "asset_%d", i);
+        write_array(out, name, files[i].data, files[i].len);
+        if (files[i].gzip) {
+            snprintf(name, sizeof(name), "asset_%d_gz", i);
+            write_array(out, name, files[i].gzip, files[i].gzip_len);
+        }
+    }
+
+    // Plain names stay reachable for anything that still links to them
+    int entry_count = 0;
+    fprintf(out, "const WebuiAsset webui_assets[] = {\n");
+    for (int i = 0; i < file_count; i++) {
+        if (files[i].fingerprinted[0]) {
+            write_entry(out, i, files[i].fingerprinted, true);
+            entry_count++;
+        }
+        write_entry(out, i, files[i].name, false);
+        entry_count++;
+    }
+    fprintf(out, "};\n\nconst int webui_asset_count = %d;\n", entry_count);
+
+    if (fclose(out) != 0) {
+        perror(argv[2]);
+        return 1;
+    }
+    printf("[EMBED] %d files from %s/ -> %s\n", file_count, dir, argv[2]);
+    return 0;
+}
@@ -9,8 +9,18 @@ class DrawingCanvas {
         this.colorIndex = 0;  // Default to black
         this.lineWidth = 5;
         this.enabled = false;
-        this.strokeBuffer = [];
-        this.strokeId = 0;
+        this.strokeBuffer = [];  // Segments drawn since the last animation frame
+        this.flushFrame = null;
+        this.MAX_BATCH = 64;     // STROKE_BATCH_MAX on the server
+        this.groupId = 0;     // Bumped on every pen-down; lets the server undo whole strokes
+        this.history = [];    // Strokes drawn on top of baseCanvas, for local redraw on undo
+        this.roundStart = Date.now();  // Base for relative stroke timestamps
+        
+        // Snapshot tiles from the server land here so undo can redraw on top of them
+        this.baseCanvas = document.createElement('canvas');
+        this.baseCanvas.width = this.canvas.width;
+        this.baseCanvas.height = this.canvas.height;
+        this.baseCtx = this.baseCanvas.getContext('2d');
         
         // Color palette (index -> hex)
         this.colors = [
@@ -67,6 +77,7 @@ class DrawingCanvas {
         if (!this.enabled) return;
         
         this.isDrawing = true;
+        this.groupId++;
         const rect = this.canvas.getBoundingClientRect();
         this.lastX = e.clientX - rect.left;
         this.lastY = e.clientY - rect.top;
@@ -81,28 +92,56 @@ class DrawingCanvas {
         
         // Draw locally
         this.drawLine(this.lastX, this.lastY, x, y, this.colors[this.colorIndex], this.lineWidth);
+        this.history.push({ x1: this.lastX, y1: this.lastY, x2: x, y2: y,
+                            color: this.colorIndex, thickness: this.lineWidth, group: this.groupId });
         
-        // Send stroke to server via WebSocket
+        // Send stroke to server via WebSocket on the next frame
         if (window.game && window.game.ws.connected) {
             const stroke = {
-                stroke_id: this.strokeId++,
                 x1: this.lastX,
                 y1: this.lastY,
                 x2: x,
                 y2: y,
                 color: this.colorIndex,
                 thickness: this.lineWidth,
+                group: this.groupId,
                 timestamp: Date.now()
             };
             
-            console.log('[DRAW] Sending stroke:', stroke);
-            window.game.ws.send(UDP_TYPE.STROKE, stroke);
+            this.queueStroke(stroke);
         }
         
         this.lastX = x;
         this.lastY = y;
     }
     
+    // Segments from one animation frame go out as a single packed message
+    queueStroke(stroke) {
+        this.strokeBuffer.push(stroke);
+        if (this.flushFrame === null) {
+            this.flushFrame = requestAnimationFrame(() => this.flushStrokes());
+        }
+    }
+    
+    flushStrokes() {
+        if (this.flushFrame !== null) {
+            cancelAnimationFrame(this.flushFrame);
+            this.flushFrame = null;
+        }
+        if (this.strokeBuffer.length === 0) return;
+        
+        if (window.game && window.game.ws.connected) {
+            // Keep each message within the server's per-message segment limit
+            for (let i = 0; i < this.strokeBuffer.length; i += this.MAX_BATCH) {
+                const batch = this.strokeBuffer.slice(i, i + this.MAX_BATCH);
+                window.game.ws.send(UDP_TYPE.STROKE_PACKED, {
+                    strokes: StrokeCodec.encode(batch, this.roundStart)
+                });
+            }
+        }
+        this.strokeBuffer = [];
+    }
+    
     stopDrawing() {
         this.isDrawing = false;
     }
@@ -119,15 +158,66 @@ class DrawingCanvas {
         this.ctx.stroke();
     }
     
-    drawStroke(stroke) {
+    drawStroke(stroke, record = true) {
         const colorIndex = stroke.color || 0;
         const color = this.colors[colorIndex] || this.colors[0];
         this.drawLine(stroke.x1, stroke.y1, stroke.x2, stroke.y2, color, stroke.thickness);
+        if (record) {
+            this.history.push(stroke);
+        }
+    }
+    
+    // Remove every segment of a group and repaint from the base layer
+    undoGroup(group) {
+        const before = this.history.length;
+        this.history = this.history.filter(s => s.group !== group);
+        if (this.history.length === before) return false;
+        
+        this.ctx.drawImage(this.baseCanvas, 0, 0);
+        this.history.forEach(s => this.drawStroke(s, false));
+        return true;
+    }
+    
+    // Drawer side: undo the most recent local group, returning its id
+    undoLast() {
+        if (this.history.length === 0) return null;
+        const group = this.history[this.history.length - 1].group;
+        this.undoGroup(group);
+        return group;
+    }
+    
+    drawTile(index, rle, tileSize, tilesX) {
+        // Each byte is (run - 1) << 4 | palette index, where 0 is background
+        const bytes = atob(rle);
+        const image = this.ctx.createImageData(tileSize, tileSize);
+        let pixel = 0;
+        for (let i = 0; i < bytes.length; i++) {
+            const b = bytes.charCodeAt(i);
+            const value = b & 0x0F;
+            const hex = value === 0 ? '#FFFFFF' : (this.colors[value - 1] || this.colors[0]);
+            const r = parseInt(hex.substr(1, 2), 16);
+            const g = parseInt(hex.substr(3, 2), 16);
+            const bl = parseInt(hex.substr(5, 2), 16);
+            for (let run = (b >> 4) + 1; run > 0; run--, pixel++) {
+                image.data[pixel * 4] = r;
+                image.data[pixel * 4 + 1] = g;
+                image.data[pixel * 4 + 2] = bl;
+                image.data[pixel * 4 + 3] = 255;
+            }
+        }
+        const x = (index % tilesX) * tileSize;
+        const y = Math.floor(index / tilesX) * tileSize;
+        this.ctx.putImageData(image, x, y);
+        this.baseCtx.putImageData(image, x, y);
     }
     
     clear() {
         this.ctx.fillStyle = 'white';
         this.ctx.fillRect(0, 0, this.canvas.width, this.canvas.height);
+        this.baseCtx.fillStyle = 'white';
+        this.baseCtx.fillRect(0, 0, this.baseCanvas.width, this.baseCanvas.height);
+        this.history = [];
+        this.strokeBuffer = [];  // Unsent segments belong to the wiped canvas
     }
     
     setColor(colorIndex) {
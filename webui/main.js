@@ -8,7 +8,14 @@ class Game {
         this.sessionToken = null;
         this.roomId = null;
         this.players = [];
+        this.roomState = null;   // Last full room state plus applied patches
+        this.roomSeq = 0;
+        this.resyncPending = false;
         this.isDrawing = false;
+        this.timerInterval = null;     // Local countdowns driven by server deadlines
+        this.timerDeadline = 0;
+        this.countdownInterval = null;
+        this.countdownDeadline = 0;
         
         this.setupUI();
         this.setupMessageHandlers();
@@ -62,6 +69,7 @@ class Game {
         };
         
         document.getElementById('btn-clear').onclick = () => this.clearCanvas();
+        document.getElementById('btn-undo').onclick = () => this.undoStroke();
         
         // Drawing tools
         // Color palette buttons
@@ -104,8 +112,14 @@ class Game {
         this.ws.on(MSG_TYPE.GAME_END, (data) => this.handleGameEnd(data));
         this.ws.on(MSG_TYPE.RECONNECT_SUCCESS, (data) => this.handleReconnectSuccess(data));
         this.ws.on(UDP_TYPE.CLEAR_CANVAS, (data) => this.handleClearCanvas(data));
+        this.ws.on(UDP_TYPE.UNDO, (data) => this.handleUndo(data));
         this.ws.on(MSG_TYPE.ERROR, (data) => this.handleError(data));
         this.ws.on(UDP_TYPE.STROKE, (data) => this.handleStroke(data));
+        this.ws.on(UDP_TYPE.STROKE_PACKED, (data) => this.handleStrokePacked(data));
+        this.ws.on(MSG_TYPE.CANVAS_SNAPSHOT, (data) => this.handleCanvasSnapshot(data));
+        this.ws.on(MSG_TYPE.ROOM_PATCH, (data) => this.handleRoomPatch(data));
+        this.ws.on(MSG_TYPE.ROOM_RESYNC, (data) => this.handleRoomResync(data));
+        this.ws.on(MSG_TYPE.LEADERBOARD, (data) => this.handleLeaderboard(data));
     }
     
     register() {
@@ -163,6 +177,15 @@ class Game {
         }
     }
     
+    undoStroke() {
+        // Remove the last pen-down/pen-up stroke locally; others get a compact undo.
+        // Queued segments go first so the server has the whole group to remove.
+        this.canvas.flushStrokes();
+        if (this.canvas.undoLast() !== null && this.ws.connected) {
+            this.ws.send(UDP_TYPE.UNDO, {});
+        }
+    }
+    
     showScreen(screenId) {
         document.querySelectorAll('.screen').forEach(s => s.classList.add('hidden'));
         document.getElementById(screenId).classList.remove('hidden');
@@ -332,6 +355,9 @@ class Game {
         this.roomId = null;
         this.isDrawing = false;
         this.players = [];
+        this.roomState = null;
+        this.stopTimer();
+        this.stopCountdown();
         this.canvas.clear();
         this.canvas.enable(false);
         
@@ -372,7 +398,7 @@ class Game {
         console.log('[GAME] handleRoomJoined: data=', data, 'isInitialJoin=', isInitialJoin, 'current roomId=', this.roomId);
         
         this.roomId = data.room_id;
-        this.players = data.players || [];
+        this.setRoomState(data);
         
         // Always show game page when room is joined
         this.showScreen('game-page');
@@ -397,12 +423,12 @@ class Game {
         console.log('[GAME] Game started with data:', data);
         
         // Hide countdown display
-        document.getElementById('countdown-display').classList.add('hidden');
+        this.stopCountdown();
         
         // Hide canvas message - game is starting!
         this.hideCanvasMessage();
         
-        this.players = data.players || [];
+        this.setRoomState(data);
         this.updatePlayersList();
         this.canvas.clear();
         
@@ -459,7 +485,8 @@ class Game {
         console.log('[GAME] Round started with data:', data);
         console.log('[GAME] My player_id:', this.playerId);
         this.canvas.clear();
-        this.players = data.players || this.players;
+        this.canvas.roundStart = Date.now();
+        this.setRoomState(data);
         this.updatePlayersList();
         
         if (data.word_mask) {
@@ -509,11 +536,63 @@ class Game {
         this.addChatMessage('System', 'Round ended!', 'system', 'game-alert');
         // Update players and scores
         if (data.players) {
-            this.players = data.players;
+            this.setRoomState(data);
             this.updatePlayersList();
         }
     }
     
+    // Full room state from the server; ROOM_PATCH messages apply on top of it
+    setRoomState(data) {
+        this.roomState = data;
+        this.roomSeq = data.seq || 0;
+        this.players = data.players || [];
+    }
+    
+    handleRoomPatch(data) {
+        if (!this.roomState || data.seq <= this.roomSeq) return;  // Already in our snapshot
+        
+        if (data.seq !== this.roomSeq + 1) {
+            // Missed a patch: ask for a fresh snapshot and drop patches until it lands
+            console.log('[GAME] Room patch gap', this.roomSeq, '->', data.seq, '- resyncing');
+            if (!this.resyncPending) {
+                this.resyncPending = true;
+                this.ws.send(MSG_TYPE.ROOM_RESYNC, {});
+            }
+            return;
+        }
+        this.roomSeq = data.seq;
+        
+        (data.players || []).forEach(update => {
+            const player = this.players.find(p => p.player_id === update.player_id);
+            if (player) {
+                Object.assign(player, update);
+            } else {
+                this.players.push(update);
+            }
+        });
+        if (data.leave !== undefined) {
+            this.players = this.players.filter(p => p.player_id !== data.leave);
+        }
+        
+        Object.keys(data).forEach(key => {
+            if (key !== 'seq' && key !== 'players' && key !== 'leave') {
+                this.roomState[key] = data[key];
+            }
+        });
+        this.roomState.players = this.players;
+        
+        if (data.total_rounds !== undefined) {
+            document.getElementById('total-rounds').textContent = data.total_rounds;
+        }
+        this.updatePlayersList();
+    }
+    
+    handleRoomResync(data) {
+        this.resyncPending = false;
+        this.setRoomState(data);
+        this.updatePlayersList();
+    }
+    
     handleGuessCorrect(data) {
         console.log('[GAME] Player guessed correctly:', data);
         // Always show the notification, even if it's the current player
@@ -534,38 +613,85 @@ class Game {
         }
     }
     
+    // Server deadlines are on its monotonic clock; deadline - server_now is
+    // the time left as of receipt, which we pin to our own monotonic clock
+    localDeadline(data) {
+        return performance.now() + Math.max(0, data.deadline - data.server_now);
+    }
+    
     handleTimerUpdate(data) {
-        if (data.time_remaining !== undefined) {
-            // Just update the display, don't restart client-side timer
-            document.getElementById('timer').textContent = data.time_remaining;
+        if (data.deadline !== undefined) {
+            this.timerDeadline = this.localDeadline(data);
+            this.runTimer();
+        } else if (data.time_remaining !== undefined) {
+            this.startTimer(data.time_remaining);
         }
     }
     
     handleCountdownUpdate(data) {
+        if (data.deadline !== undefined) {
+            this.countdownDeadline = this.localDeadline(data);
+        } else {
+            this.countdownDeadline = performance.now() + (data.countdown || 0) * 1000;
+        }
+        
+        if (!this.countdownInterval) {
+            this.countdownInterval = setInterval(() => this.renderCountdown(), 250);
+        }
+        this.renderCountdown();
+    }
+    
+    renderCountdown() {
         const countdownDisplay = document.getElementById('countdown-display');
         const countdownTimer = document.getElementById('countdown-timer');
+        const countdown = Math.ceil((this.countdownDeadline - performance.now()) / 1000);
         
-        if (data.countdown !== undefined && data.countdown > 0) {
-            countdownTimer.textContent = data.countdown;
+        if (countdown > 0) {
+            countdownTimer.textContent = countdown;
             countdownDisplay.classList.remove('hidden');
             
             // Show countdown on canvas
-            this.showCanvasMessage(`🚀 Game starting in ${data.countdown}...`);
+            this.showCanvasMessage(`🚀 Game starting in ${countdown}...`);
         } else {
-            countdownDisplay.classList.add('hidden');
+            this.stopCountdown();
             this.hideCanvasMessage();
         }
     }
     
+    stopCountdown() {
+        if (this.countdownInterval) {
+            clearInterval(this.countdownInterval);
+            this.countdownInterval = null;
+        }
+        document.getElementById('countdown-display').classList.add('hidden');
+    }
+    
     startTimer(seconds) {
-        // Clear any existing timer
+        // Provisional until the round's TIMER_UPDATE deadline arrives
+        this.timerDeadline = performance.now() + seconds * 1000;
+        this.runTimer();
+    }
+    
+    runTimer() {
+        if (!this.timerInterval) {
+            this.timerInterval = setInterval(() => this.renderTimer(), 250);
+        }
+        this.renderTimer();
+    }
+    
+    renderTimer() {
+        const left = Math.max(0, Math.ceil((this.timerDeadline - performance.now()) / 1000));
+        document.getElementById('timer').textContent = left;
+        if (left === 0) {
+            this.stopTimer();
+        }
+    }
+    
+    stopTimer() {
         if (this.timerInterval) {
             clearInterval(this.timerInterval);
             this.timerInterval = null;
         }
-        
-        // Just display the initial time, server will send updates
-        document.getElementById('timer').textContent = seconds;
     }
     
     handlePlayerJoin(data) {
@@ -600,6 +726,7 @@ class Game {
     
     handleGameEnd(data) {
         console.log('[GAME] Game ended:', data);
+        this.stopTimer();
         const dialog = document.getElementById('game-end-dialog');
         const rankingsEl = document.getElementById('final-scores');
         
@@ -636,6 +763,37 @@ class Game {
         }
         
         dialog.classList.remove('hidden');
+        
+        // Stats are written in the background; give this game's results a moment to land
+        document.getElementById('leaderboard').innerHTML = '';
+        setTimeout(() => this.ws.send(MSG_TYPE.LEADERBOARD, {}), 500);
+    }
+    
+    handleLeaderboard(data) {
+        const leaderboardEl = document.getElementById('leaderboard');
+        leaderboardEl.innerHTML = '';
+        
+        (data.entries || []).forEach((entry) => {
+            const item = document.createElement('div');
+            item.className = 'ranking-item';
+            
+            const position = document.createElement('span');
+            position.className = 'ranking-position';
+            position.textContent = `#${entry.rank}`;
+            
+            const name = document.createElement('span');
+            name.className = 'ranking-name';
+            name.textContent = entry.username;
+            
+            const score = document.createElement('span');
+            score.className = 'ranking-score';
+            score.textContent = `${entry.score} pts · ${entry.wins}/${entry.games} wins`;
+            
+            item.appendChild(position);
+            item.appendChild(name);
+            item.appendChild(score);
+            leaderboardEl.appendChild(item);
+        });
     }
     
     handleReconnectSuccess(data) {
@@ -653,6 +811,11 @@ class Game {
         this.canvas.clear();
     }
     
+    handleUndo(data) {
+        console.log('[GAME] Undo received for group', data.group);
+        this.canvas.undoGroup(data.group);
+    }
+    
     handleStroke(data) {
         console.log('[GAME] Received stroke:', data, 'myPlayerId:', this.playerId, 'strokePlayerId:', data.player_id);
         // Draw stroke received from other players
@@ -668,6 +831,29 @@ class Game {
             console.log('[GAME] Ignoring stroke - it is from myself (player_id:', data.player_id, ')');
         }
     }
+    
+    handleStrokePacked(data) {
+        // Server fanout: one message carries whole polylines in the compact codec
+        if (data.player_id === this.playerId) return;
+        try {
+            StrokeCodec.decode(data.strokes, 0).forEach(s => this.canvas.drawStroke(s));
+        } catch (e) {
+            console.error('[GAME] Bad packed strokes:', e);
+        }
+    }
+    
+    handleCanvasSnapshot(data) {
+        // Catch-up after joining or reconnecting: RLE-compressed tiles of the server raster
+        if (data.first) {
+            this.canvas.clear();
+        }
+        (data.tiles || []).forEach(([index, rle]) => {
+            this.canvas.drawTile(index, rle, data.tile_size, data.tiles_x);
+        });
+        if (data.done) {
+            console.log('[GAME] Canvas catch-up complete');
+        }
+    }
 }
 
 // Initialize game when page loads
@@ -0,0 +1,122 @@
+// Compact stroke encoding, mirror of server/game/stroke_codec.c
+//   blob  := version:u8 run*
+//   run   := palette:u8 thickness:u8 group:varint dt:varint count:varint point*count
+//   point := dx:zigzag-varint dy:zigzag-varint  (1/16 px, delta from previous point)
+const StrokeCodec = {
+    VERSION: 1,
+    SCALE: 16,
+
+    quantize(v) {
+        return Math.min(65535, Math.max(0, Math.round(v * this.SCALE)));
+    },
+
+    putVarint(out, value) {
+        // Values can exceed 32 bits (timestamps), so avoid bitwise ops
+        do {
+            let byte = value % 128;
+            value = Math.floor(value / 128);
+            out.push(value > 0 ? byte | 0x80 : byte);
+        } while (value > 0);
+    },
+
+    putDelta(out, delta) {
+        this.putVarint(out, delta >= 0 ? delta * 2 : -delta * 2 - 1);
+    },
+
+    continuesRun(a, b) {
+        return a.color === b.color && a.thickness === b.thickness && a.group === b.group &&
+               this.quantize(a.x2) === this.quantize(b.x1) &&
+               this.quantize(a.y2) === this.quantize(b.y1);
+    },
+
+    // strokes: [{x1, y1, x2, y2, color, thickness, group, timestamp}] -> base64 string
+    encode(strokes, baseTime) {
+        const out = [this.VERSION];
+        let prevTime = baseTime;
+        let prevX = 0, prevY = 0;
+
+        let i = 0;
+        while (i < strokes.length) {
+            let runEnd = i + 1;
+            while (runEnd < strokes.length && this.continuesRun(strokes[runEnd - 1], strokes[runEnd])) {
+                runEnd++;
+            }
+
+            const first = strokes[i];
+            const time = first.timestamp || prevTime;
+            out.push(first.color & 0xFF, first.thickness & 0xFF);
+            this.putVarint(out, first.group || 0);
+            this.putVarint(out, Math.max(0, time - prevTime));
+            this.putVarint(out, runEnd - i + 1);
+            prevTime = Math.max(prevTime, time);
+
+            const points = [[first.x1, first.y1]];
+            for (let p = i; p < runEnd; p++) {
+                points.push([strokes[p].x2, strokes[p].y2]);
+            }
+            points.forEach(([px, py]) => {
+                const x = this.quantize(px);
+                const y = this.quantize(py);
+                this.putDelta(out, x - prevX);
+                this.putDelta(out, y - prevY);
+                prevX = x;
+                prevY = y;
+            });
+
+            i = runEnd;
+        }
+
+        return btoa(String.fromCharCode.apply(null, out));
+    },
+
+    // base64 string -> [{x1, y1, x2, y2, color, thickness, group, timestamp}]
+    decode(encoded, baseTime) {
+        const bin = atob(encoded);
+        let pos = 0;
+
+        const getVarint = () => {
+            let value = 0, scale = 1, byte;
+            do {
+                if (pos >= bin.length) throw new Error('truncated stroke blob');
+                byte = bin.charCodeAt(pos++);
+                value += (byte & 0x7F) * scale;
+                scale *= 128;
+            } while (byte & 0x80);
+            return value;
+        };
+        const getDelta = () => {
+            const z = getVarint();
+            return z % 2 === 0 ? z / 2 : -(z + 1) / 2;
+        };
+
+        if (bin.charCodeAt(pos++) !== this.VERSION) {
+            throw new Error('unknown stroke blob version');
+        }
+
+        const strokes = [];
+        let time = baseTime;
+        let x = 0, y = 0;
+        while (pos < bin.length) {
+            const color = bin.charCodeAt(pos++);
+            const thickness = bin.charCodeAt(pos++);
+            const group = getVarint();
+            time += getVarint();
+            const count = getVarint();
+
+            for (let p = 0; p < count; p++) {
+                const nx = x + getDelta();
+                const ny = y + getDelta();
+                if (p > 0) {
+                    strokes.push({
+                        x1: x / this.SCALE, y1: y / this.SCALE,
+                        x2: nx / this.SCALE, y2: ny / this.SCALE,
+                        color, thickness, group, timestamp: time
+                    });
+                }
+                x = nx;
+                y = ny;
+            }
+        }
+        return strokes;
+    }
+};
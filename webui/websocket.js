@@ -156,11 +156,16 @@ const MSG_TYPE = {
     RECONNECT_SUCCESS: 26,
     RECONNECT_FAIL: 27,
     ERROR: 28,
-    DISCONNECT: 29
+    DISCONNECT: 29,
+    CANVAS_SNAPSHOT: 30,
+    ROOM_PATCH: 31,
+    ROOM_RESYNC: 32,
+    LEADERBOARD: 33
 };
 
 const UDP_TYPE = {
     STROKE: 100,
     CLEAR_CANVAS: 101,
-    UNDO: 102
+    UNDO: 102,
+    STROKE_PACKED: 103
 };